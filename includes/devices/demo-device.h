@@ -43,6 +43,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define DEMO_DEVICE_STATUS_MSG_TYPE 0
 #define DEMO_DEVICE_CONTROL_MSG_TYPE 1
+#define DEMO_DEVICE_EXCHANGE_MSG_TYPE 2 // control in the request, status in the response
 
 #define DEMO_DEVICE_STATUS_MSG_LENGTH 2
 #define DEMO_DEVICE_CONTROL_MSG_LENGTH 2
@@ -65,12 +66,19 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
     DEMO_DEVICE_STATUS_MSG_LENGTH \
     ) \
 
+#define DEMO_DEVICE_EXCHANGE_MSG PMLIN_EXCHANGE_MESSAGE_DEF ( \
+    DEMO_DEVICE_EXCHANGE_MSG_TYPE,  \
+	DEMO_DEVICE_CONTROL_MSG_LENGTH, \
+    DEMO_DEVICE_STATUS_MSG_LENGTH \
+    ) \
+
 #define DEMO_DEVICE_DEVICE_DECL(id) \
 	PMLIN_DECLARE_DEVICE( \
 	    id, \
 		DEMO_DEVICE_DEVICE_TYPE,\
 		DEMO_DEVICE_CONTROL_MSG, \
 		DEMO_DEVICE_STATUS_MSG, \
+		DEMO_DEVICE_EXCHANGE_MSG, \
 		)
 
 typedef struct {
@@ -62,6 +62,20 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define PMLIN_CMD_MSG_CMD_PROBE 0
 #define PMLIN_CMD_MSG_CMD_RENUM 1
 #define PMLIN_CMD_MSG_CMD_INQUIRE 2
+#define PMLIN_CMD_MSG_CMD_TRIGGER 3 // broadcast only, not acknowledged
+#define PMLIN_CMD_MSG_CMD_POLL 4 // broadcast only, answered by the polled slaves in their slots
+
+// for PMLIN_CMD_MSG_CMD_TRIGGER, device mask (bit n for id n, least significant byte first)
+#define PMLIN_CMD_MSG_TRIGGER_MASK_IDX 1
+
+// for PMLIN_CMD_MSG_CMD_POLL, each slave from the first to the last id that transmits the message type answers
+// in its own slot, slot n starts n slot lengths after the poll. The answer is a slot header, like the frame header
+// with the type and the id of the slave, the message payload and a CRC over the slot header and the payload.
+#define PMLIN_CMD_MSG_POLL_TYPE_IDX 1
+#define PMLIN_CMD_MSG_POLL_FIRST_ID_IDX 2
+#define PMLIN_CMD_MSG_POLL_LAST_ID_IDX 3
+#define PMLIN_CMD_MSG_POLL_SLOT_LEN_IDX 4 // in character times of PMLIN_POLL_CHAR_TIME_US
+#define PMLIN_POLL_CHAR_TIME_US ((1000000UL * 11 + PMLIN_BAUDRATE - 1) / PMLIN_BAUDRATE)
 
 // for PMLIN_CMD_MSG_CMD_RENUM
 #define PMLIN_CMD_MSG_RENUM_ID_IDX 1
@@ -73,6 +87,14 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define PMLIN_CMD_RESP_LEN 5
 
+// Group write broadcast, a message to PMLIN_BROADCAST_ID of any type but PMLIN_MESSAGE_TYPE_CMD. The payload
+// carries a slice for each device in a mask, each device receives its slice as the payload of its own message
+// of the same type. The slaves do not acknowledge the broadcast.
+// Payload: slice length, device mask (bit n for id n, least significant byte first), slices in id order
+#define PMLIN_GROUP_SLICE_LEN_IDX 0
+#define PMLIN_GROUP_MASK_IDX 1
+#define PMLIN_GROUP_HEADER_LEN 5
+
 // for accessing INQUIRY message response payload
 #define PMLIN_CMD_RESP_DEV_TYPE_MSB_IDX 0
 #define PMLIN_CMD_RESP_DEV_TYPE_LSB_IDX 1
@@ -90,7 +112,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 typedef volatile struct {
 	uint8_t m_message_dir;
-	uint32_t m_message_length;
+	uint32_t m_message_length; // for PMLIN_EXCHANGE the length of the request from the host
+	uint32_t m_response_length; // only for PMLIN_EXCHANGE, the length of the response from the slave
 } PMLIN_message_def_t;
 
 typedef volatile struct {
@@ -102,10 +125,14 @@ typedef volatile struct {
 // Used to declare a message, for example usage see demo-device.h
 #define PMLIN_MESSAGE_DEF(a,b,c) .m_messages[(a)] = ((PMLIN_message_def_t){ .m_message_dir = (b), .m_message_length=(c)})
 
+// Used to declare an exchange message, a request from the host and a response from the slave in the same frame
+#define PMLIN_EXCHANGE_MESSAGE_DEF(a,b,c) .m_messages[(a)] = ((PMLIN_message_def_t){ .m_message_dir = PMLIN_EXCHANGE, .m_message_length=(b), .m_response_length=(c)})
+
 // Used to declare a device, for example usage see demo-device.h
 #define PMLIN_DECLARE_DEVICE(a,b,c,...) {.m_id=a, .m_device_type = b, c, __VA_ARGS__}
 
 #define PMLIN_HOST_TO_SLAVE 0
 #define PMLIN_SLAVE_TO_HOST 1
+#define PMLIN_EXCHANGE 2 // host to slave request followed by a slave to host response
 
 #endif /* PMLIN_MESSAGES */
@@ -0,0 +1,61 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "pmlin-batch-demo.h"
+
+#include <stdio.h>
+#include "pmlin.h"
+#include "pmlin-master.h"
+#include "demo-device.h"
+
+#define NUM_BATCH_DEVICES 3
+
+// Writes the control message to all devices and reads their status back as one batch,
+// no other thread can get its transactions in between.
+
+void batch_demo(bool emu) {
+	printf("batch_demo\n");
+
+	uint8_t control[NUM_BATCH_DEVICES][DEMO_DEVICE_CONTROL_MSG_LENGTH] = { { 1, 0 }, { 2, 0 }, { 3, 0 } };
+	uint8_t status[NUM_BATCH_DEVICES][DEMO_DEVICE_STATUS_MSG_LENGTH] = { 0 };
+	PMLIN_transaction_t batch[2 * NUM_BATCH_DEVICES];
+	for (uint8_t i = 0; i < NUM_BATCH_DEVICES; i++) {
+		uint8_t id = i + 1;
+		batch[i] = (PMLIN_transaction_t) PMLIN_SEND_TRANSACTION(id, DEMO_DEVICE_CONTROL_MSG_TYPE, DEMO_DEVICE_CONTROL_MSG_LENGTH, control[i]);
+		batch[NUM_BATCH_DEVICES + i] = (PMLIN_transaction_t) PMLIN_RECEIVE_TRANSACTION(id, DEMO_DEVICE_STATUS_MSG_TYPE, DEMO_DEVICE_STATUS_MSG_LENGTH, status[i]);
+	}
+
+	PMLIN_error_t res = PMLIN_transact_batch(batch, sizeof(batch) / sizeof(batch[0]));
+	printf("PMLIN_transact_batch: %s\n", PMLIN_result_to_string(res));
+	for (uint8_t i = 0; i < sizeof(batch) / sizeof(batch[0]); i++)
+		printf("  %s id %d: %s\n", batch[i].m_kind == PMLIN_TRANSACTION_SEND ? "control" : "status ", batch[i].m_id, PMLIN_result_to_string(batch[i].m_result));
+}
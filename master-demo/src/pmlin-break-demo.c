@@ -0,0 +1,75 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#define _XOPEN_SOURCE 600 // for posix_openpt() and friends
+
+#include "pmlin-break-demo.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "pmlin.h"
+#include "pmlin-posix-hal.h"
+#include "pmlin-slave-emulator.h"
+
+#define BREAK_COUNT 200
+
+// Measures the BREAK generation of the POSIX HAL. With real hardware this uses the serial port opened in main(),
+// when emulating there is no serial port so a pseudo terminal is used instead. Pseudo terminals accept TIOCSBRK
+// so the measured width is the timing accuracy of the OS rather than that of a real UART.
+
+void break_demo(bool emu) {
+	printf("break_demo\n");
+	int pty = -1;
+	if (emu) {
+		pty = posix_openpt(O_RDWR | O_NOCTTY);
+		if (pty < 0 || grantpt(pty) || unlockpt(pty))
+			report_and_exit("posix_openpt");
+		if (PMLIN_posix_open_serial_port(ptsname(pty)) < 0)
+			report_and_exit(ptsname(pty));
+	}
+	PMLIN_posix_set_break_measurement(true);
+	for (uint16_t i = 0; i < BREAK_COUNT; i++)
+		PMLIN_posix_send_break();
+
+	PMLIN_posix_break_stats_t stats;
+	PMLIN_posix_get_break_stats(&stats, true);
+	printf("%d BREAKs, %d with the half baudrate fallback\n", stats.m_count, stats.m_fallback_count);
+	if (stats.m_width_count)
+		printf("BREAK width min %d usec avg %d usec max %d usec\n", stats.m_width_min_us,
+				(uint32_t) (stats.m_width_total_us / stats.m_width_count), stats.m_width_max_us);
+	printf("overhead per frame avg %d usec max %d usec\n", (uint32_t) (stats.m_overhead_total_us / stats.m_count), stats.m_overhead_max_us);
+	if (pty >= 0)
+		close(pty);
+}
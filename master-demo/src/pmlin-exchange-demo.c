@@ -0,0 +1,129 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "pmlin-exchange-demo.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include "pmlin-master.h"
+#include "pmlin-posix-hal.h"
+#include "demo-device.h"
+#include "pmlin-slave-emufun.h"
+
+// Mirrors the control and the status of the three emulated slaves on every tick, first with a frame for each
+// direction and then with one exchange frame per slave, and compares the frames and the bus time per tick.
+// The slaves make each status and check each control self consistent so that a mixed up payload shows.
+
+#define TICKS 100
+
+static volatile uint8_t g_control[3][DEMO_DEVICE_CONTROL_MSG_LENGTH];
+static volatile uint8_t g_status[3][DEMO_DEVICE_STATUS_MSG_LENGTH];
+
+static PMLIN_mirror_def_t g_separate_defs[] = { //
+		PMLIN_MIRROR_DEF(1, DEMO_DEVICE_CONTROL_MSG_TYPE, g_control[0], 1, 0), //
+		PMLIN_MIRROR_DEF(1, DEMO_DEVICE_STATUS_MSG_TYPE, g_status[0], 1, 0), //
+		PMLIN_MIRROR_DEF(2, DEMO_DEVICE_CONTROL_MSG_TYPE, g_control[1], 1, 0), //
+		PMLIN_MIRROR_DEF(2, DEMO_DEVICE_STATUS_MSG_TYPE, g_status[1], 1, 0), //
+		PMLIN_MIRROR_DEF(3, DEMO_DEVICE_CONTROL_MSG_TYPE, g_control[2], 1, 0), //
+		PMLIN_MIRROR_DEF(3, DEMO_DEVICE_STATUS_MSG_TYPE, g_status[2], 1, 0), //
+		};
+
+static PMLIN_mirror_def_t g_exchange_defs[] = { //
+		PMLIN_EXCHANGE_MIRROR_DEF(1, DEMO_DEVICE_EXCHANGE_MSG_TYPE, g_control[0], g_status[0], 1, 0), //
+		PMLIN_EXCHANGE_MIRROR_DEF(2, DEMO_DEVICE_EXCHANGE_MSG_TYPE, g_control[1], g_status[1], 1, 0), //
+		PMLIN_EXCHANGE_MIRROR_DEF(3, DEMO_DEVICE_EXCHANGE_MSG_TYPE, g_control[2], g_status[2], 1, 0), //
+		};
+
+static PMLIN_device_decl_t g_device_defs[] = { //
+		DEMO_DEVICE_DEVICE_DECL(1), //
+		DEMO_DEVICE_DEVICE_DECL(2), //
+		DEMO_DEVICE_DEVICE_DECL(3), //
+		};
+
+static uint32_t predicted_us(PMLIN_mirror_def_t defs[], uint32_t n) {
+	uint32_t us = 0;
+	for (uint32_t i = 0; i < n; i++)
+		us += PMLIN_message_airtime_us(defs[i].m_device_id, defs[i].m_message_type);
+	return us;
+}
+
+// runs back to back ticks writing a new control on each, prints the bus use and checks what the slaves saw
+static void run_ticks(const char *title, PMLIN_mirror_def_t defs[], uint32_t n) {
+	PMLIN_error_t res = PMLIN_define_mirroring(defs, n);
+	if (res != PMLIN_OK) {
+		printf("PMLIN_define_mirroring: error %s\n", PMLIN_result_to_string(res));
+		return;
+	}
+	uint32_t controls = 0, torn = 0;
+	for (uint8_t i = 0; i < 3; i++) {
+		controls -= g_demo_device_simulated_state[i].m_control_count;
+		torn -= g_demo_device_simulated_state[i].m_torn_count;
+	}
+	PMLIN_utilization_t u;
+	PMLIN_get_utilization(&u, true);
+	uint32_t errors = 0, torn_status = 0;
+	for (uint32_t tick = 0; tick < TICKS; tick++) {
+		for (uint8_t i = 0; i < 3; i++) {
+			g_control[i][0] = tick;
+			g_control[i][1] = ~tick;
+		}
+		PMLIN_mirror_tick(NULL);
+		for (uint32_t i = 0; i < n; i++)
+			errors += defs[i].m_result != PMLIN_OK;
+		for (uint8_t i = 0; i < 3; i++)
+			torn_status += g_status[i][1] != (uint8_t) ~g_status[i][0];
+	}
+	PMLIN_get_utilization(&u, true);
+	for (uint8_t i = 0; i < 3; i++) {
+		controls += g_demo_device_simulated_state[i].m_control_count;
+		torn += g_demo_device_simulated_state[i].m_torn_count;
+	}
+	printf("%-9s %d frames/tick, bus busy %6d usec/tick (predicted %6d), %d errors, %d controls, %d torn controls, %d torn statuses\n",
+			title, u.m_frames / TICKS, (uint32_t) (u.m_busy_us / TICKS), predicted_us(defs, n), errors, controls,
+			torn, torn_status);
+}
+
+void exchange_demo(bool emu) {
+	printf("exchange_demo\n");
+	if (!emu || !g_demo_device_simulated_state) {
+		printf("needs the emulated slaves, use -e\n");
+		return;
+	}
+	for (uint8_t i = 0; i < 3; i++)
+		g_demo_device_simulated_state[i].m_check_complement = true;
+	PMLIN_DEFINE_DEVICES(g_device_defs);
+	PMLIN_set_tick_period_us(100000); // the ticks run back to back, this just keeps the admission control happy
+	run_ticks("separate", g_separate_defs, sizeof(g_separate_defs) / sizeof(g_separate_defs[0]));
+	run_ticks("exchange", g_exchange_defs, sizeof(g_exchange_defs) / sizeof(g_exchange_defs[0]));
+	for (uint8_t i = 0; i < 3; i++)
+		g_demo_device_simulated_state[i].m_check_complement = false;
+}
@@ -0,0 +1,126 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "pmlin-group-demo.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include "pmlin-master.h"
+#include "pmlin-posix-hal.h"
+#include "demo-device.h"
+#include "pmlin-slave-emufun.h"
+
+// Writes the control of the three emulated slaves, first with a message to each slave and then with one
+// group write broadcast, checks that every slave got its own slice and compares the bus time of the two.
+
+#define ROUNDS 200
+#define GROUP_MASK ((1 << 1) | (1 << 2) | (1 << 3))
+
+static uint8_t g_control[3][DEMO_DEVICE_CONTROL_MSG_LENGTH];
+
+// a different, self checking control for each slave and round
+static void next_control(uint32_t round) {
+	for (uint8_t i = 0; i < 3; i++) {
+		g_control[i][0] = round * 3 + i;
+		g_control[i][1] = ~g_control[i][0];
+	}
+}
+
+// number of slaves whose latest control is not the one in g_control
+static uint8_t count_stale() {
+	uint8_t stale = 0;
+	for (uint8_t i = 0; i < 3; i++)
+		for (uint8_t j = 0; j < DEMO_DEVICE_CONTROL_MSG_LENGTH; j++)
+			if (g_demo_device_simulated_state[i].m_control_data_in[j] != g_control[i][j]) {
+				stale++;
+				break;
+			}
+	return stale;
+}
+
+static uint32_t control_count() {
+	uint32_t count = 0;
+	for (uint8_t i = 0; i < 3; i++)
+		count += g_demo_device_simulated_state[i].m_control_count;
+	return count;
+}
+
+static void report(const char *how, uint32_t errors, uint32_t stale, uint32_t controls) {
+	PMLIN_utilization_t u;
+	PMLIN_get_utilization(&u, true);
+	printf("%-10s %d frames, %d errors, %d controls received, %d stale, bus busy %d usec, %d usec per round\n", how,
+			u.m_frames, errors, controls, stale, (uint32_t) u.m_busy_us, (uint32_t) (u.m_busy_us / ROUNDS));
+}
+
+void group_demo(bool emu) {
+	printf("group_demo\n");
+	if (!emu || !g_demo_device_simulated_state) {
+		printf("needs the emulated slaves, use -e\n");
+		return;
+	}
+	for (uint8_t i = 0; i < 3; i++) {
+		g_demo_device_simulated_state[i].m_check_complement = true;
+		g_demo_device_simulated_state[i].m_control_count = 0;
+	}
+	PMLIN_utilization_t u;
+	PMLIN_get_utilization(&u, true);
+
+	uint32_t errors = 0, stale = 0, controls = control_count();
+	for (uint32_t round = 0; round < ROUNDS; round++) {
+		next_control(round);
+		for (uint8_t i = 0; i < 3; i++)
+			if (PMLIN_send_message(i + 1, DEMO_DEVICE_CONTROL_MSG_TYPE, DEMO_DEVICE_CONTROL_MSG_LENGTH, g_control[i]))
+				errors++;
+		stale += count_stale();
+	}
+	report("unicast", errors, stale, control_count() - controls);
+
+	errors = 0, stale = 0, controls = control_count();
+	for (uint32_t round = 0; round < ROUNDS; round++) {
+		next_control(ROUNDS + round);
+		if (PMLIN_send_group(DEMO_DEVICE_CONTROL_MSG_TYPE, GROUP_MASK, DEMO_DEVICE_CONTROL_MSG_LENGTH, &g_control[0][0]))
+			errors++;
+		// nobody acknowledges a broadcast, give the slaves a moment to check the CRC before looking
+		uint32_t t0 = PMLIN_posix_time_us();
+		while (control_count() - controls < 3 * (round + 1) && PMLIN_posix_time_us() - t0 < 100000)
+			;
+		stale += count_stale();
+	}
+	report("broadcast", errors, stale, control_count() - controls);
+
+	uint8_t group_len = PMLIN_GROUP_HEADER_LEN + 3 * DEMO_DEVICE_CONTROL_MSG_LENGTH;
+	printf("airtime per round, unicast %d usec, broadcast %d usec\n",
+			3 * PMLIN_frame_airtime_us(DEMO_DEVICE_CONTROL_MSG_TYPE, PMLIN_HOST_TO_SLAVE, DEMO_DEVICE_CONTROL_MSG_LENGTH, 0),
+			PMLIN_frame_airtime_us(DEMO_DEVICE_CONTROL_MSG_TYPE, PMLIN_SLAVE_TO_HOST, group_len, 0));
+	for (uint8_t i = 0; i < 3; i++)
+		g_demo_device_simulated_state[i].m_check_complement = false;
+}
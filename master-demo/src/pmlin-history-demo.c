@@ -0,0 +1,172 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "pmlin-history-demo.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "pmlin-master.h"
+#include "pmlin-sample-ring.h"
+#include "demo-device.h"
+#include "pmlin-slave-emufun.h"
+
+// Keeps a history of the status of slave 2, mirrored every tick, and reads it from three threads at once.
+// The slave counts its status reads in the first byte and sends the complement in the second, so a reader
+// can tell a consistent sample and a gap in the history. Two readers keep up with the mirroring, the third
+// reads so seldom that the ring overflows in between and it loses the oldest samples.
+
+#define TICK_PERIOD_US 5000
+#define HISTORY_LEN 64
+#define RUN_TIME_US 3000000
+
+static volatile uint8_t g_status_2[DEMO_DEVICE_STATUS_MSG_LENGTH];
+static PMLIN_sample_slot_t g_history_slots[HISTORY_LEN];
+static uint8_t g_history_data[HISTORY_LEN * DEMO_DEVICE_STATUS_MSG_LENGTH];
+static PMLIN_sample_ring_t g_history;
+
+static PMLIN_mirror_def_t g_mirror_defs[] = { //
+		PMLIN_MIRROR_DEF(2, DEMO_DEVICE_STATUS_MSG_TYPE, g_status_2, 1, 0), //
+		};
+
+static PMLIN_device_decl_t g_device_defs[] = { //
+		DEMO_DEVICE_DEVICE_DECL(1), //
+		DEMO_DEVICE_DEVICE_DECL(2), //
+		DEMO_DEVICE_DEVICE_DECL(3), //
+		};
+
+typedef struct reader_t {
+	const char *m_name;
+	uint32_t m_period_us; // how often the reader looks at the history
+	uint32_t m_samples; // samples read
+	uint32_t m_lost; // samples overwritten before they were read
+	uint32_t m_bad; // samples that were not consistent or older than the previous one
+	uint32_t m_gaps; // samples missing from the counter sequence, the lost ones and the failed reads
+	uint32_t m_min_us, m_max_us; // intervals between consecutive samples
+} reader_t;
+
+static atomic_bool g_stop;
+
+static void* tick_thread_fun(void *arguments) {
+	struct timespec sleep = { 0, TICK_PERIOD_US * 1000L };
+	while (!atomic_load(&g_stop)) {
+		nanosleep(&sleep, NULL);
+		PMLIN_mirror_tick(NULL);
+	}
+	return NULL;
+}
+
+static void* reader_thread_fun(void *arguments) {
+	reader_t *r = arguments;
+	uint32_t cursor = PMLIN_sample_ring_head(&g_history);
+	uint64_t times[HISTORY_LEN];
+	uint8_t data[HISTORY_LEN][DEMO_DEVICE_STATUS_MSG_LENGTH];
+	uint64_t prev_time = 0;
+	uint8_t prev_count = 0;
+	bool first = true;
+	struct timespec sleep = { r->m_period_us / 1000000, (r->m_period_us % 1000000) * 1000L };
+	r->m_min_us = UINT32_MAX;
+	while (!atomic_load(&g_stop)) {
+		nanosleep(&sleep, NULL);
+		uint32_t lost;
+		uint32_t n = PMLIN_sample_ring_read(&g_history, &cursor, times, data, HISTORY_LEN, &lost);
+		r->m_lost += lost;
+		for (uint32_t i = 0; i < n; i++) {
+			r->m_samples++;
+			if (data[i][1] != (uint8_t) ~data[i][0] || (!first && times[i] <= prev_time)) {
+				r->m_bad++;
+				continue;
+			}
+			if (!first) {
+				uint32_t interval = (times[i] - prev_time) / 1000;
+				r->m_gaps += (uint8_t) (data[i][0] - prev_count - 1);
+				if (lost == 0 && i > 0) { // only intervals between samples that followed each other in the ring
+					r->m_min_us = interval < r->m_min_us ? interval : r->m_min_us;
+					r->m_max_us = interval > r->m_max_us ? interval : r->m_max_us;
+				}
+			}
+			first = false;
+			prev_time = times[i];
+			prev_count = data[i][0];
+		}
+	}
+	return NULL;
+}
+
+void history_demo(bool emu) {
+	printf("history_demo\n");
+	if (!emu || !g_demo_device_simulated_state) {
+		printf("needs the emulated slaves, use -e\n");
+		return;
+	}
+	g_history = PMLIN_SAMPLE_RING(g_history_slots, g_history_data, HISTORY_LEN, DEMO_DEVICE_STATUS_MSG_LENGTH);
+	g_mirror_defs[0].m_history = &g_history;
+	g_demo_device_simulated_state[1].m_check_complement = true;
+	PMLIN_DEFINE_DEVICES(g_device_defs);
+	PMLIN_set_tick_period_us(TICK_PERIOD_US);
+	PMLIN_DEFINE_MIRRORING(g_mirror_defs);
+
+	reader_t readers[] = { //
+			{ .m_name = "fast reader 1", .m_period_us = 20000 }, //
+			{ .m_name = "fast reader 2", .m_period_us = 33000 }, //
+			{ .m_name = "slow reader", .m_period_us = 1500000 }, //
+			};
+	const uint32_t num_readers = sizeof(readers) / sizeof(readers[0]);
+	pthread_t tick_thread;
+	pthread_t reader_threads[num_readers];
+	if (pthread_create(&tick_thread, NULL, tick_thread_fun, NULL))
+		return;
+	for (uint32_t i = 0; i < num_readers; i++)
+		pthread_create(&reader_threads[i], NULL, reader_thread_fun, &readers[i]);
+	struct timespec run = { RUN_TIME_US / 1000000, (RUN_TIME_US % 1000000) * 1000L };
+	nanosleep(&run, NULL);
+	atomic_store(&g_stop, true);
+	pthread_join(tick_thread, NULL);
+	for (uint32_t i = 0; i < num_readers; i++)
+		pthread_join(reader_threads[i], NULL);
+
+	printf("%d samples written to a history of %d\n", PMLIN_sample_ring_head(&g_history), HISTORY_LEN);
+	for (uint32_t i = 0; i < num_readers; i++) {
+		reader_t *r = &readers[i];
+		uint32_t intervals = r->m_min_us <= r->m_max_us;
+		printf("%s: %d samples read, %d lost, %d bad, %d missing from the sequence", r->m_name, r->m_samples,
+				r->m_lost, r->m_bad, r->m_gaps);
+		if (intervals)
+			printf(", sample interval min %d max %d usec", r->m_min_us, r->m_max_us);
+		printf("\n");
+	}
+	g_mirror_defs[0].m_history = NULL;
+	g_demo_device_simulated_state[1].m_check_complement = false;
+}
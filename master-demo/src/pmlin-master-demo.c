@@ -43,13 +43,33 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <time.h>
 #include <string.h>
 #include <sys/queue.h>
+#include <sys/mman.h>
 #include <pthread.h>
 #include <errno.h>
 
 #include "pmlin-master.h"
+#include "pmlin-posix-hal.h"
 #include "pmlin-command-line-demo.h"
 #include "pmlin-mirror-demo.h"
 #include "pmlin-autoconfig-demo.h"
+#include "pmlin-nonblocking-demo.h"
+#include "pmlin-queue-demo.h"
+#include "pmlin-break-demo.h"
+#include "pmlin-batch-demo.h"
+#include "pmlin-multibus-demo.h"
+#include "pmlin-uring-demo.h"
+#include "pmlin-mirror-bench-demo.h"
+#include "pmlin-send-now-demo.h"
+#include "pmlin-quarantine-demo.h"
+#include "pmlin-tear-free-demo.h"
+#include "pmlin-notify-demo.h"
+#include "pmlin-history-demo.h"
+#include "pmlin-swap-demo.h"
+#include "pmlin-group-demo.h"
+#include "pmlin-trigger-demo.h"
+#include "pmlin-type-swap-demo.h"
+#include "pmlin-exchange-demo.h"
+#include "pmlin-poll-demo.h"
 #include "pmlin.h"
 #include "demo-device.h"
 #include "pmlin-slave-emufun.h"
@@ -59,109 +79,6 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 volatile int g_pmlin_seril_port_fd;
 
-int pmlin_init_serial_port() {
-	char *port_name = SERIAL_PORT_NAME;
-	int com = open(port_name, O_RDWR | O_NOCTTY | O_NDELAY);
-	if (com < 0) {
-		perror(port_name);
-		exit(errno);
-	}
-
-	fcntl(com, F_SETFL, 0);
-
-	struct termios opts;
-
-	tcgetattr(com, &opts);
-
-	opts.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
-
-	opts.c_cflag |= (CLOCAL | CREAD);
-	opts.c_cflag &= ~PARENB;
-	opts.c_cflag |= CSTOPB; // two stop bits
-	opts.c_cflag &= ~CSIZE;
-	opts.c_cflag |= CS8;
-
-	opts.c_oflag &= ~OPOST;
-
-	opts.c_iflag &= ~INPCK;
-	opts.c_iflag &= ~(IXON | IXOFF | IXANY);
-	opts.c_cc[ VMIN] = 0;
-	opts.c_cc[ VTIME] = 10; //0.1 sec
-
-	cfsetispeed(&opts, PMLIN_BAUDRATE);
-	cfsetospeed(&opts, PMLIN_BAUDRATE);
-
-	if (tcsetattr(com, TCSANOW, &opts) != 0) {
-		perror(port_name);
-		abort();
-	}
-
-	tcflush(com, TCIOFLUSH); // just in case some crap is the buffers
-	return com;
-}
-
-void pmlin_write(uint8_t *buffer, uint16_t len) {
-	write(g_pmlin_seril_port_fd, (const void*) buffer, len);
-	tcdrain(g_pmlin_seril_port_fd);
-}
-
-uint16_t pmlin_read(uint8_t *buffer, uint16_t bytes_to_read, uint32_t timeout_ms) {
-	fd_set fdset;
-	for (uint16_t i = 0; i < bytes_to_read; i++) {
-		struct timeval tout;
-		tout.tv_usec = timeout_ms % 1000000;
-		tout.tv_sec = timeout_ms / 1000000;
-		FD_ZERO(&fdset);
-		FD_SET(g_pmlin_seril_port_fd, &fdset);
-		if (select(g_pmlin_seril_port_fd + 1, &fdset, NULL, NULL, &tout) < 0)
-			return i;
-		if (FD_ISSET(g_pmlin_seril_port_fd, &fdset)) {
-			int n = read(g_pmlin_seril_port_fd, buffer + i, 1);
-			if (n < 1)
-				return i;
-		} else
-			// timeout
-			return i;
-
-	}
-	return bytes_to_read;
-}
-
-void pmlin_send_break() {
-	usleep(1000);
-	tcflush(g_pmlin_seril_port_fd, TCIOFLUSH); // get rid of any extra crap
-	usleep(1000);
-
-	struct termios opts;
-
-	tcgetattr(g_pmlin_seril_port_fd, &opts);
-
-	// note! this relies on the non guaranteed fact that baudrate constant is actually the baudrate integer
-	cfsetispeed(&opts, PMLIN_BAUDRATE);
-	cfsetospeed(&opts, PMLIN_BAUDRATE);
-
-	if (tcsetattr(g_pmlin_seril_port_fd, TCSADRAIN, &opts) != 0) {
-		perror("abort()"__FILE__ "__LINE__");
-		abort();
-	}
-
-	cfsetispeed(&opts, PMLIN_BAUDRATE / 2);
-	cfsetospeed(&opts, PMLIN_BAUDRATE / 2);
-	tcsetattr(g_pmlin_seril_port_fd, TCSADRAIN, &opts); // wait for tx queue empty and then set baudrate
-
-	tcdrain(g_pmlin_seril_port_fd); // wait for chars to be sent (just in case)
-
-	// send break
-	char break_char = 0;
-	write(g_pmlin_seril_port_fd, &break_char, 1);
-	tcdrain(g_pmlin_seril_port_fd); // wait for the break char to be sent (does not realy work, hence next delay)
-	usleep(4*1000000 / (PMLIN_BAUDRATE/2/10)); // 2 msec delay
-	cfsetispeed(&opts, PMLIN_BAUDRATE);
-	cfsetospeed(&opts, PMLIN_BAUDRATE);
-	tcsetattr(g_pmlin_seril_port_fd, TCSADRAIN, &opts); // wait for tx queue empty and then set baudrate
-
-}
-
 int main(int argc, char *argv[]) {
 	uint16_t i;
 	bool emu = false;
@@ -178,28 +95,62 @@ int main(int argc, char *argv[]) {
 		printf("  0 : command_line_demo (CLI/REPL)\n");
 		printf("  1 : mirror_demo\n");
 		printf("  2 : autoconfig_demo\n");
+		printf("  3 : nonblocking_demo\n");
+		printf("  4 : queue_demo\n");
+		printf("  5 : break_demo\n");
+		printf("  6 : batch_demo\n");
+		printf("  7 : multibus_demo\n");
+		printf("  8 : uring_demo\n");
+		printf("  9 : mirror_bench_demo\n");
+		printf(" 10 : send_now_demo\n");
+		printf(" 11 : quarantine_demo\n");
+		printf(" 12 : tear_free_demo\n");
+		printf(" 13 : notify_demo\n");
+		printf(" 14 : history_demo\n");
+		printf(" 15 : swap_demo\n");
+		printf(" 16 : group_demo\n");
+		printf(" 17 : trigger_demo\n");
+		printf(" 18 : type_swap_demo\n");
+		printf(" 19 : exchange_demo\n");
+		printf(" 20 : poll_demo\n");
 		printf(" options:\n");
 		printf("  -t display PMLIN serial traffic\n");
 		printf("  -e emulate slaves (no hardware required)\n");
 		return 0;
 	}
 
+	uint8_t demo = atoi(argv[argc-1]);
 	if (emu) {
-		demo_device_simulated_state_t demo_device_simulated_state[3] = { 0 };
+		// shared so that the demos can see what the forked slaves do
+		demo_device_simulated_state_t *demo_device_simulated_state = mmap(NULL, 3 * sizeof(demo_device_simulated_state_t),
+				PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (demo_device_simulated_state == MAP_FAILED) {
+			perror("mmap");
+			exit(errno);
+		}
+		memset(demo_device_simulated_state, 0, 3 * sizeof(demo_device_simulated_state_t));
+		g_demo_device_simulated_state = demo_device_simulated_state;
 		pmlin_emulated_slave_descriptor_t slaves[] = {	//
 				PMLIN_EMULATED_SLAVE_DECL(demo_device_simu_function, &demo_device_simulated_state[0], DEMO_DEVICE_DEVICE_DECL(1)),	//
-				PMLIN_EMULATED_SLAVE_DECL(demo_device_simu_function, &demo_device_simulated_state[0], DEMO_DEVICE_DEVICE_DECL(2)),	//
-				PMLIN_EMULATED_SLAVE_DECL(demo_device_simu_function, &demo_device_simulated_state[0], DEMO_DEVICE_DEVICE_DECL(3)),	//
+				PMLIN_EMULATED_SLAVE_DECL(demo_device_simu_function, &demo_device_simulated_state[1], DEMO_DEVICE_DEVICE_DECL(2)),	//
+				PMLIN_EMULATED_SLAVE_DECL(demo_device_simu_function, &demo_device_simulated_state[2], DEMO_DEVICE_DEVICE_DECL(3)),	//
 				};	//
+		if (demo == 18) // type_swap_demo needs a slave of an other type
+			slaves[2].m_device_declarition.m_device_type = TYPE_SWAP_DEMO_OTHER_DEVICE_TYPE;
 
 		pmlin_start_emulated_slaves(&slaves, sizeof(slaves) / sizeof(slaves[0]));
 		pmlin_start_emulated_master();
 	} else {
-		g_pmlin_seril_port_fd = pmlin_init_serial_port();
-		PMLIN_initialize_master(pmlin_send_break, pmlin_write, pmlin_read, NULL, NULL, NULL);
+		g_pmlin_seril_port_fd = PMLIN_posix_open_serial_port(SERIAL_PORT_NAME);
+		if (g_pmlin_seril_port_fd < 0) {
+			perror(SERIAL_PORT_NAME);
+			exit(errno);
+		}
+		PMLIN_initialize_master(PMLIN_posix_send_break, PMLIN_posix_write, PMLIN_posix_read, NULL, NULL, NULL);
+		PMLIN_initialize_nonblocking(g_pmlin_seril_port_fd, PMLIN_posix_time_us);
+		PMLIN_set_read_gap_callback(PMLIN_posix_read_gap);
 	}
 
-	uint8_t demo = atoi(argv[argc-1]);
 	switch (demo) {
 	case 0:
 		command_line_demo(emu);
@@ -210,6 +161,60 @@ int main(int argc, char *argv[]) {
 	case 2:
 		autoconfig_demo(emu);
 		break;
+	case 3:
+		nonblocking_demo(emu);
+		break;
+	case 4:
+		queue_demo(emu);
+		break;
+	case 5:
+		break_demo(emu);
+		break;
+	case 6:
+		batch_demo(emu);
+		break;
+	case 7:
+		multibus_demo(emu);
+		break;
+	case 8:
+		uring_demo(emu);
+		break;
+	case 9:
+		mirror_bench_demo(emu);
+		break;
+	case 10:
+		send_now_demo(emu);
+		break;
+	case 11:
+		quarantine_demo(emu);
+		break;
+	case 12:
+		tear_free_demo(emu);
+		break;
+	case 13:
+		notify_demo(emu);
+		break;
+	case 14:
+		history_demo(emu);
+		break;
+	case 15:
+		swap_demo(emu);
+		break;
+	case 16:
+		group_demo(emu);
+		break;
+	case 17:
+		trigger_demo(emu);
+		break;
+	case 18:
+		type_swap_demo(emu);
+		break;
+	case 19:
+		exchange_demo(emu);
+		break;
+	case 20:
+		poll_demo(emu);
+		break;
 	}
 	if (emu)
 		pmlin_kill_emulated_slaves();
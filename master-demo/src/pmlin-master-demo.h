@@ -39,14 +39,6 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 extern volatile int g_pmlin_seril_port_fd;
 
-int pmlin_init_serial_port() ;
-
-void pmlin_write(uint8_t *buffer, uint16_t len) ;
-
-uint16_t pmlin_read(uint8_t *buffer, uint16_t bytes_to_read, uint32_t timeout_ms) ;
-
-void pmlin_send_break() ;
-
 extern uint8_t g_target_id;
 
 #endif
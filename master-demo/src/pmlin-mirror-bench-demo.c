@@ -0,0 +1,128 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "pmlin-mirror-bench-demo.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "pmlin-master.h"
+#include "pmlin-posix-hal.h"
+#include "pmlin-slave-emulator.h"
+
+#define BENCH_TICKS 100000
+#define CHECK_TICKS 5000
+#define FAST_PERIOD 10 // every tenth entry is a fast control/status mirror
+#define SLOW_PERIOD 1000 // the rest are slow diagnostics mirrors
+
+// Measures the cost of PMLIN_master_mirror_tick for mirroring tables of 10 to 10000 entries and compares it
+// to a scan of the whole table on every tick, which is how the mirror scheduler used to work.
+// No devices are defined so no messages are transferred and only the scheduling is measured.
+
+static void define_entries(PMLIN_mirror_def_t *mirroring, uint32_t n) {
+	static uint8_t buffer[8];
+	for (uint32_t i = 0; i < n; i++) {
+		uint16_t period = i % 10 == 0 ? FAST_PERIOD : SLOW_PERIOD;
+		mirroring[i] = PMLIN_MIRROR_DEF(1 + i % 30, 0, buffer, period, i % period);
+	}
+}
+
+// the scheduler as it used to be, returns the number of entries whose turn it is
+static uint32_t scan_tick(PMLIN_mirror_def_t *mirroring, uint16_t *ticker, uint32_t n, bool *due) {
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < n; i++) {
+		if (ticker[i])
+			ticker[i]--;
+		else
+			ticker[i] = mirroring[i].m_tick_period - 1;
+		due[i] = ticker[i] == mirroring[i].m_tick_phase;
+		count += due[i];
+	}
+	return count;
+}
+
+// checks that the timing wheel transfers the same entries on the same ticks as the scan
+static bool check_schedule(PMLIN_master_t *m, PMLIN_mirror_def_t *mirroring, uint16_t *ticker, uint32_t n, bool *due) {
+	for (uint32_t i = 0; i < n; i++)
+		ticker[i] = 0;
+	PMLIN_master_define_mirroring(m, mirroring, n);
+	for (uint32_t t = 0; t < CHECK_TICKS; t++) {
+		scan_tick(mirroring, ticker, n, due);
+		uint32_t *before = (uint32_t*) &ticker[n]; // scratch space after the tickers
+		for (uint32_t i = 0; i < n; i++)
+			before[i] = mirroring[i].m_due;
+		PMLIN_master_mirror_tick(m, NULL);
+		for (uint32_t i = 0; i < n; i++)
+			if ((mirroring[i].m_due != before[i]) != due[i]) {
+				printf("entry %u differs on tick %u\n", i, t + 1);
+				return false;
+			}
+	}
+	return true;
+}
+
+void mirror_bench_demo(bool emu) {
+	printf("mirror_bench_demo\n");
+	static PMLIN_master_t master;
+	PMLIN_master_initialize(&master, PMLIN_HAL(NULL, NULL, NULL, NULL), NULL, NULL, NULL);
+
+	printf("%8s %10s %14s %14s %8s\n", "entries", "due/tick", "wheel ns/tick", "scan ns/tick", "check");
+	for (uint32_t n = 10; n <= 10000; n *= 10) {
+		PMLIN_mirror_def_t *mirroring = malloc(n * sizeof(PMLIN_mirror_def_t));
+		uint16_t *ticker = malloc(n * (sizeof(uint16_t) + sizeof(uint32_t)));
+		bool *due = malloc(n * sizeof(bool));
+		if (!mirroring || !ticker || !due)
+			report_and_exit("malloc");
+		define_entries(mirroring, n);
+
+		bool ok = check_schedule(&master, mirroring, ticker, n, due);
+
+		PMLIN_master_define_mirroring(&master, mirroring, n);
+		uint32_t t0 = PMLIN_posix_time_us();
+		for (uint32_t t = 0; t < BENCH_TICKS; t++)
+			PMLIN_master_mirror_tick(&master, NULL);
+		uint32_t wheel_us = PMLIN_posix_time_us() - t0;
+
+		for (uint32_t i = 0; i < n; i++)
+			ticker[i] = 0;
+		uint64_t due_count = 0;
+		t0 = PMLIN_posix_time_us();
+		for (uint32_t t = 0; t < BENCH_TICKS; t++)
+			due_count += scan_tick(mirroring, ticker, n, due);
+		uint32_t scan_us = PMLIN_posix_time_us() - t0;
+
+		printf("%8u %10.2f %14.1f %14.1f %8s\n", n, due_count / (double) BENCH_TICKS, wheel_us * 1000.0 / BENCH_TICKS,
+				scan_us * 1000.0 / BENCH_TICKS, ok ? "ok" : "FAILED");
+		free(mirroring);
+		free(ticker);
+		free(due);
+	}
+}
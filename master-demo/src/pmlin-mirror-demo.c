@@ -35,6 +35,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "pmlin.h"
 #include "pmlin-master.h"
+#include "pmlin-schedule.h"
+#include "pmlin-tick-driver.h"
 #include "pmlin-slave.h"
 #include "demo-device.h"
 #include <stdint.h>
@@ -60,10 +62,11 @@ volatile demo_device_simulated_state_t g_device_B_simstate = {0};
 volatile demo_device_simulated_state_t g_device_C_simstate = {0};
 
 
+// the phases are assigned by PMLIN_compile_schedule
 PMLIN_mirror_def_t g_mirror_defs[] = { //
 		PMLIN_MIRROR_DEF(DEVICE_A, DEMO_DEVICE_CONTROL_MSG_TYPE, &g_device_A, 10, 0), //
-		PMLIN_MIRROR_DEF(DEVICE_B, DEMO_DEVICE_CONTROL_MSG_TYPE, &g_device_B, 10, 1), //
-		PMLIN_MIRROR_DEF(DEVICE_C, DEMO_DEVICE_CONTROL_MSG_TYPE,&g_device_C, 10, 2) //
+		PMLIN_MIRROR_DEF(DEVICE_B, DEMO_DEVICE_CONTROL_MSG_TYPE, &g_device_B, 10, 0), //
+		PMLIN_MIRROR_DEF(DEVICE_C, DEMO_DEVICE_CONTROL_MSG_TYPE,&g_device_C, 10, 0) //
 		};
 
 pmlin_emulated_slave_descriptor_t g_slave_defs[] = {	//
@@ -81,17 +84,9 @@ PMLIN_device_decl_t g_device_defs[] = { //
 
 
 
-static void* master_tick_thread_fun(void *arguments) {
-	uint32_t TIMER_PERIOD_uS = 10000; // mirroring at 100 msec period
-	struct timespec sleep = { 0, TIMER_PERIOD_uS * 1000L };
-	while (1) {
-		nanosleep(&sleep, NULL);
-		uint8_t id;
-		PMLIN_error_t res = PMLIN_mirror_tick(&id);
-		if (PMLIN_OK != res)
-			printf("error %s id %d\n", PMLIN_result_to_string(res),id);
-	}
-}
+#define TIMER_PERIOD_uS 10000 // mirror tick period, with a period of 10 ticks mirroring happens every 100 msec
+
+static PMLIN_tick_driver_t g_tick_driver;
 
 static void* blink_thread_fun(void *arguments) {
 	struct timespec sleep = { 1, 0}; // blink perio 1 sec
@@ -118,20 +113,49 @@ void mirror_demo(bool emu) {
 	if (PMLIN_OK != res)
 		printf("PMLIN_check_config: error %s id %d\n", PMLIN_result_to_string(res),failed_id);
 
-	PMLIN_DEFINE_MIRRORING(g_mirror_defs);
-
-	// create the master tick thread
-	pthread_t tick_thread;
-	if (pthread_create(&tick_thread, NULL, master_tick_thread_fun, NULL))
-		report_and_exit("");
+	PMLIN_set_tick_period_us(TIMER_PERIOD_uS);
+	// the outputs change about once a second, only send them when they do but at least every 2 seconds
+	PMLIN_set_mirror_keepalive(2000000 / TIMER_PERIOD_uS);
+	PMLIN_schedule_entry_t entries[sizeof(g_mirror_defs) / sizeof(g_mirror_defs[0])];
+	PMLIN_schedule_report_t report;
+	res = PMLIN_COMPILE_SCHEDULE(g_mirror_defs, entries, &report);
+	if (PMLIN_OVERLOAD_ERROR == res) {
+		// at the slow emulated baudrate a single frame outlasts the tick, so the ticks just run late, use the phases anyway
+		printf("PMLIN_compile_schedule: %d ticks overloaded, defining the mirroring anyway\n", report.m_overloaded_ticks);
+		res = PMLIN_DEFINE_MIRRORING(g_mirror_defs);
+	}
+	if (PMLIN_OK != res)
+		printf("PMLIN_compile_schedule: error %s\n", PMLIN_result_to_string(res));
+	printf("schedule repeats every %d ticks, busiest tick %d usec\n", report.m_hyperperiod, report.m_max_tick_load_us);
+	for (uint8_t i = 0; i < sizeof(g_mirror_defs) / sizeof(g_mirror_defs[0]); i++)
+		printf("  id %d type %d period %d phase %d: airtime %d usec, latency %d..%d usec\n", g_mirror_defs[i].m_device_id,
+				g_mirror_defs[i].m_message_type, g_mirror_defs[i].m_tick_period, g_mirror_defs[i].m_tick_phase,
+				entries[i].m_airtime_us, entries[i].m_best_latency_us, entries[i].m_worst_latency_us);
+
+	// start the master tick thread, real-time if we are allowed to
+	PMLIN_tick_config_t tick_config = PMLIN_TICK_CONFIG(TIMER_PERIOD_uS);
+	tick_config.m_priority = 50;
+	tick_config.m_lock_memory = true;
+	if (PMLIN_OK != PMLIN_tick_driver_start(&g_tick_driver, NULL, &tick_config))
+		report_and_exit("PMLIN_tick_driver_start");
 
 	// for demo let us put the actual blinking of outputs into an other thread
 	pthread_t blink_thread;
 	if (pthread_create(&blink_thread, NULL, blink_thread_fun, NULL))
 		report_and_exit("");
 
+	// report the bus utilization every few seconds for capacity planning
 	while (1) {
-		// printf("sleeping...\n");
-		sleep(1);
+		sleep(5);
+		PMLIN_utilization_t u;
+		PMLIN_get_utilization(&u, true);
+		printf("bus utilization predicted %d.%d%% actual %d.%d%% (%d frames, %d unchanged skipped)\n", u.m_predicted_permille / 10,
+				u.m_predicted_permille % 10, u.m_actual_permille / 10, u.m_actual_permille % 10, u.m_frames, u.m_mirror_skipped);
+		PMLIN_tick_stats_t t;
+		PMLIN_tick_driver_get_stats(&g_tick_driver, &t, true);
+		printf("ticks %d (%s%s), missed %d, late %d, errors %d, jitter p50 %d p99 %d p99.9 %d max %d usec, longest tick %d usec\n",
+				t.m_ticks, t.m_realtime ? "SCHED_FIFO" : "not real-time", t.m_memory_locked ? ", memory locked" : "",
+				t.m_missed, t.m_late, t.m_errors, t.m_jitter_p50_us, t.m_jitter_p99_us, t.m_jitter_p999_us, t.m_jitter_max_us,
+				t.m_max_duration_us);
 	}
 }
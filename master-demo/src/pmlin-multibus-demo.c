@@ -0,0 +1,125 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "pmlin-multibus-demo.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "pmlin.h"
+#include "pmlin-master.h"
+#include "pmlin-posix-hal.h"
+#include "pmlin-pty-slave.h"
+#include "pmlin-slave-emulator.h"
+#include "demo-device.h"
+
+#define NUM_BUSES 3
+#define TRANSFERS_PER_BUS 200
+
+// Runs three buses in parallel, each from its own thread with its own PMLIN_master_t, serial port and device table.
+// The serial ports are pseudo terminals with a minimal slave at the far end (see pmlin-pty-slave.c),
+// so the demo always runs without hardware. Each bus has a device with the same id to show that they are independent.
+
+typedef struct {
+	PMLIN_master_t m_master;
+	PMLIN_posix_port_t m_port;
+	pthread_mutex_t m_mutex;
+	pmlin_pty_slave_t m_slave;
+	PMLIN_device_decl_t m_devices[1];
+	uint32_t m_errors;
+	uint32_t m_elapsed_us;
+} bus_t;
+
+static void* bus_thread_fun(void *arguments) {
+	bus_t *bus = arguments;
+	PMLIN_master_t *m = &bus->m_master;
+	uint8_t control[DEMO_DEVICE_CONTROL_MSG_LENGTH] = { 0 };
+	uint8_t status[DEMO_DEVICE_STATUS_MSG_LENGTH] = { 0 };
+	uint8_t id = bus->m_devices[0].m_id;
+
+	uint32_t t0 = PMLIN_posix_time_us();
+	PMLIN_error_t res = PMLIN_master_check_config(m, NULL);
+	if (res != PMLIN_OK)
+		bus->m_errors++;
+	for (uint16_t i = 0; i < TRANSFERS_PER_BUS; i++) {
+		control[0] = i;
+		if (PMLIN_OK != PMLIN_master_send_message(m, id, DEMO_DEVICE_CONTROL_MSG_TYPE, sizeof(control), control))
+			bus->m_errors++;
+		if (PMLIN_OK != PMLIN_master_receive_message(m, id, DEMO_DEVICE_STATUS_MSG_TYPE, sizeof(status), status))
+			bus->m_errors++;
+	}
+	bus->m_elapsed_us = PMLIN_posix_time_us() - t0;
+	return NULL;
+}
+
+void multibus_demo(bool emu) {
+	printf("multibus_demo\n");
+	static bus_t buses[NUM_BUSES];
+	pthread_t threads[NUM_BUSES];
+
+	for (uint8_t i = 0; i < NUM_BUSES; i++) {
+		bus_t *bus = &buses[i];
+		bus->m_devices[0] = (PMLIN_device_decl_t) DEMO_DEVICE_DEVICE_DECL(1);
+		const char *name = pmlin_pty_slave_start(&bus->m_slave, &bus->m_devices[0]);
+		if (PMLIN_posix_port_open(&bus->m_port, name) < 0)
+			report_and_exit(name);
+		pthread_mutexattr_t attr;
+		pthread_mutexattr_init(&attr);
+		pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+		if (pthread_mutex_init(&bus->m_mutex, &attr))
+			report_and_exit("pthread_mutex_init");
+		PMLIN_master_initialize(&bus->m_master, PMLIN_POSIX_HAL(&bus->m_port), &bus->m_mutex, //
+				(void*) pthread_mutex_lock, // cast to void to bypass warnings
+				(void*) pthread_mutex_unlock // cast to void to bypass warnings
+				);
+		PMLIN_master_initialize_nonblocking(&bus->m_master, bus->m_port.m_fd, PMLIN_posix_time_us);
+		PMLIN_MASTER_DEFINE_DEVICES(&bus->m_master, bus->m_devices);
+	}
+
+	uint32_t t0 = PMLIN_posix_time_us();
+	for (uint8_t i = 0; i < NUM_BUSES; i++)
+		if (pthread_create(&threads[i], NULL, bus_thread_fun, &buses[i]))
+			report_and_exit("pthread_create");
+	uint32_t sum = 0;
+	for (uint8_t i = 0; i < NUM_BUSES; i++) {
+		pthread_join(threads[i], NULL);
+		sum += buses[i].m_elapsed_us;
+		printf("bus %d: %d transfers, %d errors in %d msec\n", i, 2 * TRANSFERS_PER_BUS, buses[i].m_errors, buses[i].m_elapsed_us / 1000);
+	}
+	printf("all buses done in %d msec, %d msec if run one after the other\n", (PMLIN_posix_time_us() - t0) / 1000, sum / 1000);
+
+	for (uint8_t i = 0; i < NUM_BUSES; i++) {
+		pmlin_pty_slave_stop(&buses[i].m_slave);
+		close(buses[i].m_port.m_fd);
+		pthread_mutex_destroy(&buses[i].m_mutex);
+	}
+}
@@ -0,0 +1,67 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "pmlin-nonblocking-demo.h"
+
+#include <stdio.h>
+#include <poll.h>
+#include "pmlin.h"
+#include "pmlin-master.h"
+#include "demo-device.h"
+
+// Runs status reads to a few devices (one of which is not present) using the non-blocking API
+// from a single poll() loop that could equally well serve other file descriptors.
+
+void nonblocking_demo(bool emu) {
+	printf("nonblocking_demo\n");
+
+	uint8_t status[4][DEMO_DEVICE_STATUS_MSG_LENGTH] = { 0 };
+	uint8_t ids[] = { 1, 2, 3, 4 }; // id 4 is not present in the emulated network
+
+	for (uint8_t i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+		PMLIN_transaction_t t = PMLIN_RECEIVE_TRANSACTION(ids[i], DEMO_DEVICE_STATUS_MSG_TYPE, DEMO_DEVICE_STATUS_MSG_LENGTH, status[i]);
+		PMLIN_error_t res = PMLIN_start_transaction(&t);
+		if (res != PMLIN_OK) {
+			printf("PMLIN_start_transaction: error %s\n", PMLIN_result_to_string(res));
+			return;
+		}
+		uint32_t wakeups = 0;
+		while (!PMLIN_step_transaction(&t)) {
+			struct pollfd pfd = { .fd = PMLIN_get_poll_fd(), .events = POLLIN };
+			// other file descriptors would be added here and serviced when they become ready
+			poll(&pfd, 1, (PMLIN_transaction_time_left(&t) + 999) / 1000);
+			wakeups++;
+		}
+		printf("device id %d status read %s after %d wakeups\n", ids[i], PMLIN_result_to_string(t.m_result), wakeups);
+	}
+}
@@ -0,0 +1,150 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "pmlin-notify-demo.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+#include "pmlin-master.h"
+#include "pmlin-posix-hal.h"
+#include "demo-device.h"
+#include "pmlin-slave-emufun.h"
+
+// Waits in poll() for the status of the emulated slaves to change instead of polling the mirroring buffers.
+// The demo "presses a button" on a slave by changing its status in the shared simulated state and measures
+// the time until the change notification wakes up the poll loop.
+
+#define TICK_PERIOD_US 10000
+#define STATUS_PERIOD 5 // status is mirrored every 50 msec
+#define PRESSES 10
+
+static volatile uint8_t g_status_2[DEMO_DEVICE_STATUS_MSG_LENGTH];
+static volatile uint8_t g_status_3[DEMO_DEVICE_STATUS_MSG_LENGTH];
+static volatile uint8_t g_control_1[DEMO_DEVICE_CONTROL_MSG_LENGTH];
+
+static PMLIN_mirror_def_t g_mirror_defs[] = { //
+		PMLIN_MIRROR_DEF(2, DEMO_DEVICE_STATUS_MSG_TYPE, g_status_2, STATUS_PERIOD, 0), //
+		PMLIN_MIRROR_DEF(3, DEMO_DEVICE_STATUS_MSG_TYPE, g_status_3, STATUS_PERIOD, 2), //
+		PMLIN_MIRROR_DEF(1, DEMO_DEVICE_CONTROL_MSG_TYPE, g_control_1, 10, 4), //
+		};
+
+static PMLIN_device_decl_t g_device_defs[] = { //
+		DEMO_DEVICE_DEVICE_DECL(1), //
+		DEMO_DEVICE_DEVICE_DECL(2), //
+		DEMO_DEVICE_DEVICE_DECL(3), //
+		};
+
+static atomic_bool g_stop;
+static atomic_uint g_changed_entries;
+
+static void* tick_thread_fun(void *arguments) {
+	struct timespec sleep = { 0, TICK_PERIOD_US * 1000L };
+	while (!atomic_load(&g_stop)) {
+		nanosleep(&sleep, NULL);
+		PMLIN_mirror_tick(NULL);
+	}
+	return NULL;
+}
+
+// counts the changed entries and leaves the wakeup to the POSIX HAL
+static void changed(PMLIN_mirror_def_t *mirror, void *user) {
+	if (mirror)
+		atomic_fetch_add(&g_changed_entries, 1);
+	PMLIN_posix_notify_fd(mirror, user);
+}
+
+// waits for a notification, returns the number of ticks with changes signalled or 0 on timeout
+static uint64_t wait_for_change(int fd, int timeout_ms) {
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	uint64_t ticks = 0;
+	if (poll(&pfd, 1, timeout_ms) == 1 && read(fd, &ticks, sizeof(ticks)) != sizeof(ticks))
+		ticks = 0;
+	return ticks;
+}
+
+void notify_demo(bool emu) {
+	printf("notify_demo\n");
+	if (!emu || !g_demo_device_simulated_state) {
+		printf("needs the emulated slaves, use -e\n");
+		return;
+	}
+	int fd = eventfd(0, EFD_NONBLOCK);
+	if (fd < 0) {
+		perror("eventfd");
+		return;
+	}
+	PMLIN_DEFINE_DEVICES(g_device_defs);
+	PMLIN_set_tick_period_us(TICK_PERIOD_US);
+	PMLIN_DEFINE_MIRRORING(g_mirror_defs);
+	PMLIN_set_mirror_changed_callback(changed, (void*) (intptr_t) fd);
+
+	pthread_t tick_thread;
+	if (pthread_create(&tick_thread, NULL, tick_thread_fun, NULL))
+		return;
+	// the first payloads received count as changes, give all the entries time to get theirs
+	struct timespec settle = { 0, 200000000L };
+	nanosleep(&settle, NULL);
+	uint64_t ticks = wait_for_change(fd, 0);
+	printf("initial status received, %d entries changed on %d ticks\n", atomic_exchange(&g_changed_entries, 0), (int) ticks);
+
+	uint32_t min = UINT32_MAX, max = 0, sum = 0, n = 0;
+	volatile uint8_t *button = &g_demo_device_simulated_state[1].m_control_data_out[0];
+	for (uint32_t i = 0; i < PRESSES; i++) {
+		struct timespec pause = { 0, (113 + 37 * i) * 1000000L };
+		nanosleep(&pause, NULL);
+		uint32_t t_press = PMLIN_posix_time_us();
+		*button ^= 1;
+		if (!wait_for_change(fd, 2000))
+			continue;
+		uint32_t latency = PMLIN_posix_time_us() - t_press;
+		min = latency < min ? latency : min;
+		max = latency > max ? latency : max;
+		sum += latency;
+		n++;
+	}
+	printf("%d/%d button presses noticed, %d entries changed, press to wakeup min %d avg %d max %d usec\n", n,
+			PRESSES, atomic_exchange(&g_changed_entries, 0), n ? min : 0, n ? sum / n : 0, max);
+
+	uint64_t wakeups = wait_for_change(fd, 1000);
+	printf("no presses for a second, %d wakeups\n", (int) wakeups);
+
+	atomic_store(&g_stop, true);
+	pthread_join(tick_thread, NULL);
+	PMLIN_set_mirror_changed_callback(NULL, NULL);
+	close(fd);
+}
@@ -0,0 +1,113 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "pmlin-poll-demo.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include "pmlin-master.h"
+#include "pmlin-posix-hal.h"
+#include "demo-device.h"
+#include "pmlin-slave-emufun.h"
+
+// Reads the status of ids 1 to 4, where only 1 to 3 are present, first with a frame for each id and then
+// with one slotted poll, and compares the results and the bus time. The slaves make each status self
+// consistent so that a payload picked from the wrong place shows.
+
+#define ROUNDS 50
+#define FIRST_ID 1
+#define LAST_ID 4
+#define SLOTS (LAST_ID - FIRST_ID + 1)
+#define GUARD_US 3000 // the emulated slaves are polled, not interrupt driven, so they need a generous guard
+
+static uint8_t g_status[SLOTS][DEMO_DEVICE_STATUS_MSG_LENGTH];
+static PMLIN_error_t g_results[SLOTS];
+
+typedef struct {
+	uint32_t m_ok[SLOTS];
+	uint32_t m_torn;
+} tally_t;
+
+static void count(tally_t *tally) {
+	for (uint8_t i = 0; i < SLOTS; i++) {
+		if (g_results[i] != PMLIN_OK)
+			continue;
+		tally->m_ok[i]++;
+		tally->m_torn += g_status[i][1] != (uint8_t) ~g_status[i][0];
+	}
+}
+
+static void report(const char *how, tally_t *tally) {
+	PMLIN_utilization_t u;
+	PMLIN_get_utilization(&u, true);
+	printf("%-9s %4d frames, bus busy %6d usec per round, ok per id", how, u.m_frames, (uint32_t) (u.m_busy_us / ROUNDS));
+	for (uint8_t i = 0; i < SLOTS; i++)
+		printf(" %d:%d", FIRST_ID + i, tally->m_ok[i]);
+	printf(", %d torn statuses\n", tally->m_torn);
+}
+
+void poll_demo(bool emu) {
+	printf("poll_demo\n");
+	if (!emu || !g_demo_device_simulated_state) {
+		printf("needs the emulated slaves, use -e\n");
+		return;
+	}
+	for (uint8_t i = 0; i < 3; i++)
+		g_demo_device_simulated_state[i].m_check_complement = true;
+	PMLIN_utilization_t u;
+	PMLIN_get_utilization(&u, true);
+
+	tally_t separate = { 0 };
+	for (uint32_t round = 0; round < ROUNDS; round++) {
+		for (uint8_t i = 0; i < SLOTS; i++)
+			g_results[i] = PMLIN_receive_message(FIRST_ID + i, DEMO_DEVICE_STATUS_MSG_TYPE, DEMO_DEVICE_STATUS_MSG_LENGTH,
+					g_status[i]);
+		count(&separate);
+	}
+	report("separate", &separate);
+
+	PMLIN_set_poll_guard_us(GUARD_US);
+	tally_t polled = { 0 };
+	for (uint32_t round = 0; round < ROUNDS; round++) {
+		PMLIN_poll_messages(DEMO_DEVICE_STATUS_MSG_TYPE, FIRST_ID, LAST_ID, DEMO_DEVICE_STATUS_MSG_LENGTH, &g_status[0][0],
+				g_results);
+		count(&polled);
+	}
+	report("polled", &polled);
+	printf("last poll:");
+	for (uint8_t i = 0; i < SLOTS; i++)
+		printf(" id %d %s", FIRST_ID + i, PMLIN_result_to_string(g_results[i]));
+	printf("\n");
+	PMLIN_set_poll_guard_us(PMLIN_DEFAULT_POLL_GUARD_US);
+	for (uint8_t i = 0; i < 3; i++)
+		g_demo_device_simulated_state[i].m_check_complement = false;
+}
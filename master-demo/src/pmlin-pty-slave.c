@@ -0,0 +1,155 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#define _XOPEN_SOURCE 600 // for posix_openpt() and friends
+
+#include "pmlin-pty-slave.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include "pmlin.h"
+#include "pmlin-master.h"
+#include "pmlin-slave-emulator.h"
+
+// A minimal PMLIN slave at the far end of a pseudo terminal, used to exercise the POSIX HAL without hardware.
+// Everything the master sends is echoed back as it would be on the wire. Pseudo terminals do not pass BREAKs
+// so a frame is taken to start after the slave has responded or the line has been idle, the BREAK is echoed as a zero.
+
+#define PTY_SLAVE_IDLE_MS 1
+
+static void pty_write(pmlin_pty_slave_t *slave, uint8_t *buffer, uint16_t len) {
+	if (len != write(slave->m_pty, buffer, len))
+		report_and_exit("pty_write");
+}
+
+static uint8_t pty_payload_crc(uint8_t *payload, uint16_t len) {
+	uint8_t crc = PMLIN_CRC_INIT_VAL;
+	for (uint16_t i = 0; i < len; i++)
+		crc = PMLIN_crc8(crc, payload[i]);
+	return crc;
+}
+
+// sends a response payload followed by its crc
+static void pty_respond(pmlin_pty_slave_t *slave, uint8_t *payload, uint16_t len) {
+	uint8_t crc = pty_payload_crc(payload, len);
+	pty_write(slave, payload, len);
+	pty_write(slave, &crc, 1);
+}
+
+static void* pty_slave_thread(void *arguments) {
+	pmlin_pty_slave_t *slave = arguments;
+	PMLIN_device_decl_t *device = slave->m_device;
+	uint8_t frame[PMLIN_MAX_FRAME_LEN];
+	uint16_t n = 0;
+	uint16_t expect = 0; // frame length after which the slave responds, zero if not addressed
+	while (!slave->m_stop) {
+		struct pollfd pfd = { .fd = slave->m_pty, .events = POLLIN };
+		if (poll(&pfd, 1, PTY_SLAVE_IDLE_MS) <= 0) {
+			n = 0; // line idle, the next byte starts a new frame
+			continue;
+		}
+		uint8_t rx[64];
+		ssize_t r = read(slave->m_pty, rx, sizeof(rx));
+		for (ssize_t i = 0; i < r; i++) {
+			if (n == 0) {
+				uint8_t brk = 0;
+				pty_write(slave, &brk, 1);
+				expect = 0;
+			}
+			pty_write(slave, &rx[i], 1);
+			if (n >= sizeof(frame))
+				continue;
+			frame[n++] = rx[i];
+			if (n == PMLIN_HEADER_LEN) {
+				uint8_t type = frame[0] >> PMLIN_MSG_TYPE_BITPOS;
+				if ((frame[0] & PMLIN_MSG_ID_MASK) != device->m_id || PMLIN_crc8(PMLIN_CRC_INIT_VAL, frame[0]) != frame[1])
+					continue;
+				if (type == PMLIN_MESSAGE_TYPE_CMD)
+					expect = PMLIN_HEADER_LEN + PMLIN_CMD_MSG_LEN + 1;
+				else if (device->m_messages[type].m_message_dir != PMLIN_SLAVE_TO_HOST)
+					expect = PMLIN_HEADER_LEN + device->m_messages[type].m_message_length + 1;
+				else if (device->m_messages[type].m_message_length > 0) {
+					uint8_t payload[255];
+					uint8_t len = device->m_messages[type].m_message_length;
+					for (uint16_t j = 0; j < len; j++)
+						payload[j] = slave->m_counter;
+					slave->m_counter++;
+					pty_respond(slave, payload, len);
+					n = 0; // frame done
+				}
+			} else if (expect && n == expect) {
+				uint8_t len = expect - PMLIN_HEADER_LEN - 1;
+				if (pty_payload_crc(&frame[PMLIN_HEADER_LEN], len) != frame[expect - 1])
+					continue; // no response, the master will see a timeout
+				if (frame[0] >> PMLIN_MSG_TYPE_BITPOS == PMLIN_MESSAGE_TYPE_CMD) {
+					uint8_t resp[PMLIN_CMD_RESP_LEN] = { 0 };
+					resp[PMLIN_CMD_RESP_DEV_TYPE_MSB_IDX] = device->m_device_type >> 8;
+					resp[PMLIN_CMD_RESP_DEV_TYPE_LSB_IDX] = device->m_device_type & 0xFF;
+					pty_respond(slave, resp, sizeof(resp));
+				} else if (device->m_messages[frame[0] >> PMLIN_MSG_TYPE_BITPOS].m_message_dir == PMLIN_EXCHANGE) {
+					uint8_t payload[255];
+					uint8_t len = device->m_messages[frame[0] >> PMLIN_MSG_TYPE_BITPOS].m_response_length;
+					for (uint16_t j = 0; j < len; j++)
+						payload[j] = slave->m_counter;
+					slave->m_counter++;
+					pty_respond(slave, payload, len);
+				} else {
+					uint8_t ack = PMLIN_ACK_CHAR;
+					pty_write(slave, &ack, 1);
+				}
+				n = 0; // frame done
+			}
+		}
+	}
+	return NULL;
+}
+
+const char* pmlin_pty_slave_start(pmlin_pty_slave_t *slave, PMLIN_device_decl_t *device) {
+	slave->m_device = device;
+	slave->m_counter = 0;
+	slave->m_stop = false;
+	slave->m_pty = posix_openpt(O_RDWR | O_NOCTTY);
+	if (slave->m_pty < 0 || grantpt(slave->m_pty) || unlockpt(slave->m_pty))
+		report_and_exit("posix_openpt");
+	if (pthread_create(&slave->m_thread, NULL, pty_slave_thread, slave))
+		report_and_exit("pthread_create");
+	return ptsname(slave->m_pty);
+}
+
+void pmlin_pty_slave_stop(pmlin_pty_slave_t *slave) {
+	slave->m_stop = true;
+	pthread_join(slave->m_thread, NULL);
+	close(slave->m_pty);
+}
@@ -0,0 +1,60 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __PMLIN_PTY_SLAVE_H__
+#define __PMLIN_PTY_SLAVE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "pmlin.h"
+
+// this structure holds one slave device answering at the far end of a pseudo terminal
+typedef struct pmlin_pty_slave_t {
+	int m_pty; // master side of the pseudo terminal
+	PMLIN_device_decl_t *m_device; // the device this slave pretends to be
+	uint8_t m_counter; // value of the bytes of the next slave to host message
+	volatile bool m_stop;
+	pthread_t m_thread;
+} pmlin_pty_slave_t;
+
+// Purpose: Create a pseudo terminal and start a thread that answers to the master on it as the given device
+// Returns:					The name of the terminal to open as the PMLIN serial port
+
+const char* pmlin_pty_slave_start(pmlin_pty_slave_t *slave, PMLIN_device_decl_t *device);
+
+// Purpose: Stop the slave thread and close the pseudo terminal
+
+void pmlin_pty_slave_stop(pmlin_pty_slave_t *slave);
+
+#endif
@@ -0,0 +1,109 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "pmlin-quarantine-demo.h"
+
+#include <stdio.h>
+#include "pmlin-master.h"
+#include "pmlin-posix-hal.h"
+#include "demo-device.h"
+#include "pmlin-slave-emufun.h"
+
+// Mirrors the status of three emulated slaves on every tick, unplugs one of them and compares the tick time
+// and the results of the other two with and without quarantine, then plugs it back and waits for a probe to
+// find it.
+
+#define TICKS 100
+
+static volatile uint8_t g_status[3][DEMO_DEVICE_STATUS_MSG_LENGTH];
+
+static PMLIN_mirror_def_t g_mirror_defs[] = { //
+		PMLIN_MIRROR_DEF(1, DEMO_DEVICE_STATUS_MSG_TYPE, g_status[0], 1, 0), //
+		PMLIN_MIRROR_DEF(2, DEMO_DEVICE_STATUS_MSG_TYPE, g_status[1], 1, 0), //
+		PMLIN_MIRROR_DEF(3, DEMO_DEVICE_STATUS_MSG_TYPE, g_status[2], 1, 0), //
+		};
+
+static PMLIN_device_decl_t g_device_defs[] = { //
+		DEMO_DEVICE_DEVICE_DECL(1), //
+		DEMO_DEVICE_DEVICE_DECL(2), //
+		DEMO_DEVICE_DEVICE_DECL(3), //
+		};
+
+// runs back to back ticks and prints the average tick time and the failures of the devices still present
+static void run_ticks(const char *title) {
+	uint32_t failures = 0;
+	uint32_t t0 = PMLIN_posix_time_us();
+	for (uint32_t i = 0; i < TICKS; i++) {
+		PMLIN_mirror_tick(NULL);
+		failures += (g_mirror_defs[0].m_result != PMLIN_OK) + (g_mirror_defs[1].m_result != PMLIN_OK);
+	}
+	uint32_t elapsed = PMLIN_posix_time_us() - t0;
+	PMLIN_device_health_t health;
+	PMLIN_get_device_health(3, &health);
+	printf("%-28s %6d usec/tick, id 1 and 2 failures %d, id 3 %s %s\n", title, elapsed / TICKS, failures,
+			PMLIN_result_to_string(health.m_last_result), health.m_quarantined ? "in quarantine" : "");
+}
+
+void quarantine_demo(bool emu) {
+	printf("quarantine_demo\n");
+	if (!emu || !g_demo_device_simulated_state) {
+		printf("needs the emulated slaves, use -e\n");
+		return;
+	}
+	PMLIN_DEFINE_DEVICES(g_device_defs);
+	PMLIN_set_tick_period_us(100000); // the ticks run back to back, this just keeps the admission control happy
+	PMLIN_error_t res = PMLIN_DEFINE_MIRRORING(g_mirror_defs);
+	if (res != PMLIN_OK) {
+		printf("PMLIN_define_mirroring: error %s\n", PMLIN_result_to_string(res));
+		return;
+	}
+	run_ticks("all present");
+
+	g_demo_device_simulated_state[2].m_unplugged = true;
+	PMLIN_set_quarantine(0, 0, 0);
+	run_ticks("id 3 unplugged");
+	PMLIN_set_quarantine(PMLIN_DEFAULT_QUARANTINE_FAILURES, PMLIN_DEFAULT_MIN_BACKOFF_TICKS, PMLIN_DEFAULT_MAX_BACKOFF_TICKS);
+	run_ticks("id 3 unplugged, quarantine");
+	run_ticks("id 3 unplugged, quarantine");
+
+	g_demo_device_simulated_state[2].m_unplugged = false;
+	PMLIN_device_health_t health;
+	uint32_t ticks = 0;
+	do {
+		PMLIN_mirror_tick(NULL);
+		ticks++;
+		PMLIN_get_device_health(3, &health);
+	} while (health.m_quarantined && ticks < 10000);
+	printf("id 3 plugged back, found by a probe after %d ticks (backoff %d ticks, %d quarantines)\n", ticks,
+			health.m_backoff_ticks, health.m_quarantines);
+	run_ticks("all present");
+}
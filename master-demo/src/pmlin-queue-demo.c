@@ -0,0 +1,133 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "pmlin-queue-demo.h"
+
+#include <stdio.h>
+#include <pthread.h>
+#include "pmlin.h"
+#include "pmlin-master.h"
+#include "pmlin-master-queue.h"
+#include "demo-device.h"
+#include "pmlin-slave-emulator.h"
+
+#define REQUESTS_PER_THREAD 20
+#define MIRROR_TICKS 40
+
+// Three threads each read the status of 'their' device through the bus thread,
+// half of the requests are waited on and half are reported via the completion callback.
+// Meanwhile a fourth thread drives the mirroring by submitting mirror tick requests so
+// that the mirror tick runs on the bus thread in between the other requests.
+
+static atomic_uint g_errors;
+static atomic_uint g_mirror_errors;
+
+static volatile uint8_t g_control[DEMO_DEVICE_CONTROL_MSG_LENGTH];
+
+static PMLIN_mirror_def_t g_mirror_defs[] = { //
+		PMLIN_MIRROR_DEF(1, DEMO_DEVICE_CONTROL_MSG_TYPE, g_control, 1, 0) //
+		};
+
+static void status_completion(PMLIN_request_t *request) {
+	if (request->m_transaction.m_result != PMLIN_OK)
+		atomic_fetch_add(&g_errors, 1);
+}
+
+static void* client_thread_fun(void *arguments) {
+	uint8_t id = *(uint8_t*) arguments;
+	uint8_t status[REQUESTS_PER_THREAD][DEMO_DEVICE_STATUS_MSG_LENGTH];
+	PMLIN_request_t requests[REQUESTS_PER_THREAD];
+	for (uint16_t i = 0; i < REQUESTS_PER_THREAD; i++) {
+		requests[i] = PMLIN_REQUEST(
+				PMLIN_RECEIVE_TRANSACTION(id, DEMO_DEVICE_STATUS_MSG_TYPE, DEMO_DEVICE_STATUS_MSG_LENGTH, status[i]),
+				i & 1 ? status_completion : NULL, NULL);
+		PMLIN_error_t res = PMLIN_submit_request(&requests[i]);
+		if (res != PMLIN_OK) {
+			printf("PMLIN_submit_request: error %s\n", PMLIN_result_to_string(res));
+			return NULL;
+		}
+		if (!(i & 1) && PMLIN_wait_request(&requests[i]) != PMLIN_OK)
+			atomic_fetch_add(&g_errors, 1);
+	}
+	// requests live on this stack so wait for all of them before returning
+	for (uint16_t i = 0; i < REQUESTS_PER_THREAD; i++)
+		PMLIN_wait_request(&requests[i]);
+	return NULL;
+}
+
+static void* ticker_thread_fun(void *arguments) {
+	(void) arguments;
+	for (uint16_t i = 0; i < MIRROR_TICKS; i++) {
+		g_control[0] = i;
+		PMLIN_request_t request = PMLIN_MIRROR_TICK_REQUEST(NULL, NULL);
+		PMLIN_error_t res = PMLIN_submit_request(&request);
+		if (res != PMLIN_OK) {
+			printf("PMLIN_submit_request: error %s\n", PMLIN_result_to_string(res));
+			return NULL;
+		}
+		if (PMLIN_wait_request(&request) != PMLIN_OK) {
+			printf("mirror tick: device %d error %s\n", request.m_device_id, PMLIN_result_to_string(request.m_transaction.m_result));
+			atomic_fetch_add(&g_mirror_errors, 1);
+		}
+	}
+	return NULL;
+}
+
+void queue_demo(bool emu) {
+	printf("queue_demo\n");
+	PMLIN_define_mirroring(g_mirror_defs, sizeof(g_mirror_defs) / sizeof(g_mirror_defs[0]));
+	if (PMLIN_start_bus_thread() != PMLIN_OK)
+		report_and_exit("PMLIN_start_bus_thread");
+
+	uint8_t ids[] = { 1, 2, 3 };
+	pthread_t threads[sizeof(ids)];
+	pthread_t ticker;
+	for (uint8_t i = 0; i < sizeof(ids); i++) {
+		if (pthread_create(&threads[i], NULL, client_thread_fun, &ids[i]))
+			report_and_exit("pthread_create");
+	}
+	if (pthread_create(&ticker, NULL, ticker_thread_fun, NULL))
+		report_and_exit("pthread_create");
+	for (uint8_t i = 0; i < sizeof(ids); i++)
+		pthread_join(threads[i], NULL);
+	pthread_join(ticker, NULL);
+	PMLIN_stop_bus_thread();
+	PMLIN_define_mirroring(NULL, 0);
+
+	PMLIN_queue_stats_t stats;
+	PMLIN_get_queue_stats(&stats, false);
+	printf("submitted %d rejected %d completed %d errors %d mirror tick errors %d\n", stats.m_submitted, stats.m_rejected, stats.m_completed,
+			atomic_load(&g_errors), atomic_load(&g_mirror_errors));
+	printf("max queue depth %d, queue wait max %d usec avg %d usec\n", stats.m_max_depth, stats.m_max_wait_us,
+			stats.m_completed ? (uint32_t) (stats.m_total_wait_us / stats.m_completed) : 0);
+}
@@ -0,0 +1,140 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "pmlin-send-now-demo.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include "pmlin-master.h"
+#include "demo-device.h"
+#include "pmlin-slave-emufun.h"
+
+// Measures the latency from writing a control buffer to the emulated slave acting on it, with the periodic
+// mirroring only and with PMLIN_mirror_send_now, then floods send now requests to show the rate limit.
+// The slaves time stamp the output changes in memory shared with this process.
+
+#define TICK_PERIOD_US 10000
+#define CONTROL_PERIOD 50 // control buffers are mirrored every 500 msec
+#define TOGGLES 10
+
+static volatile uint8_t g_control_1[DEMO_DEVICE_CONTROL_MSG_LENGTH];
+static volatile uint8_t g_control_3[DEMO_DEVICE_CONTROL_MSG_LENGTH];
+static volatile uint8_t g_status_2[DEMO_DEVICE_STATUS_MSG_LENGTH];
+
+static PMLIN_mirror_def_t g_mirror_defs[] = { //
+		PMLIN_MIRROR_DEF(1, DEMO_DEVICE_CONTROL_MSG_TYPE, g_control_1, CONTROL_PERIOD, 0), //
+		PMLIN_MIRROR_DEF(2, DEMO_DEVICE_STATUS_MSG_TYPE, g_status_2, 10, 3), //
+		PMLIN_MIRROR_DEF(3, DEMO_DEVICE_CONTROL_MSG_TYPE, g_control_3, CONTROL_PERIOD, 25), //
+		};
+
+static PMLIN_device_decl_t g_device_defs[] = { //
+		DEMO_DEVICE_DEVICE_DECL(1), //
+		DEMO_DEVICE_DEVICE_DECL(2), //
+		DEMO_DEVICE_DEVICE_DECL(3), //
+		};
+
+static volatile bool g_stop;
+
+static void* tick_thread_fun(void *arguments) {
+	struct timespec sleep = { 0, TICK_PERIOD_US * 1000L };
+	while (!g_stop) {
+		nanosleep(&sleep, NULL);
+		PMLIN_mirror_tick(NULL);
+	}
+	return NULL;
+}
+
+// toggles the output of device 1 a few times and prints the write to slave latencies
+static void measure(bool send_now) {
+	uint32_t min = UINT32_MAX, max = 0, sum = 0, n = 0;
+	for (uint32_t i = 0; i < TOGGLES; i++) {
+		struct timespec pause = { 0, (97 + 31 * i) * 1000000L }; // spread the writes over the mirroring period
+		nanosleep(&pause, NULL);
+		uint8_t output = g_control_1[0] ^ 1;
+		uint32_t t_write = demo_device_time_us();
+		g_control_1[0] = output;
+		if (send_now)
+			PMLIN_mirror_send_now(&g_mirror_defs[0]);
+		while (g_demo_device_simulated_state[0].m_output != output && demo_device_time_us() - t_write < 2000000) {
+			struct timespec poll = { 0, 100000L };
+			nanosleep(&poll, NULL);
+		}
+		if (g_demo_device_simulated_state[0].m_output != output)
+			continue;
+		uint32_t latency = g_demo_device_simulated_state[0].m_output_changed_us - t_write;
+		min = latency < min ? latency : min;
+		max = latency > max ? latency : max;
+		sum += latency;
+		n++;
+	}
+	printf("%-9s %2d/%d toggles, write to slave latency min %6d avg %6d max %6d usec\n", send_now ? "send now" : "periodic",
+			n, TOGGLES, n ? min : 0, n ? sum / n : 0, max);
+}
+
+void send_now_demo(bool emu) {
+	printf("send_now_demo\n");
+	if (!emu || !g_demo_device_simulated_state) {
+		printf("needs the emulated slaves, use -e\n");
+		return;
+	}
+	PMLIN_DEFINE_DEVICES(g_device_defs);
+	PMLIN_set_tick_period_us(TICK_PERIOD_US);
+	PMLIN_DEFINE_MIRRORING(g_mirror_defs);
+
+	pthread_t tick_thread;
+	if (pthread_create(&tick_thread, NULL, tick_thread_fun, NULL))
+		return;
+
+	measure(false);
+	measure(true);
+
+	// toggle as fast as possible for a second, the rate limit keeps the bus for the periodic mirroring
+	PMLIN_set_send_now_limits(5, 1);
+	PMLIN_utilization_t u;
+	PMLIN_get_utilization(&u, true);
+	uint32_t requests = 0;
+	uint32_t t0 = demo_device_time_us();
+	while (demo_device_time_us() - t0 < 1000000) {
+		g_control_3[0] ^= 1;
+		PMLIN_mirror_send_now(&g_mirror_defs[2]);
+		requests++;
+		struct timespec pause = { 0, 100000L };
+		nanosleep(&pause, NULL);
+	}
+	PMLIN_get_utilization(&u, false);
+	printf("flood: %d send now requests in 1 sec, %d frames on the bus, utilization %d.%d%%\n", requests, u.m_frames,
+			u.m_actual_permille / 10, u.m_actual_permille % 10);
+
+	g_stop = true;
+	pthread_join(tick_thread, NULL);
+}
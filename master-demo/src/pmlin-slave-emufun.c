@@ -38,6 +38,14 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "pmlin-slave-emufun.h"
 #include "pmlin-slave-emulator.h"
 
+volatile demo_device_simulated_state_t *g_demo_device_simulated_state;
+
+uint32_t demo_device_time_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t) (ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
 char* get_time() {
 	static char buffer[26];
 	struct tm *tm_info;
@@ -48,7 +56,17 @@ char* get_time() {
 	return buffer;
 }
 
-uint8_t demo_device_simu_function(uint8_t slave_action, uint8_t arg, volatile void *slave_data) {
+static void apply_control(volatile demo_device_simulated_state_t *simstate, volatile uint8_t *control) {
+	bool set_output = (control[0] & 1) != 0;
+
+	if (simstate->m_output != set_output) {
+		simstate->m_output_changed_us = demo_device_time_us();
+		simstate->m_output = set_output;
+		printf("%s DEVICE id %d OUTPUT = %d\n", get_time(), simstate->m_id, simstate->m_output);
+	}
+}
+
+int16_t demo_device_simu_function(uint8_t slave_action, uint8_t arg, volatile void *slave_data) {
 	volatile demo_device_simulated_state_t *simstate = slave_data;
 	if (slave_action == PMLIN_EMULATED_SLAVE_CALLBACK_ACTION_SET_ID) {
 		uint8_t id = arg;
@@ -57,13 +75,19 @@ uint8_t demo_device_simu_function(uint8_t slave_action, uint8_t arg, volatile vo
 	}
 	if (slave_action == PMLIN_EMULATED_SLAVE_CALLBACK_ACTION_INIT_TRANSFER) {
 		uint8_t msg_type = arg;
+		if (simstate->m_unplugged)
+			return PMLIN_INIT_IGNORE_MSG;
 		if (msg_type == DEMO_DEVICE_CONTROL_MSG_TYPE) {
 			simstate->m_data_idx = 0;
 			return PMLIN_INIT_RX_MSG;
 		}
-		if (msg_type == DEMO_DEVICE_STATUS_MSG_TYPE) {
+		if (msg_type == DEMO_DEVICE_STATUS_MSG_TYPE || msg_type == DEMO_DEVICE_EXCHANGE_MSG_TYPE) {
 			simstate->m_data_idx = 0;
-			return PMLIN_INIT_TX_MSG;
+			if (simstate->m_check_complement) { // a new consistent status for each read
+				simstate->m_control_data_out[0]++;
+				simstate->m_control_data_out[1] = ~simstate->m_control_data_out[0];
+			}
+			return msg_type == DEMO_DEVICE_STATUS_MSG_TYPE ? PMLIN_INIT_TX_MSG : PMLIN_INIT_EXCHANGE_MSG;
 		}
 		return PMLIN_INIT_IGNORE_MSG;
 	}
@@ -80,16 +104,29 @@ uint8_t demo_device_simu_function(uint8_t slave_action, uint8_t arg, volatile vo
 	}
 	if (slave_action == PMLIN_EMULATED_SLAVE_CALLBACK_ACTION_END_TRANSFER) {
 		uint8_t msg_type = arg;
-		if (msg_type == DEMO_DEVICE_CONTROL_MSG_TYPE) {
-			bool set_output = (simstate->m_control_data_in[0] & 1) != 0;
-
-			if (simstate->m_output != set_output) {
-				simstate->m_output = set_output;
-				printf("%s DEVICE id %d OUTPUT = %d\n", get_time(), simstate->m_id, simstate->m_output);
+		if (msg_type == DEMO_DEVICE_CONTROL_MSG_TYPE || msg_type == DEMO_DEVICE_EXCHANGE_MSG_TYPE) {
+			simstate->m_data_idx = 0; // the status of an exchange is transmitted next
+			if (simstate->m_check_complement) {
+				simstate->m_control_count++;
+				if (simstate->m_control_data_in[1] != (uint8_t) ~simstate->m_control_data_in[0])
+					simstate->m_torn_count++;
 			}
-
+			if (simstate->m_latch) { // hold it until the trigger
+				for (uint8_t i = 0; i < DEMO_DEVICE_CONTROL_MSG_LENGTH; i++)
+					simstate->m_latched_data[i] = simstate->m_control_data_in[i];
+				simstate->m_latched = true;
+				return 0;
+			}
+			apply_control(simstate, simstate->m_control_data_in);
 			return 0;
 		}
 	}
+	if (slave_action == PMLIN_EMULATED_SLAVE_CALLBACK_ACTION_TRIGGER) {
+		if (simstate->m_latched) {
+			simstate->m_latched = false;
+			apply_control(simstate, simstate->m_latched_data);
+		}
+		return 0;
+	}
 	return 0;
 }
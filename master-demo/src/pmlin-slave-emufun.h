@@ -42,8 +42,22 @@ typedef struct {
 	uint16_t m_data_idx;
 	uint8_t m_control_data_in[DEMO_DEVICE_CONTROL_MSG_LENGTH];
 	uint8_t m_control_data_out[DEMO_DEVICE_STATUS_MSG_LENGTH];
+	uint32_t m_output_changed_us; // CLOCK_MONOTONIC time stamp of the latest output change
+	bool m_unplugged; // set by a demo to make the slave ignore all messages
+	bool m_check_complement; // set by a demo, the second byte of the messages must be the complement of the first
+	uint32_t m_control_count; // control messages received while m_check_complement
+	uint32_t m_torn_count; // control messages received whose second byte was not the complement of the first
+	bool m_latch; // set by a demo, control messages are latched and only applied by a trigger
+	bool m_latched; // a latched control message is waiting for a trigger
+	uint8_t m_latched_data[DEMO_DEVICE_CONTROL_MSG_LENGTH];
 } demo_device_simulated_state_t;
 
-uint8_t demo_device_simu_function(uint8_t slave_action, uint8_t message_type, volatile void* slave_data);
+// the simulated state of the emulated slaves, shared with the master process so demos can observe the slaves
+extern volatile demo_device_simulated_state_t *g_demo_device_simulated_state;
+
+int16_t demo_device_simu_function(uint8_t slave_action, uint8_t message_type, volatile void* slave_data);
+
+// CLOCK_MONOTONIC time in micro seconds, comparable between the master and the emulated slave processes
+uint32_t demo_device_time_us();
 
 #endif
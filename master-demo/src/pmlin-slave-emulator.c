@@ -63,6 +63,9 @@ uint8_t g_slave_no;
 
 bool g_send_break;
 
+// set when the master has received the BREAK of the current frame, see pmlin_master_read_gap
+bool g_master_synced = true;
+
 typedef struct {
 	volatile int m_read;
 	volatile int m_write;
@@ -175,9 +178,8 @@ static void* partyline_thread(void *arguments) {
 
 void pmlin_master_send_break() {
 	g_send_break = 1;
-	// get rid of any left over garbage
-	while (poll_pipe(&g_to_master_pipe) || g_to_master_pipe.m_data_len > 0)
-		;
+	// no need to get rid of left over garbage, pmlin_master_read_gap drops everything until the BREAK
+	g_master_synced = false;
 }
 
 void pmlin_master_write(uint8_t *buffer, uint16_t len) {
@@ -188,26 +190,47 @@ void pmlin_master_write(uint8_t *buffer, uint16_t len) {
 }
 
 uint16_t pmlin_master_read(uint8_t *buffer, uint16_t bytes_to_read, uint32_t timeout_us) {
+	return pmlin_master_read_gap(buffer, bytes_to_read, timeout_us, timeout_us);
+}
+
+uint16_t pmlin_master_read_gap(uint8_t *buffer, uint16_t bytes_to_read, uint32_t timeout_us, uint32_t gap_us) {
 	uint64_t t0 = get_time_stamp_usec();
+	uint64_t t_rx = t0;
 	uint16_t n = 0;
 	struct timespec sleep = { 0, 1000000000 / (PMLIN_BAUDRATE / 10) };
 	do {
 		if (poll_pipe(&g_to_master_pipe)) {
-			buffer[n++] = g_to_master_pipe.m_data[0]; // ignore m_data[1] ie serial line break info
-			if (n >= bytes_to_read)
-				break;
+			if (g_to_master_pipe.m_data[1]) { // BREAK, a frame starts here so anything before it is stale
+				g_master_synced = true;
+				n = 0;
+			}
+			if (g_master_synced) {
+				buffer[n++] = g_to_master_pipe.m_data[0];
+				t_rx = get_time_stamp_usec();
+				if (n >= bytes_to_read)
+					break;
+			}
+			continue; // take everything that has arrived before sleeping
 		}
 		nanosleep(&sleep, NULL);
-	} while (get_time_stamp_usec() - t0 < timeout_us);
+	} while (get_time_stamp_usec() - t0 < timeout_us && (n == 0 || get_time_stamp_usec() - t_rx < gap_us));
 	return n;
 }
 
+uint32_t pmlin_master_time_us() {
+	return (uint32_t) get_time_stamp_usec();
+}
+
 // -----------------------------------------------------------------------------------------
 
 void PMLIN_end_transfer(uint8_t msg_type) {
 	CALL_SLAVE_FUN(PMLIN_EMULATED_SLAVE_CALLBACK_ACTION_END_TRANSFER,msg_type);
 }
 
+void PMLIN_trigger() {
+	CALL_SLAVE_FUN(PMLIN_EMULATED_SLAVE_CALLBACK_ACTION_TRIGGER,0);
+}
+
 #define PMLIN_DIR_SLAVE_TO_MASTER 0
 #define PMLIN_DIR_MASTER_TO_SLAVE 1
 
@@ -327,6 +350,8 @@ void pmlin_start_emulated_master() {
 			(void*)pthread_mutex_lock, // cast to void to bypass warnings
 			(void*)&pthread_mutex_unlock // cast to void to bypass warnings
 			);
+	PMLIN_initialize_nonblocking(g_to_master_pipe.m_read, pmlin_master_time_us);
+	PMLIN_set_read_gap_callback(pmlin_master_read_gap);
 
 	// create the thread that simulates 'party line' or open collector bus by distributing eveything to everyone
 	pthread_t thread;
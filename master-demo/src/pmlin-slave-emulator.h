@@ -44,8 +44,9 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define PMLIN_EMULATED_SLAVE_CALLBACK_ACTION_FETCH_DATA 2
 #define PMLIN_EMULATED_SLAVE_CALLBACK_ACTION_STORE_DATA 3
 #define PMLIN_EMULATED_SLAVE_CALLBACK_ACTION_END_TRANSFER 4
+#define PMLIN_EMULATED_SLAVE_CALLBACK_ACTION_TRIGGER 5
 
-typedef uint8_t (*pmlin_emulated_slave_fp)(uint8_t, uint8_t, volatile void*);
+typedef int16_t (*pmlin_emulated_slave_fp)(uint8_t, uint8_t, volatile void*);
 
 typedef struct pmlin_emulated_slave_descriptor_t {
 	pmlin_emulated_slave_fp m_slave_fun;
@@ -71,6 +72,10 @@ void pmlin_master_write(uint8_t *buffer, uint16_t len);
 
 uint16_t pmlin_master_read(uint8_t *buffer, uint16_t bytes_to_read, uint32_t timeout_us);
 
+uint16_t pmlin_master_read_gap(uint8_t *buffer, uint16_t bytes_to_read, uint32_t timeout_us, uint32_t gap_us);
+
+uint32_t pmlin_master_time_us();
+
 #define report_and_exit(msg) do { fprintf(stderr,"file %s line %d\n",__FILE__,__LINE__); perror(msg); exit(0); } while (0)
 
 #endif /* PMLIN_UNITTEST_H_ */
@@ -0,0 +1,182 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "pmlin-swap-demo.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "pmlin-master.h"
+#include "pmlin-posix-hal.h"
+#include "demo-device.h"
+#include "pmlin-slave-emufun.h"
+
+// Switches between a service mode and a production configuration while the tick thread keeps running.
+// The service mode reads the status of slave 2 only, the production mode the status of slaves 2 and 3 and
+// writes the control of slave 1. The slaves change their status on every read so the change notification
+// reports every status received, which tells which configuration each tick used.
+
+#define TICK_PERIOD_US 10000
+#define SWAPS 20
+#define SWAP_INTERVAL_US 150000
+
+static volatile uint8_t g_service_status_2[DEMO_DEVICE_STATUS_MSG_LENGTH];
+static volatile uint8_t g_status_2[DEMO_DEVICE_STATUS_MSG_LENGTH];
+static volatile uint8_t g_status_3[DEMO_DEVICE_STATUS_MSG_LENGTH];
+static volatile uint8_t g_control_1[DEMO_DEVICE_CONTROL_MSG_LENGTH];
+
+static PMLIN_mirror_def_t g_service_defs[] = { //
+		PMLIN_MIRROR_DEF(2, DEMO_DEVICE_STATUS_MSG_TYPE, g_service_status_2, 1, 0), //
+		};
+
+static PMLIN_mirror_def_t g_production_defs[] = { //
+		PMLIN_MIRROR_DEF(2, DEMO_DEVICE_STATUS_MSG_TYPE, g_status_2, 2, 0), //
+		PMLIN_MIRROR_DEF(3, DEMO_DEVICE_STATUS_MSG_TYPE, g_status_3, 2, 1), //
+		PMLIN_MIRROR_DEF(1, DEMO_DEVICE_CONTROL_MSG_TYPE, g_control_1, 5, 0), //
+		};
+
+static PMLIN_device_decl_t g_service_devices[] = { //
+		DEMO_DEVICE_DEVICE_DECL(2), //
+		};
+
+static PMLIN_device_decl_t g_production_devices[] = { //
+		DEMO_DEVICE_DEVICE_DECL(1), //
+		DEMO_DEVICE_DEVICE_DECL(2), //
+		DEMO_DEVICE_DEVICE_DECL(3), //
+		};
+
+static PMLIN_tables_t g_service_tables;
+static PMLIN_tables_t g_production_tables;
+
+static atomic_bool g_stop;
+static atomic_uint g_tick_max_us;
+static uint32_t g_tick_service; // ticks that received only from the service tables
+static uint32_t g_tick_production; // ticks that received only from the production tables
+static uint32_t g_tick_mixed; // ticks that received from both, there must be none
+static bool g_seen_service;
+static bool g_seen_production;
+static _Atomic(PMLIN_tables_t*) g_seen_tables; // tables of the latest tick that received something
+
+static void* tick_thread_fun(void *arguments) {
+	struct timespec sleep = { 0, TICK_PERIOD_US * 1000L };
+	while (!atomic_load(&g_stop)) {
+		nanosleep(&sleep, NULL);
+		uint32_t t0 = PMLIN_posix_time_us();
+		PMLIN_mirror_tick(NULL);
+		uint32_t us = PMLIN_posix_time_us() - t0;
+		if (us > atomic_load(&g_tick_max_us))
+			atomic_store(&g_tick_max_us, us);
+	}
+	return NULL;
+}
+
+static bool in(PMLIN_mirror_def_t *mirror, PMLIN_mirror_def_t defs[], uint32_t n) {
+	return mirror >= &defs[0] && mirror < &defs[n];
+}
+
+// called by the tick thread for each status received and then with NULL at the end of the tick
+static void changed(PMLIN_mirror_def_t *mirror, void *user) {
+	if (mirror) {
+		g_seen_service |= in(mirror, g_service_defs, sizeof(g_service_defs) / sizeof(g_service_defs[0]));
+		g_seen_production |= in(mirror, g_production_defs, sizeof(g_production_defs) / sizeof(g_production_defs[0]));
+		return;
+	}
+	if (g_seen_service && g_seen_production)
+		g_tick_mixed++;
+	else if (g_seen_service)
+		g_tick_service++;
+	else
+		g_tick_production++;
+	atomic_store(&g_seen_tables, g_seen_service ? &g_service_tables : &g_production_tables);
+	g_seen_service = false;
+	g_seen_production = false;
+}
+
+static const char* name(PMLIN_tables_t *tables) {
+	return tables == &g_service_tables ? "service" : "production";
+}
+
+void swap_demo(bool emu) {
+	printf("swap_demo\n");
+	if (!emu || !g_demo_device_simulated_state) {
+		printf("needs the emulated slaves, use -e\n");
+		return;
+	}
+	g_demo_device_simulated_state[1].m_check_complement = true;
+	g_demo_device_simulated_state[2].m_check_complement = true;
+	PMLIN_set_tick_period_us(TICK_PERIOD_US);
+	PMLIN_set_mirror_changed_callback(changed, NULL);
+	PMLIN_prepare_tables(&g_production_tables, g_production_devices, 3, g_production_defs, 3);
+	PMLIN_swap_tables(&g_production_tables);
+
+	pthread_t tick_thread;
+	if (pthread_create(&tick_thread, NULL, tick_thread_fun, NULL))
+		return;
+	uint32_t first_max = 0, first_sum = 0, retire_max = 0, retire_sum = 0;
+	for (uint32_t i = 0; i < SWAPS; i++) {
+		struct timespec pause = { 0, SWAP_INTERVAL_US * 1000L };
+		nanosleep(&pause, NULL);
+		PMLIN_tables_t *tables = i % 2 ? &g_production_tables : &g_service_tables;
+		PMLIN_error_t res = i % 2 ? PMLIN_prepare_tables(tables, g_production_devices, 3, g_production_defs, 3) :
+				PMLIN_prepare_tables(tables, g_service_devices, 1, g_service_defs, 1);
+		if (res != PMLIN_OK) {
+			printf("preparing the %s tables failed: %s\n", name(tables), PMLIN_result_to_string(res));
+			break;
+		}
+		uint32_t t0 = PMLIN_posix_time_us();
+		PMLIN_tables_t *old = PMLIN_swap_tables(tables);
+		// the old tables may be prepared again once the tick that may still be using them is over
+		while (PMLIN_tables_in_use(old))
+			sched_yield();
+		uint32_t retired = PMLIN_posix_time_us() - t0;
+		while (atomic_load(&g_seen_tables) != tables)
+			sched_yield();
+		uint32_t first = PMLIN_posix_time_us() - t0;
+		retire_max = retired > retire_max ? retired : retire_max;
+		retire_sum += retired;
+		first_max = first > first_max ? first : first_max;
+		first_sum += first;
+	}
+	atomic_store(&g_stop, true);
+	pthread_join(tick_thread, NULL);
+	printf("%d swaps, old tables retired avg %d max %d usec, new tables received avg %d max %d usec after the swap\n",
+			SWAPS, retire_sum / SWAPS, retire_max, first_sum / SWAPS, first_max);
+	printf("ticks with service tables %d, production tables %d, mixed %d, longest tick %d usec\n", g_tick_service,
+			g_tick_production, g_tick_mixed, atomic_load(&g_tick_max_us));
+	PMLIN_set_mirror_changed_callback(NULL, NULL);
+	g_demo_device_simulated_state[1].m_check_complement = false;
+	g_demo_device_simulated_state[2].m_check_complement = false;
+}
@@ -0,0 +1,170 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "pmlin-tear-free-demo.h"
+
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "pmlin-master.h"
+#include "pmlin-mirror-buffer.h"
+#include "demo-device.h"
+#include "pmlin-slave-emufun.h"
+
+// Stress test for the tear free mirroring buffers. Two threads keep writing the control message of device 1
+// and two threads keep reading the status message of device 2 while the mirroring transfers both on every
+// tick. The second byte of every message written or sent by the slave is the complement of the first, so a
+// torn message is easy to spot, the slave counts the torn control messages it receives. This is run first
+// with plain buffers and then with PMLIN_mirror_buffer_t buffers.
+
+#define RUN_SECONDS 3
+#define WRITERS 2
+#define READERS 2
+
+static volatile uint8_t g_plain_control[DEMO_DEVICE_CONTROL_MSG_LENGTH];
+static volatile uint8_t g_plain_status[DEMO_DEVICE_STATUS_MSG_LENGTH];
+static uint8_t g_control_data[DEMO_DEVICE_CONTROL_MSG_LENGTH];
+static uint8_t g_status_data[DEMO_DEVICE_STATUS_MSG_LENGTH];
+static PMLIN_mirror_buffer_t g_control;
+static PMLIN_mirror_buffer_t g_status;
+
+static PMLIN_mirror_def_t g_plain_defs[] = { //
+		PMLIN_MIRROR_DEF(1, DEMO_DEVICE_CONTROL_MSG_TYPE, g_plain_control, 1, 0), //
+		PMLIN_MIRROR_DEF(2, DEMO_DEVICE_STATUS_MSG_TYPE, g_plain_status, 1, 0), //
+		};
+
+static PMLIN_mirror_def_t g_snapshot_defs[] = { //
+		PMLIN_MIRROR_BUFFER_DEF(1, DEMO_DEVICE_CONTROL_MSG_TYPE, &g_control, 1, 0), //
+		PMLIN_MIRROR_BUFFER_DEF(2, DEMO_DEVICE_STATUS_MSG_TYPE, &g_status, 1, 0), //
+		};
+
+static PMLIN_device_decl_t g_device_defs[] = { //
+		DEMO_DEVICE_DEVICE_DECL(1), //
+		DEMO_DEVICE_DEVICE_DECL(2), //
+		};
+
+static atomic_bool g_stop;
+static bool g_use_snapshots;
+static atomic_uint g_reads;
+static atomic_uint g_torn_reads;
+
+static void* tick_thread_fun(void *arguments) {
+	while (!atomic_load(&g_stop))
+		PMLIN_mirror_tick(NULL);
+	return NULL;
+}
+
+static void* writer_thread_fun(void *arguments) {
+	uint8_t v = (uintptr_t) arguments;
+	while (!atomic_load(&g_stop)) {
+		v += 2; // keep the output bit zero so the slave does not print every change
+		uint8_t data[DEMO_DEVICE_CONTROL_MSG_LENGTH] = { v, ~v };
+		if (g_use_snapshots)
+			PMLIN_mirror_buffer_write(&g_control, data, sizeof(data));
+		else {
+			g_plain_control[0] = data[0];
+			g_plain_control[1] = data[1];
+		}
+	}
+	return NULL;
+}
+
+static void* reader_thread_fun(void *arguments) {
+	while (!atomic_load(&g_stop)) {
+		uint8_t data[DEMO_DEVICE_STATUS_MSG_LENGTH];
+		if (g_use_snapshots)
+			PMLIN_mirror_buffer_read(&g_status, data, sizeof(data));
+		else {
+			data[0] = g_plain_status[0];
+			data[1] = g_plain_status[1];
+		}
+		atomic_fetch_add(&g_reads, 1);
+		if (data[1] != (uint8_t) ~data[0])
+			atomic_fetch_add(&g_torn_reads, 1);
+	}
+	return NULL;
+}
+
+static void run(bool use_snapshots) {
+	volatile demo_device_simulated_state_t *slave = &g_demo_device_simulated_state[0];
+	g_use_snapshots = use_snapshots;
+	PMLIN_error_t res = use_snapshots ? PMLIN_DEFINE_MIRRORING(g_snapshot_defs) : PMLIN_DEFINE_MIRRORING(g_plain_defs);
+	if (res != PMLIN_OK) {
+		printf("PMLIN_define_mirroring: error %s\n", PMLIN_result_to_string(res));
+		return;
+	}
+	// consistent initial contents
+	uint8_t initial[DEMO_DEVICE_CONTROL_MSG_LENGTH] = { 0, 0xFF };
+	PMLIN_mirror_buffer_write(&g_control, initial, sizeof(initial));
+	PMLIN_mirror_buffer_write(&g_status, initial, sizeof(initial));
+	g_plain_control[0] = g_plain_status[0] = 0;
+	g_plain_control[1] = g_plain_status[1] = 0xFF;
+	slave->m_control_count = 0;
+	slave->m_torn_count = 0;
+	atomic_store(&g_reads, 0);
+	atomic_store(&g_torn_reads, 0);
+	atomic_store(&g_stop, false);
+
+	pthread_t threads[1 + WRITERS + READERS];
+	pthread_create(&threads[0], NULL, tick_thread_fun, NULL);
+	for (uintptr_t i = 0; i < WRITERS; i++)
+		pthread_create(&threads[1 + i], NULL, writer_thread_fun, (void*) (i * 64));
+	for (uint32_t i = 0; i < READERS; i++)
+		pthread_create(&threads[1 + WRITERS + i], NULL, reader_thread_fun, NULL);
+	struct timespec run = { RUN_SECONDS, 0 };
+	nanosleep(&run, NULL);
+	atomic_store(&g_stop, true);
+	for (uint32_t i = 0; i < 1 + WRITERS + READERS; i++)
+		pthread_join(threads[i], NULL);
+
+	printf("%-9s control sent %5d torn %5d, status reads %9d torn %7d\n", use_snapshots ? "snapshot" : "plain",
+			slave->m_control_count, slave->m_torn_count, atomic_load(&g_reads), atomic_load(&g_torn_reads));
+}
+
+void tear_free_demo(bool emu) {
+	printf("tear_free_demo\n");
+	if (!emu || !g_demo_device_simulated_state) {
+		printf("needs the emulated slaves, use -e\n");
+		return;
+	}
+	g_control = PMLIN_MIRROR_BUFFER(g_control_data);
+	g_status = PMLIN_MIRROR_BUFFER(g_status_data);
+	PMLIN_DEFINE_DEVICES(g_device_defs);
+	PMLIN_set_tick_period_us(100000); // the ticks run back to back, this just keeps the admission control happy
+	g_demo_device_simulated_state[0].m_check_complement = true;
+	g_demo_device_simulated_state[1].m_check_complement = true;
+	run(false);
+	run(true);
+	g_demo_device_simulated_state[0].m_check_complement = false;
+	g_demo_device_simulated_state[1].m_check_complement = false;
+}
@@ -0,0 +1,130 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "pmlin-trigger-demo.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include "pmlin-master.h"
+#include "pmlin-posix-hal.h"
+#include "demo-device.h"
+#include "pmlin-slave-emufun.h"
+
+// Toggles the output of the three emulated slaves together, first by sending each its control in turn and
+// then by latching the controls in the slaves and applying them with one broadcast trigger. The skew is the
+// time between the first and the last slave changing its output.
+
+#define ROUNDS 20
+#define TRIGGER_MASK ((1 << 1) | (1 << 2) | (1 << 3))
+#define WAIT_US 100000
+
+typedef struct {
+	uint32_t m_min;
+	uint32_t m_max;
+	uint32_t m_sum;
+	uint32_t m_count;
+	uint32_t m_failed;
+} skew_t;
+
+// waits until all the slaves have the output, returns false if some did not get there
+static bool wait_outputs(bool output) {
+	uint32_t t0 = PMLIN_posix_time_us();
+	for (uint8_t i = 0; i < 3; i++)
+		while (g_demo_device_simulated_state[i].m_output != output)
+			if (PMLIN_posix_time_us() - t0 > WAIT_US)
+				return false;
+	return true;
+}
+
+static void measure(skew_t *skew, bool output) {
+	if (!wait_outputs(output)) {
+		skew->m_failed++;
+		return;
+	}
+	uint32_t first = g_demo_device_simulated_state[0].m_output_changed_us;
+	uint32_t last = first;
+	for (uint8_t i = 1; i < 3; i++) {
+		uint32_t t = g_demo_device_simulated_state[i].m_output_changed_us;
+		first = (int32_t) (t - first) < 0 ? t : first;
+		last = (int32_t) (t - last) > 0 ? t : last;
+	}
+	uint32_t us = last - first;
+	skew->m_min = skew->m_count && skew->m_min < us ? skew->m_min : us;
+	skew->m_max = us > skew->m_max ? us : skew->m_max;
+	skew->m_sum += us;
+	skew->m_count++;
+}
+
+static void report(const char *how, skew_t *skew) {
+	printf("%-10s skew min %6d avg %6d max %6d usec, %d rounds failed\n", how, skew->m_min,
+			skew->m_count ? skew->m_sum / skew->m_count : 0, skew->m_max, skew->m_failed);
+}
+
+void trigger_demo(bool emu) {
+	printf("trigger_demo\n");
+	if (!emu || !g_demo_device_simulated_state) {
+		printf("needs the emulated slaves, use -e\n");
+		return;
+	}
+	uint8_t control[DEMO_DEVICE_CONTROL_MSG_LENGTH] = { 0 };
+	bool output = g_demo_device_simulated_state[0].m_output;
+
+	skew_t sequential = { 0 };
+	for (uint32_t round = 0; round < ROUNDS; round++) {
+		output = !output;
+		control[0] = output;
+		for (uint8_t id = 1; id <= 3; id++)
+			PMLIN_send_message(id, DEMO_DEVICE_CONTROL_MSG_TYPE, DEMO_DEVICE_CONTROL_MSG_LENGTH, control);
+		measure(&sequential, output);
+	}
+	report("sequential", &sequential);
+
+	for (uint8_t i = 0; i < 3; i++)
+		g_demo_device_simulated_state[i].m_latch = true;
+	skew_t triggered = { 0 };
+	uint32_t early = 0;
+	for (uint32_t round = 0; round < ROUNDS; round++) {
+		output = !output;
+		control[0] = output;
+		for (uint8_t id = 1; id <= 3; id++)
+			PMLIN_send_message(id, DEMO_DEVICE_CONTROL_MSG_TYPE, DEMO_DEVICE_CONTROL_MSG_LENGTH, control);
+		for (uint8_t i = 0; i < 3; i++)
+			if (g_demo_device_simulated_state[i].m_output == output) // latched controls must wait for the trigger
+				early++;
+		PMLIN_send_trigger(TRIGGER_MASK);
+		measure(&triggered, output);
+	}
+	report("triggered", &triggered);
+	printf("%d outputs changed before the trigger\n", early);
+	for (uint8_t i = 0; i < 3; i++)
+		g_demo_device_simulated_state[i].m_latch = false;
+}
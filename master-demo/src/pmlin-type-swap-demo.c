@@ -0,0 +1,81 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "pmlin-type-swap-demo.h"
+
+#include <stdio.h>
+#include "pmlin.h"
+#include "pmlin-master.h"
+#include "demo-device.h"
+#include "pmlin-slave-emufun.h"
+
+// The devices with id 2 and 3 are declared the other way round to how they are on the bus, so
+// PMLIN_auto_config has to swap their ids. It does that through a free id, which must not be the
+// broadcast id as the slaves cannot be addressed there.
+
+void type_swap_demo(bool emu) {
+	printf("type_swap_demo\n");
+
+	if (!emu) {
+		printf("This demo WILL re-assign device ids!\n");
+		printf("It expects a device of type %d with id 3 and demo devices with ids 1 and 2.\n", TYPE_SWAP_DEMO_OTHER_DEVICE_TYPE);
+		printf("\n");
+		printf("Hit enter if you want to continue else press CTRL-C\n");
+		getchar();
+	}
+	PMLIN_device_decl_t devices[] = { //
+			DEMO_DEVICE_DEVICE_DECL(1), // id 1
+			PMLIN_DECLARE_DEVICE(2, TYPE_SWAP_DEMO_OTHER_DEVICE_TYPE, DEMO_DEVICE_CONTROL_MSG, DEMO_DEVICE_STATUS_MSG, DEMO_DEVICE_EXCHANGE_MSG,), // id 2
+			DEMO_DEVICE_DEVICE_DECL(3), // id 3
+			};
+
+	uint8_t no_of_devices = sizeof(devices) / sizeof(devices[0]);
+	PMLIN_define_devices(devices, no_of_devices);
+
+	uint8_t failed_id = 0;
+	PMLIN_error_t res = PMLIN_check_config(&failed_id);
+	printf("PMLIN_check_config: %s id %d\n", PMLIN_result_to_string(res), failed_id);
+
+	PMLIN_error_t renum[PMLIN_MAX_NUM_ID];
+	res = PMLIN_auto_config(renum);
+	printf("PMLIN_autoconfig: %s\n", PMLIN_result_to_string(res));
+
+	// do it again to see if it worked
+	res = PMLIN_auto_config(renum);
+	if (res == PMLIN_OK && PMLIN_check_config(&failed_id) == PMLIN_OK)
+		printf("PMLIN_autoconfig succeeded and swapped the ids!\n");
+	else
+		printf("PMLIN_autoconfig: %s\n", PMLIN_result_to_string(res));
+	if (emu)
+		for (uint8_t i = 0; i < 3; i++)
+			printf(" emulated slave %d has id %d\n", i, g_demo_device_simulated_state[i].m_id);
+}
@@ -0,0 +1,150 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifdef __linux__
+#define _GNU_SOURCE // for RUSAGE_THREAD
+#endif
+
+#include "pmlin-uring-demo.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "pmlin.h"
+#include "pmlin-master.h"
+#include "pmlin-posix-hal.h"
+#include "pmlin-pty-slave.h"
+#include "pmlin-slave-emulator.h"
+#include "demo-device.h"
+
+#ifdef __linux__
+
+#include "pmlin-uring-hal.h"
+
+#define FRAMES_PER_RUN 1000
+
+// Runs the same traffic through the POSIX (poll based) HAL and the io_uring HAL and compares the system calls
+// and CPU time spent per frame. As in the multibus demo the serial port is a pseudo terminal with a minimal slave
+// at the far end so no hardware is needed. A frame here is one send_message or receive_message transaction.
+//
+// System calls are counted by the HALs themselves. CPU time is given for the calling thread and for the whole
+// process, the latter includes the pseudo terminal slave thread and, for io_uring, the kernel io-wq workers
+// that execute the blocking serial port reads.
+
+static uint64_t cpu_us(int who) {
+	struct rusage ru;
+	getrusage(who, &ru);
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000ULL + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+static void run_frames(const char *name, PMLIN_master_t *m, uint8_t id, uint32_t *syscall_count) {
+	uint8_t control[DEMO_DEVICE_CONTROL_MSG_LENGTH] = { 0 };
+	uint8_t status[DEMO_DEVICE_STATUS_MSG_LENGTH] = { 0 };
+	uint32_t errors = 0;
+
+	uint32_t sc0 = *syscall_count;
+	uint64_t thread0 = cpu_us(RUSAGE_THREAD);
+	uint64_t process0 = cpu_us(RUSAGE_SELF);
+	uint32_t t0 = PMLIN_posix_time_us();
+	for (uint16_t i = 0; i < FRAMES_PER_RUN / 2; i++) {
+		control[0] = i;
+		if (PMLIN_OK != PMLIN_master_send_message(m, id, DEMO_DEVICE_CONTROL_MSG_TYPE, sizeof(control), control))
+			errors++;
+		if (PMLIN_OK != PMLIN_master_receive_message(m, id, DEMO_DEVICE_STATUS_MSG_TYPE, sizeof(status), status))
+			errors++;
+	}
+	uint32_t elapsed = PMLIN_posix_time_us() - t0;
+	double thread = (cpu_us(RUSAGE_THREAD) - thread0) / (double) FRAMES_PER_RUN;
+	double process = (cpu_us(RUSAGE_SELF) - process0) / (double) FRAMES_PER_RUN;
+	double syscalls = (*syscall_count - sc0) / (double) FRAMES_PER_RUN;
+
+	printf("%-8s %6d %6d %9.1f %12.1f %12.1f %10.1f\n", name, FRAMES_PER_RUN, errors, syscalls, thread, process, elapsed / (double) FRAMES_PER_RUN);
+}
+
+static void init_master(PMLIN_master_t *m, PMLIN_hal_t hal, pthread_mutex_t *mutex, int fd, PMLIN_device_decl_t *devices, uint8_t num_devices) {
+	PMLIN_master_initialize(m, hal, mutex, //
+			(void*) pthread_mutex_lock, // cast to void to bypass warnings
+			(void*) pthread_mutex_unlock // cast to void to bypass warnings
+			);
+	PMLIN_master_initialize_nonblocking(m, fd, PMLIN_posix_time_us);
+	PMLIN_master_define_devices(m, devices, num_devices);
+	if (PMLIN_master_check_config(m, NULL) != PMLIN_OK)
+		printf("check_config failed\n");
+}
+
+void uring_demo(bool emu) {
+	printf("uring_demo\n");
+	static PMLIN_master_t master;
+	static PMLIN_posix_port_t posix_port;
+	static PMLIN_uring_port_t uring_port;
+	static pmlin_pty_slave_t slave;
+	static PMLIN_device_decl_t devices[] = { DEMO_DEVICE_DEVICE_DECL(1) };
+	pthread_mutex_t mutex;
+
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	if (pthread_mutex_init(&mutex, &attr))
+		report_and_exit("pthread_mutex_init");
+
+	const char *name = pmlin_pty_slave_start(&slave, &devices[0]);
+	printf("%-8s %6s %6s %9s %12s %12s %10s\n", "HAL", "frames", "errors", "syscalls", "thread us", "process us", "wall us");
+
+	if (PMLIN_posix_port_open(&posix_port, name) < 0)
+		report_and_exit(name);
+	init_master(&master, PMLIN_POSIX_HAL(&posix_port), &mutex, posix_port.m_fd, devices, sizeof(devices) / sizeof(devices[0]));
+	run_frames("posix", &master, devices[0].m_id, &posix_port.m_syscall_count);
+	close(posix_port.m_fd);
+
+	if (PMLIN_uring_port_open(&uring_port, name) < 0) {
+		printf("io_uring not available: %s\n", strerror(errno));
+	} else {
+		init_master(&master, PMLIN_URING_HAL(&uring_port), &mutex, uring_port.m_serial.m_fd, devices, sizeof(devices) / sizeof(devices[0]));
+		run_frames("io_uring", &master, devices[0].m_id, &uring_port.m_syscall_count);
+		PMLIN_uring_port_close(&uring_port);
+	}
+
+	pmlin_pty_slave_stop(&slave);
+	pthread_mutex_destroy(&mutex);
+}
+
+#else
+
+void uring_demo(bool emu) {
+	printf("uring_demo: io_uring is only available on Linux\n");
+}
+
+#endif
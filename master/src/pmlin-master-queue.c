@@ -0,0 +1,277 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "pmlin-master-queue.h"
+
+#include <time.h>
+
+// The request queue is a bounded multi producer / single consumer ring buffer where each slot
+// carries a sequence number that tells the producers and the consumer whose turn it is to use the slot.
+// Producers claim a slot by advancing the head with compare-and-swap, the bus thread is the only consumer.
+
+#define PMLIN_QUEUE_MASK (PMLIN_QUEUE_SIZE - 1)
+
+static PMLIN_queue_t g_PMLIN_default_queue;
+
+// the waiters of all the buses share these, they are only used when someone is waiting
+static pthread_mutex_t g_PMLIN_done_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_PMLIN_done_cond = PTHREAD_COND_INITIALIZER;
+static atomic_uint g_PMLIN_waiters;
+
+static uint32_t PMLIN_queue_time_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t) (ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+static bool PMLIN_enqueue(PMLIN_queue_t *q, PMLIN_request_t *request) {
+	size_t pos = atomic_load_explicit(&q->m_head, memory_order_relaxed);
+	PMLIN_queue_slot_t *slot;
+	while (1) {
+		slot = &q->m_slots[pos & PMLIN_QUEUE_MASK];
+		size_t seq = atomic_load_explicit(&slot->m_seq, memory_order_acquire);
+		intptr_t dif = (intptr_t) seq - (intptr_t) pos;
+		if (dif == 0) {
+			if (atomic_compare_exchange_weak_explicit(&q->m_head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+				break;
+		} else if (dif < 0)
+			return false; // full
+		else
+			pos = atomic_load_explicit(&q->m_head, memory_order_relaxed);
+	}
+	slot->m_request = request;
+	atomic_store_explicit(&slot->m_seq, pos + 1, memory_order_release);
+	return true;
+}
+
+static PMLIN_request_t* PMLIN_dequeue(PMLIN_queue_t *q) {
+	PMLIN_queue_slot_t *slot = &q->m_slots[q->m_tail & PMLIN_QUEUE_MASK];
+	size_t seq = atomic_load_explicit(&slot->m_seq, memory_order_acquire);
+	if ((intptr_t) seq - (intptr_t) (q->m_tail + 1) < 0)
+		return NULL; // empty
+	PMLIN_request_t *request = slot->m_request;
+	atomic_store_explicit(&slot->m_seq, q->m_tail + PMLIN_QUEUE_SIZE, memory_order_release);
+	q->m_tail++;
+	return request;
+}
+
+static void PMLIN_complete_request(PMLIN_queue_t *q, PMLIN_request_t *request) {
+	if (request->m_completion)
+		request->m_completion(request);
+	pthread_mutex_lock(&q->m_stats_mutex);
+	q->m_stats.m_completed++;
+	pthread_mutex_unlock(&q->m_stats_mutex);
+
+	// after this the request may be deallocated by the submitter so do not touch it
+	atomic_store(&request->m_done, true);
+	if (atomic_load(&g_PMLIN_waiters)) {
+		pthread_mutex_lock(&g_PMLIN_done_mutex);
+		pthread_cond_broadcast(&g_PMLIN_done_cond);
+		pthread_mutex_unlock(&g_PMLIN_done_mutex);
+	}
+}
+
+static void PMLIN_handle_request(PMLIN_queue_t *q, PMLIN_request_t *request) {
+	uint32_t depth = atomic_load_explicit(&q->m_head, memory_order_relaxed) - q->m_tail + 1;
+	uint32_t wait = PMLIN_queue_time_us() - request->m_submit_time_us;
+	pthread_mutex_lock(&q->m_stats_mutex);
+	if (depth > q->m_stats.m_max_depth)
+		q->m_stats.m_max_depth = depth;
+	if (wait > q->m_stats.m_max_wait_us)
+		q->m_stats.m_max_wait_us = wait;
+	q->m_stats.m_total_wait_us += wait;
+	pthread_mutex_unlock(&q->m_stats_mutex);
+
+	if (request->m_mirror_tick) {
+		request->m_device_id = 0;
+		request->m_transaction.m_result = PMLIN_master_mirror_tick(q->m_master, &request->m_device_id);
+	} else
+		PMLIN_master_run_transaction(q->m_master, &request->m_transaction);
+	PMLIN_complete_request(q, request);
+}
+
+static void* PMLIN_bus_thread_fun(void *arguments) {
+	PMLIN_queue_t *q = arguments;
+	while (1) {
+		PMLIN_request_t *request = PMLIN_dequeue(q);
+		if (!request) {
+			if (atomic_load(&q->m_stop))
+				break;
+			pthread_mutex_lock(&q->m_wake_mutex);
+			atomic_store(&q->m_sleeping, true);
+			atomic_thread_fence(memory_order_seq_cst);
+			// check again now that the submitters can see that we are going to sleep
+			request = PMLIN_dequeue(q);
+			if (!request && !atomic_load(&q->m_stop))
+				pthread_cond_wait(&q->m_wake_cond, &q->m_wake_mutex);
+			atomic_store(&q->m_sleeping, false);
+			pthread_mutex_unlock(&q->m_wake_mutex);
+			if (!request)
+				continue;
+		}
+		PMLIN_handle_request(q, request);
+	}
+	return NULL;
+}
+
+PMLIN_error_t PMLIN_master_start_bus_thread(PMLIN_master_t *m, PMLIN_queue_t *q) {
+	if (m->m_queue && atomic_load(&m->m_queue->m_running))
+		return PMLIN_OK;
+	if (m->m_queue != q) { // a restart keeps the statistics
+		pthread_mutex_init(&q->m_wake_mutex, NULL);
+		pthread_cond_init(&q->m_wake_cond, NULL);
+		pthread_mutex_init(&q->m_stats_mutex, NULL);
+		PMLIN_queue_stats_t zero = { 0 };
+		q->m_stats = zero;
+		atomic_init(&q->m_submitted, 0);
+		atomic_init(&q->m_rejected, 0);
+		atomic_init(&q->m_submitters, 0);
+		atomic_init(&q->m_sleeping, false);
+		atomic_init(&q->m_running, false);
+	}
+	q->m_master = m;
+	for (size_t i = 0; i < PMLIN_QUEUE_SIZE; i++)
+		atomic_init(&q->m_slots[i].m_seq, i);
+	atomic_init(&q->m_head, 0);
+	q->m_tail = 0;
+	atomic_init(&q->m_stop, false);
+	m->m_queue = q;
+	if (pthread_create(&q->m_thread, NULL, PMLIN_bus_thread_fun, q))
+		return PMLIN_NO_INITIALIZED_ERROR;
+	atomic_store(&q->m_running, true);
+	return PMLIN_OK;
+}
+
+void PMLIN_master_stop_bus_thread(PMLIN_master_t *m) {
+	PMLIN_queue_t *q = m->m_queue;
+	if (!q || !atomic_load(&q->m_running))
+		return;
+	atomic_store(&q->m_running, false);
+	// a submitter that saw the thread running before the store above gets to finish its enqueue,
+	// those coming after it see the thread stopped
+	struct timespec sleep = { 0, 100000 };
+	while (atomic_load(&q->m_submitters))
+		nanosleep(&sleep, NULL);
+	atomic_store(&q->m_stop, true);
+	pthread_mutex_lock(&q->m_wake_mutex);
+	pthread_cond_signal(&q->m_wake_cond);
+	pthread_mutex_unlock(&q->m_wake_mutex);
+	pthread_join(q->m_thread, NULL);
+	// the thread empties the queue before it exits, but should anything be left do not leave its waiters hanging
+	PMLIN_request_t *request;
+	while ((request = PMLIN_dequeue(q))) {
+		request->m_transaction.m_result = PMLIN_NO_INITIALIZED_ERROR;
+		PMLIN_complete_request(q, request);
+	}
+}
+
+PMLIN_error_t PMLIN_master_submit_request(PMLIN_master_t *m, PMLIN_request_t *request) {
+	PMLIN_queue_t *q = m->m_queue;
+	if (!q)
+		return PMLIN_NO_INITIALIZED_ERROR;
+	// counted before checking that the thread runs, so PMLIN_stop_bus_thread waits for this enqueue to finish
+	atomic_fetch_add(&q->m_submitters, 1);
+	if (!atomic_load(&q->m_running)) {
+		atomic_fetch_sub(&q->m_submitters, 1);
+		return PMLIN_NO_INITIALIZED_ERROR;
+	}
+	atomic_init(&request->m_done, false);
+	request->m_submit_time_us = PMLIN_queue_time_us();
+	if (!PMLIN_enqueue(q, request)) {
+		atomic_fetch_sub(&q->m_submitters, 1);
+		atomic_fetch_add(&q->m_rejected, 1);
+		return PMLIN_QUEUE_FULL_ERROR;
+	}
+	atomic_fetch_sub(&q->m_submitters, 1);
+	atomic_fetch_add(&q->m_submitted, 1);
+	// pairs with the bus thread setting the sleeping flag before checking the queue one last time
+	atomic_thread_fence(memory_order_seq_cst);
+	if (atomic_load(&q->m_sleeping)) {
+		pthread_mutex_lock(&q->m_wake_mutex);
+		pthread_cond_signal(&q->m_wake_cond);
+		pthread_mutex_unlock(&q->m_wake_mutex);
+	}
+	return PMLIN_OK;
+}
+
+bool PMLIN_request_done(PMLIN_request_t *request) {
+	return atomic_load(&request->m_done);
+}
+
+PMLIN_error_t PMLIN_wait_request(PMLIN_request_t *request) {
+	pthread_mutex_lock(&g_PMLIN_done_mutex);
+	atomic_fetch_add(&g_PMLIN_waiters, 1);
+	while (!atomic_load(&request->m_done))
+		pthread_cond_wait(&g_PMLIN_done_cond, &g_PMLIN_done_mutex);
+	atomic_fetch_sub(&g_PMLIN_waiters, 1);
+	pthread_mutex_unlock(&g_PMLIN_done_mutex);
+	return request->m_transaction.m_result;
+}
+
+void PMLIN_master_get_queue_stats(PMLIN_master_t *m, PMLIN_queue_stats_t *stats, bool reset) {
+	PMLIN_queue_t *q = m->m_queue;
+	if (!q) {
+		PMLIN_queue_stats_t zero = { 0 };
+		*stats = zero;
+		return;
+	}
+	pthread_mutex_lock(&q->m_stats_mutex);
+	*stats = q->m_stats;
+	if (reset) {
+		PMLIN_queue_stats_t zero = { 0 };
+		q->m_stats = zero;
+	}
+	pthread_mutex_unlock(&q->m_stats_mutex);
+	// exchanged so that a submission between reading and zeroing is not lost
+	stats->m_submitted = reset ? atomic_exchange(&q->m_submitted, 0) : atomic_load(&q->m_submitted);
+	stats->m_rejected = reset ? atomic_exchange(&q->m_rejected, 0) : atomic_load(&q->m_rejected);
+}
+
+// the functions that do not take a PMLIN_master_t operate on the default instance
+
+PMLIN_error_t PMLIN_start_bus_thread() {
+	return PMLIN_master_start_bus_thread(PMLIN_default_master(), &g_PMLIN_default_queue);
+}
+
+void PMLIN_stop_bus_thread() {
+	PMLIN_master_stop_bus_thread(PMLIN_default_master());
+}
+
+PMLIN_error_t PMLIN_submit_request(PMLIN_request_t *request) {
+	return PMLIN_master_submit_request(PMLIN_default_master(), request);
+}
+
+void PMLIN_get_queue_stats(PMLIN_queue_stats_t *stats, bool reset) {
+	PMLIN_master_get_queue_stats(PMLIN_default_master(), stats, reset);
+}
@@ -0,0 +1,174 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef __PMLIN_MASTER_QUEUE_H__
+#define	__PMLIN_MASTER_QUEUE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "pmlin-master.h"
+
+// Optional bus owner thread for POSIX systems.
+//
+// When the bus thread is running one internal thread performs all the transactions submitted
+// with PMLIN_submit_request, in the order they were submitted. Submitting never blocks and never
+// takes a lock, the caller is informed of the completion via a callback and/or by waiting on the request.
+//
+// The mirroring can be run by the bus thread too: submit a PMLIN_MIRROR_TICK_REQUEST on each tick instead
+// of calling PMLIN_mirror_tick, then the mirroring and the other requests take turns on the bus thread
+// instead of contending for the PMLIN mutex.
+//
+// Each bus (PMLIN_master_t) has a bus thread and a queue of its own, the functions that do not take
+// a PMLIN_master_t use the default bus.
+
+#define PMLIN_QUEUE_SIZE 64 // number of preallocated request slots, must be a power of two
+
+typedef struct PMLIN_request_t PMLIN_request_t;
+
+// Typedef for the completion callback, called from the bus thread when the transaction is done
+typedef void (*PMLIN_completion_fp)(PMLIN_request_t *request);
+
+// this structure holds one request for the bus thread
+struct PMLIN_request_t {
+	PMLIN_transaction_t m_transaction; // the transaction to perform, result is in m_transaction.m_result
+	PMLIN_completion_fp m_completion; // called (can be NULL) from the bus thread when the transaction is done
+	void *m_user; // not used by PMLIN, for the completion callback
+	bool m_mirror_tick; // perform PMLIN_mirror_tick instead of m_transaction, its result goes to m_transaction.m_result
+	uint8_t m_device_id; // for a mirror tick, the id of the first device that did NOT respond PMLIN_OK, else 0
+	// following fields are private to PMLIN master code
+	atomic_bool m_done; // set after the completion callback has returned
+	uint32_t m_submit_time_us; // for the queue latency statistics
+};
+
+// macro used to declare and define a request, the transaction is declared with PMLIN_xxx_TRANSACTION macros
+#define PMLIN_REQUEST(transaction, completion, user) ((PMLIN_request_t) { \
+	.m_transaction = transaction, \
+	.m_completion = completion, \
+	.m_user = user \
+	})
+
+// macro used to declare and define a request that performs a PMLIN_mirror_tick
+#define PMLIN_MIRROR_TICK_REQUEST(completion, user) ((PMLIN_request_t) { \
+	.m_completion = completion, \
+	.m_user = user, \
+	.m_mirror_tick = true \
+	})
+
+// this structure holds the queue statistics, all times are in micro seconds
+typedef struct PMLIN_queue_stats_t {
+	uint32_t m_submitted; // requests accepted to the queue
+	uint32_t m_rejected; // requests rejected with PMLIN_QUEUE_FULL_ERROR
+	uint32_t m_completed; // requests completed
+	uint32_t m_max_depth; // maximum number of requests waiting in the queue
+	uint32_t m_max_wait_us; // maximum time from submission to the start of the transaction
+	uint64_t m_total_wait_us; // sum of the times from submission to the start of the transaction
+} PMLIN_queue_stats_t;
+
+// this structure holds one slot of the request queue, all fields are private to PMLIN master code
+typedef struct PMLIN_queue_slot_t {
+	atomic_size_t m_seq;
+	PMLIN_request_t *m_request;
+} PMLIN_queue_slot_t;
+
+// this structure holds the bus thread and the request queue of one bus, all fields are private to PMLIN master code
+typedef struct PMLIN_queue_t {
+	PMLIN_master_t *m_master; // the bus the requests are performed on
+	PMLIN_queue_slot_t m_slots[PMLIN_QUEUE_SIZE];
+	atomic_size_t m_head; // next position to submit to
+	size_t m_tail; // next position to take from, only accessed by the bus thread
+	pthread_t m_thread;
+	atomic_bool m_running;
+	atomic_bool m_stop;
+	atomic_uint m_submitters; // submitters that saw the bus thread running and may still enqueue
+	// only used when the bus thread is idle, i.e. never on the submission path while the bus is busy
+	pthread_mutex_t m_wake_mutex;
+	pthread_cond_t m_wake_cond;
+	atomic_bool m_sleeping;
+	atomic_uint m_submitted;
+	atomic_uint m_rejected;
+	pthread_mutex_t m_stats_mutex; // updated by the bus thread, read and reset by PMLIN_get_queue_stats
+	PMLIN_queue_stats_t m_stats; // the rest of the statistics, guarded by m_stats_mutex
+} PMLIN_queue_t;
+
+// Purpose: Start the bus thread
+//		Must be called after PMLIN_initialize_master
+//	Returns:				Error code
+//		PMLIN_OK
+//		PMLIN_NO_INITIALIZED_ERROR	if the thread could not be created
+
+PMLIN_error_t PMLIN_start_bus_thread();
+
+// Purpose: Stop the bus thread after it has completed all the requests submitted so far
+//		A request submitted concurrently with the stop is either completed or rejected with PMLIN_NO_INITIALIZED_ERROR
+
+void PMLIN_stop_bus_thread();
+
+// Purpose: Submit a request to the bus thread
+//		This call never blocks, the request must stay allocated until it is done
+// Parameters:
+//		request (in/out)	The request, declare with PMLIN_REQUEST or PMLIN_MIRROR_TICK_REQUEST
+//	Returns:				Error code
+//		PMLIN_OK
+//		PMLIN_QUEUE_FULL_ERROR
+//		PMLIN_NO_INITIALIZED_ERROR	if the bus thread is not running
+
+PMLIN_error_t PMLIN_submit_request(PMLIN_request_t *request);
+
+// Purpose: Returns true if the request is done, i.e. its completion callback has returned
+
+bool PMLIN_request_done(PMLIN_request_t *request);
+
+// Purpose: Wait for a submitted request to be done
+//		This call blocks until the transaction has completed
+// Returns:					The transaction result, see PMLIN_send_message etc for possible values
+
+PMLIN_error_t PMLIN_wait_request(PMLIN_request_t *request);
+
+// Purpose: Get a snapshot of the queue statistics
+// Parameters:
+//		stats (out)			Pointer to structure to receive the statistics
+//		reset (in)			If true the statistics are zeroed after taking the snapshot
+
+void PMLIN_get_queue_stats(PMLIN_queue_stats_t *stats, bool reset);
+
+// As above but for a given bus, the queue must stay allocated as long as the bus is used
+PMLIN_error_t PMLIN_master_start_bus_thread(PMLIN_master_t *m, PMLIN_queue_t *queue);
+void PMLIN_master_stop_bus_thread(PMLIN_master_t *m);
+PMLIN_error_t PMLIN_master_submit_request(PMLIN_master_t *m, PMLIN_request_t *request);
+void PMLIN_master_get_queue_stats(PMLIN_master_t *m, PMLIN_queue_stats_t *stats, bool reset);
+
+#endif
@@ -32,6 +32,8 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "pmlin-master.h"
+#include "pmlin-mirror-buffer.h"
+#include "pmlin-sample-ring.h"
 
 #include "pmlin.h"
 #include "aslac.h"
@@ -50,34 +52,45 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define CRC_LEN 1
 #define ACK_LEN 1
 
-static void *g_PMLIN_mutex;
+// the instance used by the functions that do not take a PMLIN_master_t
+static PMLIN_master_t g_PMLIN_default_master = { //
+		.m_poll_fd = -1, //
+		.m_min_slack_us = PMLIN_MIN_RESPONSE_SLACK_US, //
+		.m_gap_us = PMLIN_GAP_TIMEOUT_US, //
+		.m_poll_guard_us = PMLIN_DEFAULT_POLL_GUARD_US, //
+		.m_tick_period_us = PMLIN_DEFAULT_TICK_PERIOD_US, //
+		.m_send_now_interval = PMLIN_DEFAULT_SEND_NOW_INTERVAL, //
+		.m_send_now_per_tick = PMLIN_DEFAULT_SEND_NOW_PER_TICK, //
+		.m_quarantine_failures = PMLIN_DEFAULT_QUARANTINE_FAILURES, //
+		.m_min_backoff_ticks = PMLIN_DEFAULT_MIN_BACKOFF_TICKS, //
+		.m_max_backoff_ticks = PMLIN_DEFAULT_MAX_BACKOFF_TICKS, //
+		.m_utilization_warning_permille = PMLIN_UTILIZATION_WARNING_PERMILLE, //
+		.m_utilization_limit_permille = PMLIN_UTILIZATION_LIMIT_PERMILLE, //
+		.m_tables = &g_PMLIN_default_master.m_boot_tables //
+		};
 
-static bool g_PMLIN_initialized = false;
+// HAL functions passed to PMLIN_initialize_master, only ever used by the default instance
 static PMLIN_send_break_fp PMLIN_send_break = NULL;
 static PMLIN_write_fp PMLIN_write = NULL;
 static PMLIN_read_fp PMLIN_read = NULL;
-static PMLIN_mutex_fp PMLIN_lock_mutex = NULL;
-static PMLIN_mutex_fp PMLIN_unlock_mutex = NULL;
-static bool g_DEBUG_TRAFIC = 0;
-
-static PMLIN_device_decl_t *g_PMLIN_id_to_device[PMLIN_MAX_NUM_ID];
-
-
-static PMLIN_mirror_def_t *g_PMLIN_mirroring;
-static uint8_t g_PMLIN_num_mirroring;
+static PMLIN_read_gap_fp PMLIN_read_gap = NULL;
 
 #define ACDPRINT(...) printf(__VA_ARGS__)
 
-#define LOCK_MUTEX() do { \
-	if (g_PMLIN_mutex) \
-		PMLIN_lock_mutex(g_PMLIN_mutex); \
+#define LOCK_MUTEX(m) do { \
+	if ((m)->m_mutex) \
+		(m)->m_lock_mutex((m)->m_mutex); \
 	} while(0)
 
-#define UNLOCK_MUTEX() do { \
-	if (g_PMLIN_mutex) \
-		PMLIN_unlock_mutex(g_PMLIN_mutex); \
+#define UNLOCK_MUTEX(m) do { \
+	if ((m)->m_mutex) \
+		(m)->m_unlock_mutex((m)->m_mutex); \
 	} while(0)
 
+#define HAL_SEND_BREAK(m) (m)->m_hal.m_send_break((m)->m_hal.m_port)
+#define HAL_WRITE(m, buffer, len) (m)->m_hal.m_write((m)->m_hal.m_port, buffer, len)
+#define HAL_READ(m, buffer, len, timeout_us, gap_us) (m)->m_hal.m_read_gap((m)->m_hal.m_port, buffer, len, timeout_us, gap_us)
+
 static unsigned char const g_PMLIN_crc8_table[256] = { //
 		0x00, 0x31, 0x62, 0x53, 0xc4, 0xf5, 0xa6, 0x97, 0xb9, 0x88, 0xdb, 0xea, 0x7d, 0x4c, 0x1f, 0x2e, //
 				0x43, 0x72, 0x21, 0x10, 0x87, 0xb6, 0xe5, 0xd4, 0xfa, 0xcb, 0x98, 0xa9, 0x3e, 0x0f, 0x5c, 0x6d, //
@@ -101,9 +114,56 @@ uint8_t PMLIN_crc8(uint8_t crc, uint8_t data) {
 	return g_PMLIN_crc8_table[crc ^ data];
 }
 
-void PMLIN_set_debug_trafic(bool debug_traffic) {
-	g_DEBUG_TRAFIC = debug_traffic;
+PMLIN_master_t* PMLIN_default_master() {
+	return &g_PMLIN_default_master;
 }
+
+void PMLIN_master_set_debug_trafic(PMLIN_master_t *m, bool debug_traffic) {
+	m->m_debug_traffic = debug_traffic;
+}
+
+void PMLIN_master_initialize(PMLIN_master_t *m, PMLIN_hal_t hal, void *mutex, PMLIN_mutex_fp lock_fp, PMLIN_mutex_fp unlock_fp) {
+	memset(m, 0, sizeof(*m));
+	m->m_poll_fd = -1;
+	m->m_min_slack_us = PMLIN_MIN_RESPONSE_SLACK_US;
+	m->m_gap_us = PMLIN_GAP_TIMEOUT_US;
+	m->m_poll_guard_us = PMLIN_DEFAULT_POLL_GUARD_US;
+	m->m_tick_period_us = PMLIN_DEFAULT_TICK_PERIOD_US;
+	m->m_send_now_interval = PMLIN_DEFAULT_SEND_NOW_INTERVAL;
+	m->m_send_now_per_tick = PMLIN_DEFAULT_SEND_NOW_PER_TICK;
+	m->m_quarantine_failures = PMLIN_DEFAULT_QUARANTINE_FAILURES;
+	m->m_min_backoff_ticks = PMLIN_DEFAULT_MIN_BACKOFF_TICKS;
+	m->m_max_backoff_ticks = PMLIN_DEFAULT_MAX_BACKOFF_TICKS;
+	m->m_utilization_warning_permille = PMLIN_UTILIZATION_WARNING_PERMILLE;
+	m->m_utilization_limit_permille = PMLIN_UTILIZATION_LIMIT_PERMILLE;
+	atomic_init(&m->m_tables, &m->m_boot_tables);
+	atomic_init(&m->m_tick_tables, NULL);
+	atomic_init(&m->m_call_tables, NULL);
+	m->m_hal = hal;
+	m->m_mutex = mutex;
+	m->m_lock_mutex = lock_fp;
+	m->m_unlock_mutex = unlock_fp;
+	m->m_initialized = true;
+}
+
+// adapters from the context-less HAL functions of PMLIN_initialize_master to PMLIN_hal_t
+static void PMLIN_legacy_send_break(void *port) {
+	(void) port;
+	PMLIN_send_break();
+}
+
+static void PMLIN_legacy_write(void *port, uint8_t *buffer, uint16_t len) {
+	(void) port;
+	PMLIN_write(buffer, len);
+}
+
+static uint16_t PMLIN_legacy_read_gap(void *port, uint8_t *buffer, uint16_t len, uint32_t timeout_us, uint32_t gap_us) {
+	(void) port;
+	if (PMLIN_read_gap)
+		return PMLIN_read_gap(buffer, len, timeout_us, gap_us);
+	return PMLIN_read(buffer, len, timeout_us);
+}
+
 void PMLIN_initialize_master( //
 		PMLIN_send_break_fp break_fp, //
 		PMLIN_write_fp write_fp, //
@@ -112,213 +172,990 @@ void PMLIN_initialize_master( //
 		PMLIN_mutex_fp lock_fp, //
 		PMLIN_mutex_fp unlock_fp //
 		) {
+	PMLIN_master_t *m = &g_PMLIN_default_master;
 	PMLIN_send_break = break_fp;
 	PMLIN_write = write_fp;
 	PMLIN_read = read_fp;
-	PMLIN_lock_mutex = lock_fp;
-	PMLIN_unlock_mutex = unlock_fp;
-	g_PMLIN_mutex = mutex;
-	g_PMLIN_initialized = true;
+	m->m_hal = PMLIN_HAL(PMLIN_legacy_send_break, PMLIN_legacy_write, PMLIN_legacy_read_gap, NULL);
+	m->m_lock_mutex = lock_fp;
+	m->m_unlock_mutex = unlock_fp;
+	m->m_mutex = mutex;
+	m->m_initialized = true;
 }
 
-PMLIN_error_t PMLIN_send_message(uint8_t id, uint8_t type, uint8_t len, volatile uint8_t *data) {
-	if (!g_PMLIN_initialized)
-		return PMLIN_NO_INITIALIZED_ERROR;
+// number of polled slots and the length of each in character times, the answer and the guard time
+static uint8_t PMLIN_poll_slots(PMLIN_transaction_t *t) {
+	return t->m_last_id - t->m_first_id + 1;
+}
 
-	uint8_t buffer[1+PMLIN_HEADER_LEN+255+1];
+static uint32_t PMLIN_poll_slot_chars(PMLIN_master_t *m, uint8_t len) {
+	return 1 + len + CRC_LEN + (m->m_poll_guard_us + PMLIN_POLL_CHAR_TIME_US - 1) / PMLIN_POLL_CHAR_TIME_US;
+}
+
+// builds the frame to send into the transaction buffer and works out how many bytes to expect back,
+// the frame is placed after the break so that each echoed byte lands on top of the byte it should match
+static void PMLIN_prepare_transaction(PMLIN_master_t *m, PMLIN_transaction_t *t) {
+	t->m_master = m;
+	uint8_t *buffer = &t->m_buffer[BREAK_LEN];
 	uint16_t sn = 0;
-	uint8_t header = (type << PMLIN_MSG_TYPE_BITPOS) + id;
+	t->m_buffer[0] = 0; // a break reads back as zero, not checked though
+	bool cmd = t->m_kind == PMLIN_TRANSACTION_CMD || t->m_kind == PMLIN_TRANSACTION_POLL;
+	uint8_t type = cmd ? PMLIN_MESSAGE_TYPE_CMD : t->m_type;
+	uint8_t header = (type << PMLIN_MSG_TYPE_BITPOS) + t->m_id;
 	buffer[sn++] = header;
 	buffer[sn++] = PMLIN_crc8(PMLIN_CRC_INIT_VAL, header);
-	uint8_t crc = PMLIN_CRC_INIT_VAL;
-	for (uint16_t j = 0; j < len; j++) {
-		uint8_t byte = data[j];
-		crc = PMLIN_crc8(crc, byte);
-		buffer[sn++] = byte;
-	}
-	buffer[sn++] = crc;
-	LOCK_MUTEX();
-	PMLIN_send_break();
-	PMLIN_write(buffer, sn);
-	uint16_t rn = BREAK_LEN + PMLIN_HEADER_LEN + len + CRC_LEN + ACK_LEN;
-	uint16_t n = PMLIN_read(buffer, rn, PMLIN_TIMEOUT);
-	UNLOCK_MUTEX();
-
-	if (g_DEBUG_TRAFIC) {
-		for (uint16_t i = 0; i < n; i++) {
-			if (i < rn - 1)
-				printf("(%02X) ", buffer[i]);
-			else
-				printf("[%02X] ", buffer[i]);
+	switch (t->m_kind) {
+	case PMLIN_TRANSACTION_CMD:
+		t->m_len = PMLIN_CMD_MSG_LEN;
+		// fall through
+	case PMLIN_TRANSACTION_SEND:
+	case PMLIN_TRANSACTION_EXCHANGE:
+	case PMLIN_TRANSACTION_BROADCAST: {
+		uint8_t crc = PMLIN_CRC_INIT_VAL;
+		for (uint16_t j = 0; j < t->m_len; j++) {
+			uint8_t byte = t->m_data[j];
+			crc = PMLIN_crc8(crc, byte);
+			buffer[sn++] = byte;
 		}
-		if (rn != n)
-			printf("len!");
-		else if (buffer[rn - 1] != PMLIN_ACK_CHAR)
-			printf("ack!");
-		else
-			printf("ok");
-		printf("\n");
+		buffer[sn++] = crc;
+		break;
 	}
-	if (sn + 1 == n)
-		return PMLIN_NO_RESP_ERROR;
-	else if (rn != n)
-		return PMLIN_TIMEOUT_ERROR;
-	else if (buffer[rn - 1] != PMLIN_ACK_CHAR)
-		return PMLIN_NO_ACK_ERROR;
+	case PMLIN_TRANSACTION_POLL: {
+		uint8_t *payload = &buffer[sn];
+		payload[PMLIN_CMD_MSG_CMD_IDX] = PMLIN_CMD_MSG_CMD_POLL;
+		payload[PMLIN_CMD_MSG_POLL_TYPE_IDX] = t->m_type;
+		payload[PMLIN_CMD_MSG_POLL_FIRST_ID_IDX] = t->m_first_id;
+		payload[PMLIN_CMD_MSG_POLL_LAST_ID_IDX] = t->m_last_id;
+		payload[PMLIN_CMD_MSG_POLL_SLOT_LEN_IDX] = PMLIN_poll_slot_chars(m, t->m_len);
+		uint8_t crc = PMLIN_CRC_INIT_VAL;
+		for (uint16_t j = 0; j < PMLIN_CMD_MSG_LEN; j++)
+			crc = PMLIN_crc8(crc, payload[j]);
+		sn += PMLIN_CMD_MSG_LEN;
+		buffer[sn++] = crc;
+		break;
+	}
+	default:
+		break;
+	}
+	t->m_sn = sn;
+	if (t->m_kind == PMLIN_TRANSACTION_SEND)
+		t->m_rn = BREAK_LEN + sn + ACK_LEN;
+	else if (t->m_kind == PMLIN_TRANSACTION_CMD)
+		t->m_rn = BREAK_LEN + sn + PMLIN_CMD_RESP_LEN + CRC_LEN;
+	else if (t->m_kind == PMLIN_TRANSACTION_EXCHANGE)
+		t->m_rn = BREAK_LEN + sn + t->m_resp_len + CRC_LEN;
+	else if (t->m_kind == PMLIN_TRANSACTION_BROADCAST)
+		t->m_rn = BREAK_LEN + sn; // nobody responds
+	else if (t->m_kind == PMLIN_TRANSACTION_POLL)
+		t->m_rn = BREAK_LEN + sn + PMLIN_poll_slots(t) * (1 + t->m_len + CRC_LEN); // every slot answered
 	else
-		return PMLIN_OK;
+		t->m_rn = BREAK_LEN + sn + t->m_len + CRC_LEN;
+	t->m_n = 0;
+	t->m_result = PMLIN_OK;
+}
 
+// picks the answers out of the slots received after the echo, a missing slave leaves an empty slot so the
+// answers are recognized by their slot header, returns the result of the first slot that failed
+static PMLIN_error_t PMLIN_complete_poll(PMLIN_transaction_t *t) {
+	uint8_t *buffer = t->m_buffer;
+	uint16_t n = t->m_n;
+	uint8_t len = t->m_len;
+	for (uint8_t i = 0; i < PMLIN_poll_slots(t); i++)
+		t->m_results[i] = PMLIN_NO_RESP_ERROR;
+	uint8_t next_id = t->m_first_id;
+	for (uint16_t i = BREAK_LEN + t->m_sn; i < n;) {
+		uint8_t id = buffer[i] & PMLIN_MSG_ID_MASK;
+		if (buffer[i] >> PMLIN_MSG_TYPE_BITPOS != t->m_type || id < next_id || id > t->m_last_id) {
+			i++; // not a slot header, noise or a damaged answer
+			continue;
+		}
+		PMLIN_error_t *result = &t->m_results[id - t->m_first_id];
+		if (i + 1 + len + CRC_LEN > n) {
+			*result = PMLIN_TIMEOUT_ERROR;
+			break;
+		}
+		uint8_t crc = PMLIN_CRC_INIT_VAL;
+		for (uint16_t j = i; j < i + 1 + len + CRC_LEN; j++)
+			crc = PMLIN_crc8(crc, buffer[j]);
+		if (crc)
+			*result = PMLIN_CRC_ERROR;
+		else {
+			*result = PMLIN_OK;
+			memcpy((void*) &t->m_data[(id - t->m_first_id) * len], (void*) &buffer[i + 1], len);
+		}
+		next_id = id + 1;
+		i += 1 + len + CRC_LEN;
+	}
+	for (uint8_t i = 0; i < PMLIN_poll_slots(t); i++)
+		if (t->m_results[i] != PMLIN_OK)
+			return t->m_results[i];
+	return PMLIN_OK;
 }
 
-PMLIN_error_t PMLIN_send_cmd_message(uint8_t id, volatile uint8_t *data, volatile uint8_t *resp) {
-	if (!g_PMLIN_initialized)
-		return PMLIN_NO_INITIALIZED_ERROR;
-	uint8_t buffer[1 + PMLIN_HEADER_LEN + PMLIN_CMD_MSG_LEN + CRC_LEN + PMLIN_CMD_RESP_LEN + CRC_LEN];
-	uint16_t sn = 0;
-	uint8_t header = (PMLIN_MESSAGE_TYPE_CMD << PMLIN_MSG_TYPE_BITPOS) + id;
-	buffer[sn++] = header;
-	buffer[sn++] = PMLIN_crc8(PMLIN_CRC_INIT_VAL, header);
-	uint8_t crc = PMLIN_CRC_INIT_VAL;
-	for (uint16_t j = 0; j < PMLIN_CMD_MSG_LEN; j++) {
-		uint8_t byte = data[j];
-		crc = PMLIN_crc8(crc, byte);
-		buffer[sn++] = byte;
-	}
-	buffer[sn++] = crc;
-	LOCK_MUTEX();
-	PMLIN_send_break();
-	PMLIN_write(buffer, sn);
-	uint16_t rn = sizeof(buffer) / sizeof(uint8_t);
-	uint16_t n = PMLIN_read(buffer, rn, PMLIN_TIMEOUT);
-	UNLOCK_MUTEX();
-	crc = PMLIN_CRC_INIT_VAL;
-	for (uint16_t i = 0; i < PMLIN_CMD_RESP_LEN + 1; i++) {
-		uint8_t byte = buffer[BREAK_LEN + PMLIN_HEADER_LEN + PMLIN_CMD_MSG_LEN + CRC_LEN + i];
-		crc = PMLIN_crc8(crc, byte);
-	}
-	for (uint16_t i = 0; i < PMLIN_CMD_RESP_LEN; i++)
-		resp[i] = buffer[i + 1 + PMLIN_HEADER_LEN + PMLIN_CMD_MSG_LEN + CRC_LEN];
-
-	if (g_DEBUG_TRAFIC) {
+// evaluates the echo and the response received into the transaction buffer, returns the result
+static PMLIN_error_t PMLIN_complete_transaction(PMLIN_transaction_t *t) {
+	uint8_t *buffer = t->m_buffer;
+	uint16_t echo = BREAK_LEN + t->m_sn; // the master receives back everything it sent
+	uint16_t rn = t->m_rn;
+	uint16_t n = t->m_n;
+
+	uint8_t crc = 0; // sent messages have no crc in the response, just the ack, poll slots have a crc each
+	if (t->m_kind != PMLIN_TRANSACTION_SEND && t->m_kind != PMLIN_TRANSACTION_BROADCAST && t->m_kind != PMLIN_TRANSACTION_POLL) {
+		crc = PMLIN_CRC_INIT_VAL;
+		for (uint16_t i = echo; i < rn; i++)
+			crc = PMLIN_crc8(crc, buffer[i]);
+	}
+
+	if (t->m_master->m_debug_traffic) {
 		for (uint16_t i = 0; i < n; i++) {
-			if (i < BREAK_LEN + PMLIN_HEADER_LEN + PMLIN_CMD_MSG_LEN + CRC_LEN)
+			if (i < echo)
 				printf("(%02X) ", buffer[i]);
 			else
 				printf("[%02X] ", buffer[i]);
 		}
-		if (rn != n)
+		if (t->m_result == PMLIN_COLLISION_ERROR)
+			printf("col!");
+		else if (rn != n)
 			printf("len!");
+		else if (t->m_kind == PMLIN_TRANSACTION_SEND && buffer[rn - 1] != PMLIN_ACK_CHAR)
+			printf("ack!");
 		else if (crc)
 			printf("crc!");
 		else
 			printf("ok");
 		printf("\n");
 	}
-	if (sn + 1 == n)
+
+	if (t->m_kind == PMLIN_TRANSACTION_RECEIVE)
+		memcpy((void*) t->m_data, (void*) &buffer[echo], t->m_len);
+	else if (t->m_kind == PMLIN_TRANSACTION_CMD)
+		memcpy((void*) t->m_resp, (void*) &buffer[echo], PMLIN_CMD_RESP_LEN);
+	else if (t->m_kind == PMLIN_TRANSACTION_EXCHANGE)
+		memcpy((void*) t->m_resp, (void*) &buffer[echo], t->m_resp_len);
+
+	if (t->m_result == PMLIN_COLLISION_ERROR)
+		return PMLIN_COLLISION_ERROR;
+	else if (t->m_kind == PMLIN_TRANSACTION_BROADCAST)
+		return rn == n ? PMLIN_OK : PMLIN_TIMEOUT_ERROR;
+	else if (t->m_kind == PMLIN_TRANSACTION_POLL)
+		return n < echo ? PMLIN_TIMEOUT_ERROR : PMLIN_complete_poll(t);
+	else if (echo == n)
 		return PMLIN_NO_RESP_ERROR;
 	else if (rn != n)
 		return PMLIN_TIMEOUT_ERROR;
+	else if (t->m_kind == PMLIN_TRANSACTION_SEND && buffer[rn - 1] != PMLIN_ACK_CHAR)
+		return PMLIN_NO_ACK_ERROR;
 	else if (crc)
 		return PMLIN_CRC_ERROR;
 	else
 		return PMLIN_OK;
+}
 
+void PMLIN_set_read_gap_callback(PMLIN_read_gap_fp read_gap_fp) {
+	PMLIN_read_gap = read_gap_fp;
 }
 
-PMLIN_error_t PMLIN_receive_message(uint8_t id, uint8_t type, uint8_t len, volatile uint8_t *data) {
-	if (!g_PMLIN_initialized)
+void PMLIN_master_set_timeouts(PMLIN_master_t *m, uint32_t min_slack_us, uint32_t gap_us) {
+	m->m_min_slack_us = min_slack_us;
+	m->m_gap_us = gap_us;
+}
+
+uint32_t PMLIN_master_get_response_slack(PMLIN_master_t *m, uint8_t id) {
+	uint32_t slack = m->m_response_slack_us[id & PMLIN_MSG_ID_MASK];
+	return slack ? slack : PMLIN_INITIAL_RESPONSE_SLACK_US;
+}
+
+// how long the slave may take on top of the airtime, RENUM responses are delayed on purpose by the slaves
+static uint32_t PMLIN_transaction_slack(PMLIN_transaction_t *t) {
+	PMLIN_master_t *m = t->m_master;
+	uint32_t slack = 2 * PMLIN_master_get_response_slack(m, t->m_id);
+	if (m->m_health[t->m_id & PMLIN_MSG_ID_MASK].m_quarantined) // probing, a smaller margin and no initial guess
+		slack = m->m_response_slack_us[t->m_id & PMLIN_MSG_ID_MASK] + m->m_min_slack_us;
+	if (t->m_kind == PMLIN_TRANSACTION_CMD && t->m_data[PMLIN_CMD_MSG_CMD_IDX] == PMLIN_CMD_MSG_CMD_RENUM)
+		slack += PMLIN_RENUM_MAX_WAIT_US;
+	if (t->m_kind == PMLIN_TRANSACTION_POLL) // the slots include the guard against late slaves
+		slack = m->m_min_slack_us + m->m_poll_guard_us;
+	return slack;
+}
+
+static uint32_t PMLIN_limit_timeout(uint32_t timeout) {
+	return timeout < PMLIN_TIMEOUT ? timeout : PMLIN_TIMEOUT;
+}
+
+// timeout for reading back our own frame, the echo is there as soon as the bytes have been on the wire
+// so only driver latency is allowed on top of the airtime
+static uint32_t PMLIN_echo_timeout(PMLIN_transaction_t *t) {
+	t->m_gap_us = t->m_master->m_gap_us;
+	if (t->m_kind == PMLIN_TRANSACTION_POLL) // empty slots are pauses in the data
+		t->m_gap_us += PMLIN_poll_slots(t) * PMLIN_poll_slot_chars(t->m_master, t->m_len) * PMLIN_POLL_CHAR_TIME_US;
+	return PMLIN_limit_timeout((BREAK_LEN + t->m_sn) * PMLIN_CHAR_TIME_US + t->m_gap_us);
+}
+
+// timeout for the response counted from the end of the echo, an absent slave is detected after the slack
+static uint32_t PMLIN_response_timeout(PMLIN_transaction_t *t) {
+	uint16_t len = t->m_rn - BREAK_LEN - t->m_sn;
+	if (t->m_kind == PMLIN_TRANSACTION_POLL)
+		len = PMLIN_poll_slots(t) * PMLIN_poll_slot_chars(t->m_master, t->m_len);
+	return PMLIN_limit_timeout(len * PMLIN_CHAR_TIME_US + PMLIN_transaction_slack(t));
+}
+
+// copies n received bytes to the transaction buffer checking the part that should be our own echo,
+// returns false if the echo differs from what was sent i.e. someone else was transmitting at the same time
+static bool PMLIN_receive_bytes(PMLIN_transaction_t *t, const uint8_t *data, uint16_t n) {
+	uint16_t echo = BREAK_LEN + t->m_sn;
+	bool ok = true;
+	for (uint16_t i = 0; i < n; i++) {
+		uint16_t j = t->m_n++;
+		if (j >= BREAK_LEN && j < echo && t->m_buffer[j] != data[i])
+			ok = false;
+		t->m_buffer[j] = data[i];
+	}
+	if (!ok)
+		t->m_result = PMLIN_COLLISION_ERROR;
+	return ok;
+}
+
+// updates the learned response slack of the device after a successful transaction,
+// elapsed_us is the time from the end of the echo to the end of the response
+static void PMLIN_learn_response_slack(PMLIN_transaction_t *t, uint32_t elapsed_us) {
+	if (t->m_kind == PMLIN_TRANSACTION_CMD && t->m_data[PMLIN_CMD_MSG_CMD_IDX] == PMLIN_CMD_MSG_CMD_RENUM)
+		return; // deliberately random
+	uint32_t airtime = (t->m_rn - BREAK_LEN - t->m_sn) * PMLIN_CHAR_TIME_US;
+	uint32_t excess = elapsed_us > airtime ? elapsed_us - airtime : 0;
+	uint32_t *slack = &t->m_master->m_response_slack_us[t->m_id & PMLIN_MSG_ID_MASK];
+	// follow increases immediately, decreases slowly
+	if (excess >= *slack)
+		*slack = excess;
+	else
+		*slack -= (*slack - excess) / 8;
+	if (*slack < t->m_master->m_min_slack_us)
+		*slack = t->m_master->m_min_slack_us;
+}
+
+// adds a transaction to the measured bus utilization, caller must hold the mutex
+static void PMLIN_account_bus_time(PMLIN_master_t *m, uint32_t start_us, uint32_t end_us) {
+	if (!m->m_measuring) {
+		m->m_measuring = true;
+		m->m_measured_us = start_us;
+	}
+	m->m_elapsed_us += end_us - m->m_measured_us;
+	m->m_measured_us = end_us;
+	m->m_busy_us += end_us - start_us;
+	m->m_frames++;
+}
+
+// sends the prepared frame and reads back the echo and the response, caller must hold the mutex,
+// returns the time from the end of the echo to the end of the response
+static uint32_t PMLIN_exchange_frame(PMLIN_transaction_t *t) {
+	PMLIN_master_t *m = t->m_master;
+	uint16_t echo = BREAK_LEN + t->m_sn;
+	uint8_t rx[PMLIN_MAX_FRAME_LEN];
+	uint32_t elapsed = 0;
+	uint32_t timeout = PMLIN_echo_timeout(t);
+	uint32_t t_bus = m->m_time_us ? m->m_time_us() : 0;
+	HAL_SEND_BREAK(m);
+	HAL_WRITE(m, &t->m_buffer[BREAK_LEN], t->m_sn);
+	uint16_t n = HAL_READ(m, rx, echo, timeout, t->m_gap_us);
+	// only wait for the response if our frame made it to the bus intact
+	if (PMLIN_receive_bytes(t, rx, n) && n == echo && t->m_rn > echo) {
+		uint32_t t0 = m->m_time_us ? m->m_time_us() : 0;
+		t->m_n += HAL_READ(m, &t->m_buffer[echo], t->m_rn - echo, PMLIN_response_timeout(t), t->m_gap_us);
+		elapsed = m->m_time_us ? m->m_time_us() - t0 : 0;
+	}
+	t->m_end_us = m->m_time_us ? m->m_time_us() : 0;
+	if (m->m_time_us)
+		PMLIN_account_bus_time(m, t_bus, t->m_end_us);
+	return elapsed;
+}
+
+static void PMLIN_finish_transaction(PMLIN_transaction_t *t, uint32_t elapsed) {
+	t->m_result = PMLIN_complete_transaction(t);
+	t->m_state = PMLIN_TRANSACTION_DONE;
+	if (t->m_result == PMLIN_OK && t->m_master->m_time_us && t->m_id != PMLIN_BROADCAST_ID)
+		PMLIN_learn_response_slack(t, elapsed);
+}
+
+PMLIN_error_t PMLIN_master_run_transaction(PMLIN_master_t *m, PMLIN_transaction_t *t) {
+	if (!m->m_initialized)
 		return PMLIN_NO_INITIALIZED_ERROR;
-	uint8_t buffer[1+PMLIN_HEADER_LEN+255+1];
-	uint16_t i = 0;
-	uint8_t header = (type << PMLIN_MSG_TYPE_BITPOS) + id;
+	PMLIN_prepare_transaction(m, t);
+	LOCK_MUTEX(m);
+	// finished under the lock too as it updates the learned response slack shared by all the transactions
+	PMLIN_finish_transaction(t, PMLIN_exchange_frame(t));
+	UNLOCK_MUTEX(m);
+	return t->m_result;
+}
 
-	buffer[i++] = header;
-	buffer[i++] = PMLIN_crc8(PMLIN_CRC_INIT_VAL, header);
+PMLIN_error_t PMLIN_master_transact_batch(PMLIN_master_t *m, PMLIN_transaction_t transactions[], uint16_t num_transactions) {
+	if (!m->m_initialized)
+		return PMLIN_NO_INITIALIZED_ERROR;
+	// all frames are built before taking the bus so that they go out back to back
+	for (uint16_t i = 0; i < num_transactions; i++)
+		PMLIN_prepare_transaction(m, &transactions[i]);
+	PMLIN_error_t res = PMLIN_OK;
+	LOCK_MUTEX(m);
+	for (uint16_t i = 0; i < num_transactions; i++) {
+		PMLIN_transaction_t *t = &transactions[i];
+		PMLIN_finish_transaction(t, PMLIN_exchange_frame(t));
+		if (res == PMLIN_OK)
+			res = t->m_result;
+	}
+	UNLOCK_MUTEX(m);
+	return res;
+}
 
-	uint16_t sn = i;
-	LOCK_MUTEX();
-	PMLIN_send_break();
-	PMLIN_write(buffer, sn);
+PMLIN_error_t PMLIN_master_send_message(PMLIN_master_t *m, uint8_t id, uint8_t type, uint8_t len, volatile uint8_t *data) {
+	PMLIN_transaction_t t = PMLIN_SEND_TRANSACTION(id, type, len, data);
+	return PMLIN_master_run_transaction(m, &t);
+}
+
+PMLIN_error_t PMLIN_master_send_cmd_message(PMLIN_master_t *m, uint8_t id, volatile uint8_t *data, volatile uint8_t *resp) {
+	PMLIN_transaction_t t = PMLIN_CMD_TRANSACTION(id, data, resp);
+	return PMLIN_master_run_transaction(m, &t);
+}
+
+uint8_t PMLIN_build_group_payload(uint8_t *payload, uint32_t mask, uint8_t slice_len, volatile const uint8_t *slices) {
+	mask &= ~(1UL << PMLIN_BROADCAST_ID);
+	uint16_t len = 0;
+	for (uint8_t id = PMLIN_FIRST_DEVICE_ID; id < PMLIN_MAX_NUM_ID; id++)
+		if (mask & (1UL << id))
+			len += slice_len;
+	if (len > PMLIN_GROUP_MAX_SLICES_LEN)
+		return 0;
+	payload[PMLIN_GROUP_SLICE_LEN_IDX] = slice_len;
+	for (uint8_t i = 0; i < 4; i++)
+		payload[PMLIN_GROUP_MASK_IDX + i] = mask >> (8 * i);
+	for (uint16_t i = 0; i < len; i++)
+		payload[PMLIN_GROUP_HEADER_LEN + i] = slices[i];
+	return PMLIN_GROUP_HEADER_LEN + len;
+}
+
+PMLIN_error_t PMLIN_master_send_group(PMLIN_master_t *m, uint8_t type, uint32_t mask, uint8_t slice_len, volatile uint8_t *slices) {
+	uint8_t payload[PMLIN_GROUP_HEADER_LEN + PMLIN_GROUP_MAX_SLICES_LEN];
+	if (type == PMLIN_MESSAGE_TYPE_CMD)
+		return PMLIN_INVALID_ARGUMENT_ERROR;
+	uint8_t len = PMLIN_build_group_payload(payload, mask, slice_len, slices);
+	if (!len)
+		return PMLIN_INVALID_ARGUMENT_ERROR;
+	PMLIN_transaction_t t = PMLIN_BROADCAST_TRANSACTION(type, len, payload);
+	return PMLIN_master_run_transaction(m, &t);
+}
+
+PMLIN_error_t PMLIN_master_exchange_message(PMLIN_master_t *m, uint8_t id, uint8_t type, uint8_t len, volatile uint8_t *data,
+		uint8_t resp_len, volatile uint8_t *resp) {
+	PMLIN_transaction_t t = PMLIN_EXCHANGE_TRANSACTION(id, type, len, data, resp_len, resp);
+	return PMLIN_master_run_transaction(m, &t);
+}
 
-	uint16_t rn = BREAK_LEN + PMLIN_HEADER_LEN + len + CRC_LEN;
-	uint16_t n = PMLIN_read(buffer, rn, PMLIN_TIMEOUT);
-	UNLOCK_MUTEX();
+PMLIN_error_t PMLIN_master_poll_messages(PMLIN_master_t *m, uint8_t type, uint8_t first_id, uint8_t last_id, uint8_t len,
+		volatile uint8_t *data, PMLIN_error_t results[]) {
+	if (first_id < PMLIN_FIRST_DEVICE_ID || last_id >= PMLIN_MAX_NUM_ID || first_id > last_id || type == PMLIN_MESSAGE_TYPE_CMD)
+		return PMLIN_INVALID_ARGUMENT_ERROR;
+	uint16_t answers = (last_id - first_id + 1) * (1 + len + CRC_LEN);
+	if (PMLIN_poll_slot_chars(m, len) > UINT8_MAX || BREAK_LEN + PMLIN_HEADER_LEN + PMLIN_CMD_MSG_LEN + CRC_LEN + answers > PMLIN_MAX_FRAME_LEN)
+		return PMLIN_INVALID_ARGUMENT_ERROR;
+	PMLIN_transaction_t t = PMLIN_POLL_TRANSACTION(type, first_id, last_id, len, data, results);
+	return PMLIN_master_run_transaction(m, &t);
+}
+
+void PMLIN_master_set_poll_guard_us(PMLIN_master_t *m, uint32_t guard_us) {
+	m->m_poll_guard_us = guard_us;
+}
+
+PMLIN_error_t PMLIN_master_send_trigger(PMLIN_master_t *m, uint32_t mask) {
+	uint8_t payload[PMLIN_CMD_MSG_LEN];
+	payload[PMLIN_CMD_MSG_CMD_IDX] = PMLIN_CMD_MSG_CMD_TRIGGER;
+	for (uint8_t i = 0; i < 4; i++)
+		payload[PMLIN_CMD_MSG_TRIGGER_MASK_IDX + i] = mask >> (8 * i);
+	PMLIN_transaction_t t = PMLIN_BROADCAST_TRANSACTION(PMLIN_MESSAGE_TYPE_CMD, PMLIN_CMD_MSG_LEN, payload);
+	return PMLIN_master_run_transaction(m, &t);
+}
+
+PMLIN_error_t PMLIN_master_receive_message(PMLIN_master_t *m, uint8_t id, uint8_t type, uint8_t len, volatile uint8_t *data) {
+	PMLIN_transaction_t t = PMLIN_RECEIVE_TRANSACTION(id, type, len, data);
+	return PMLIN_master_run_transaction(m, &t);
+}
+
+void PMLIN_master_initialize_nonblocking(PMLIN_master_t *m, int poll_fd, PMLIN_time_us_fp time_fp) {
+	m->m_poll_fd = poll_fd;
+	m->m_time_us = time_fp;
+}
+
+int PMLIN_master_get_poll_fd(PMLIN_master_t *m) {
+	return m->m_poll_fd;
+}
 
-	uint8_t crc = PMLIN_CRC_INIT_VAL;
-	for (uint16_t i = 0; i < len + 1; i++) {
-		uint8_t byte = buffer[BREAK_LEN + PMLIN_HEADER_LEN + i];
-		crc = PMLIN_crc8(crc, byte);
+PMLIN_error_t PMLIN_master_start_transaction(PMLIN_master_t *m, PMLIN_transaction_t *t) {
+	if (!m->m_initialized || !m->m_time_us)
+		return PMLIN_NO_INITIALIZED_ERROR;
+	PMLIN_prepare_transaction(m, t);
+	uint32_t timeout = PMLIN_echo_timeout(t);
+	LOCK_MUTEX(m);
+	t->m_start_us = m->m_time_us();
+	t->m_bus_start_us = t->m_start_us;
+	t->m_last_rx_us = t->m_start_us;
+	HAL_SEND_BREAK(m);
+	HAL_WRITE(m, &t->m_buffer[BREAK_LEN], t->m_sn);
+	t->m_deadline = t->m_start_us + timeout;
+	t->m_state = PMLIN_TRANSACTION_WAIT_RESPONSE;
+	return PMLIN_OK;
+}
+
+bool PMLIN_step_transaction(PMLIN_transaction_t *t) {
+	if (t->m_state != PMLIN_TRANSACTION_WAIT_RESPONSE)
+		return t->m_state == PMLIN_TRANSACTION_DONE;
+	PMLIN_master_t *m = t->m_master;
+	uint16_t echo = BREAK_LEN + t->m_sn;
+	uint8_t rx[PMLIN_MAX_FRAME_LEN];
+	// zero timeout, just collect what ever has already arrived
+	uint16_t n = HAL_READ(m, rx, t->m_rn - t->m_n, 0, 0);
+	uint32_t now = m->m_time_us();
+	bool was_echo = t->m_n < echo;
+	bool ok = PMLIN_receive_bytes(t, rx, n);
+	if (n)
+		t->m_last_rx_us = now;
+	if (ok && was_echo && t->m_n >= echo) { // echo complete, the response clock starts now
+		t->m_start_us = now;
+		t->m_deadline = now + PMLIN_response_timeout(t);
 	}
+	if (ok && t->m_n < t->m_rn && PMLIN_transaction_time_left(t) > 0)
+		return false;
+	t->m_end_us = now;
+	PMLIN_account_bus_time(m, t->m_bus_start_us, now);
+	t->m_result = PMLIN_complete_transaction(t);
+	t->m_state = PMLIN_TRANSACTION_DONE;
+	if (t->m_result == PMLIN_OK && t->m_id != PMLIN_BROADCAST_ID)
+		PMLIN_learn_response_slack(t, now - t->m_start_us);
+	UNLOCK_MUTEX(m);
+	return true;
+}
 
-	if (g_DEBUG_TRAFIC) {
-		for (uint16_t i = 0; i < n; i++) {
-			if (i < BREAK_LEN + PMLIN_HEADER_LEN)
-				printf("(%02X) ", buffer[i]);
-			else
-				printf("[%02X] ", buffer[i]);
+uint32_t PMLIN_transaction_time_left(PMLIN_transaction_t *t) {
+	if (t->m_state != PMLIN_TRANSACTION_WAIT_RESPONSE)
+		return 0;
+	uint32_t now = t->m_master->m_time_us();
+	int32_t left = (int32_t) (t->m_deadline - now); // wrap around safe
+	// once data has started to flow also the inter-byte timeout applies, the pause between
+	// the echo and the response is covered by the response timeout alone
+	if (t->m_n > 0 && t->m_n != BREAK_LEN + t->m_sn) {
+		int32_t gap_left = (int32_t) (t->m_last_rx_us + t->m_gap_us - now);
+		if (gap_left < left)
+			left = gap_left;
+	}
+	return left > 0 ? left : 0;
+}
+
+static void PMLIN_set_devices(PMLIN_tables_t *t, PMLIN_device_decl_t devices[], uint8_t num_devices) {
+	for (uint8_t i = 0; i < PMLIN_MAX_NUM_ID; i++)
+		t->m_id_to_device[i] = NULL;
+	for (uint8_t i = 0; i < num_devices; i++) {
+		t->m_id_to_device[devices[i].m_id] = &devices[i];
+	}
+}
+
+void PMLIN_master_define_devices(PMLIN_master_t *m, PMLIN_device_decl_t devices[], uint8_t num_devices) {
+	PMLIN_set_devices(&m->m_boot_tables, devices, num_devices);
+	memset(m->m_health, 0, sizeof(m->m_health));
+	atomic_store(&m->m_tables, &m->m_boot_tables);
+}
+
+// The mirror scheduler is a hierarchical timing wheel. m_wheel[0] has a slot for each tick of the current
+// wheel turn, each kept in mirroring[] order. m_wheel[1] has a slot for each following wheel turn, its entries
+// are moved to m_wheel[0] when their turn begins. So an entry is handled at most twice per transfer.
+
+#define WHEEL_MASK (PMLIN_MIRROR_WHEEL_SIZE - 1)
+
+static void PMLIN_schedule_mirror(PMLIN_master_t *m, PMLIN_tables_t *t, PMLIN_mirror_def_t *mirror) {
+	uint32_t due = mirror->m_due;
+	if ((due >> PMLIN_MIRROR_WHEEL_BITS) != (m->m_tick >> PMLIN_MIRROR_WHEEL_BITS)) {
+		PMLIN_mirror_def_t **slot = &t->m_wheel[1][(due >> PMLIN_MIRROR_WHEEL_BITS) & WHEEL_MASK];
+		mirror->m_next = *slot;
+		*slot = mirror;
+		return;
+	}
+	// entries are mostly scheduled in mirroring[] order so appending is the common case
+	uint32_t i = due & WHEEL_MASK;
+	PMLIN_mirror_def_t **p = &t->m_wheel[0][i];
+	if (*p && mirror > t->m_wheel_tail[i])
+		p = &t->m_wheel_tail[i]->m_next;
+	while (*p && *p < mirror)
+		p = &(*p)->m_next;
+	mirror->m_next = *p;
+	*p = mirror;
+	if (!mirror->m_next)
+		t->m_wheel_tail[i] = mirror;
+}
+
+static uint32_t PMLIN_tables_airtime_us(PMLIN_master_t *m, PMLIN_tables_t *t, uint8_t id, uint8_t message_type);
+
+// admission control, on success the tables get the mirroring and are ready to be swapped in
+static PMLIN_error_t PMLIN_admit_mirroring(PMLIN_master_t *m, PMLIN_tables_t *t, PMLIN_mirror_def_t mirroring[], uint32_t num_mirroring) {
+	// each entry needs its airtime once every m_tick_period ticks
+	uint64_t needed = 0; // bus time needed per 1000 ticks
+	for (uint32_t i = 0; i < num_mirroring; i++) {
+		PMLIN_mirror_def_t *mirror = &mirroring[i];
+		if (mirror->m_tick_phase < mirror->m_tick_period)
+			needed += 1000ULL * PMLIN_tables_airtime_us(m, t, mirror->m_device_id, mirror->m_message_type) / mirror->m_tick_period;
+	}
+	uint64_t predicted = m->m_tick_period_us ? needed / m->m_tick_period_us : 0;
+	if (predicted > UINT32_MAX)
+		predicted = UINT32_MAX;
+	if (m->m_utilization_limit_permille && predicted > m->m_utilization_limit_permille)
+		return PMLIN_OVERLOAD_ERROR;
+	t->m_predicted_permille = predicted;
+	t->m_mirroring = mirroring;
+	t->m_num_mirroring = num_mirroring;
+	t->m_generation++; // the tick schedules the entries anew, see PMLIN_adopt_tables
+	t->m_prepared = true;
+	if (m->m_utilization_warning_permille && predicted > m->m_utilization_warning_permille)
+		return PMLIN_UTILIZATION_WARNING;
+	return PMLIN_OK;
+}
+
+static void PMLIN_adopt_tables(PMLIN_master_t *m, PMLIN_tables_t *t, uint32_t now);
+
+PMLIN_error_t PMLIN_master_define_mirroring(PMLIN_master_t *m, PMLIN_mirror_def_t mirroring[], uint32_t num_mirroring) {
+	PMLIN_error_t res = PMLIN_admit_mirroring(m, &m->m_boot_tables, mirroring, num_mirroring);
+	if (res == PMLIN_OVERLOAD_ERROR)
+		return res;
+	// boot-time, so the entries can be scheduled right away instead of on the next tick
+	PMLIN_adopt_tables(m, &m->m_boot_tables, m->m_tick + 1);
+	atomic_store(&m->m_tables, &m->m_boot_tables);
+	return res;
+}
+
+PMLIN_error_t PMLIN_master_prepare_tables(PMLIN_master_t *m, PMLIN_tables_t *tables, PMLIN_device_decl_t devices[],
+		uint8_t num_devices, PMLIN_mirror_def_t mirroring[], uint32_t num_mirroring) {
+	tables->m_prepared = false;
+	PMLIN_set_devices(tables, devices, num_devices);
+	return PMLIN_admit_mirroring(m, tables, mirroring, num_mirroring);
+}
+
+PMLIN_tables_t* PMLIN_master_swap_tables(PMLIN_master_t *m, PMLIN_tables_t *tables) {
+	if (!tables->m_prepared)
+		return NULL;
+	tables->m_prepared = false; // the wheel is only valid from one swap on
+	return atomic_exchange(&m->m_tables, tables);
+}
+
+bool PMLIN_master_tables_in_use(PMLIN_master_t *m, PMLIN_tables_t *tables) {
+	// a tick pins its tables before it checks that they are still swapped in, see PMLIN_enter_tick,
+	// so once swapped out the tables are seen here until the last tick using them is over
+	return atomic_load(&m->m_tables) == tables || atomic_load(&m->m_tick_tables) == tables
+			|| atomic_load(&m->m_call_tables) == tables;
+}
+
+// pins the tables swapped in by storing them in pin until the pin is cleared
+static PMLIN_tables_t* PMLIN_pin(PMLIN_master_t *m, _Atomic(PMLIN_tables_t*) *pin) {
+	PMLIN_tables_t *t = atomic_load(&m->m_tables);
+	for (;;) {
+		atomic_store(pin, t);
+		PMLIN_tables_t *swapped = atomic_load(&m->m_tables);
+		if (swapped == t)
+			return t;
+		t = swapped; // swapped while pinning, the swapper may not have seen the pin
+	}
+}
+
+// pins the tables swapped in for the duration of a tick
+static PMLIN_tables_t* PMLIN_enter_tick(PMLIN_master_t *m) {
+	return PMLIN_pin(m, &m->m_tick_tables);
+}
+
+// pins the tables swapped in for a call other than the tick, must be called with the PMLIN mutex locked,
+// nested calls get the tables of the outermost one
+static PMLIN_tables_t* PMLIN_pin_tables(PMLIN_master_t *m) {
+	if (m->m_call_pins++ == 0)
+		return PMLIN_pin(m, &m->m_call_tables);
+	return atomic_load(&m->m_call_tables);
+}
+
+static void PMLIN_unpin_tables(PMLIN_master_t *m) {
+	if (--m->m_call_pins == 0)
+		atomic_store(&m->m_call_tables, NULL);
+}
+
+// schedules the entries of tables swapped in (or defined) since the previous tick, the first transfer of
+// an entry is due m_tick_period - m_tick_phase ticks after the swap
+static void PMLIN_adopt_tables(PMLIN_master_t *m, PMLIN_tables_t *t, uint32_t now) {
+	PMLIN_mirror_def_t *first = t->m_mirroring;
+	PMLIN_mirror_def_t *end = first + t->m_num_mirroring;
+	LOCK_MUTEX(m);
+	// keep only the immediate transfer requests of the entries in the new tables
+	PMLIN_mirror_def_t **link = &m->m_send_now_head;
+	PMLIN_mirror_def_t *prev = NULL;
+	while (*link) {
+		PMLIN_mirror_def_t *mirror = *link;
+		if (mirror >= first && mirror < end) {
+			prev = mirror;
+			link = &mirror->m_send_now_next;
+			continue;
 		}
-		if (rn != n)
-			printf("len!");
-		else if (crc)
-			printf("crc!");
-		else
-			printf("ok");
-		printf("\n");
+		*link = mirror->m_send_now_next;
+		mirror->m_send_now = false;
 	}
+	m->m_send_now_tail = prev;
+	UNLOCK_MUTEX(m);
+	memset(t->m_wheel, 0, sizeof(t->m_wheel));
+	for (PMLIN_mirror_def_t *mirror = first; mirror < end; mirror++) {
+		mirror->m_sent = false;
+		mirror->m_received = false;
+		mirror->m_send_now_done = false;
+		mirror->m_result = PMLIN_OK;
+		mirror->m_changed = false;
+		if (mirror->m_tick_phase >= mirror->m_tick_period)
+			continue; // never due
+		mirror->m_due = now - 1 + mirror->m_tick_period - mirror->m_tick_phase;
+		PMLIN_schedule_mirror(m, t, mirror);
+	}
+	m->m_scheduled_tables = t;
+	m->m_scheduled_generation = t->m_generation;
+}
 
-	memcpy((void* )data, (void* )&buffer[BREAK_LEN + PMLIN_HEADER_LEN], len);
-	if (sn + 1 == n)
-		return PMLIN_NO_RESP_ERROR;
-	else if (rn != n)
-		return PMLIN_TIMEOUT_ERROR;
-	else if (crc)
-		return PMLIN_CRC_ERROR;
-	else
+// FNV-1a, only used to detect changed mirroring buffers
+static uint32_t PMLIN_hash_buffer(volatile uint8_t *buffer, uint16_t length) {
+	uint32_t hash = 2166136261u;
+	for (uint16_t i = 0; i < length; i++)
+		hash = (hash ^ buffer[i]) * 16777619u;
+	return hash;
+}
+
+// sends a PMLIN_HOST_TO_SLAVE mirroring entry unless it is unchanged and the keepalive has not expired
+static PMLIN_error_t PMLIN_send_mirror(PMLIN_master_t *m, PMLIN_mirror_def_t *mirror, volatile uint8_t *data,
+		uint16_t length, uint32_t now, bool force) {
+	if (!m->m_keepalive_ticks)
+		return PMLIN_master_send_message(m, mirror->m_device_id, mirror->m_message_type, length, data);
+	// hash before sending, a change during the send then only causes an extra send on the next turn
+	uint32_t hash = PMLIN_hash_buffer(data, length);
+	if (!force && mirror->m_sent && mirror->m_sent_hash == hash && now - mirror->m_sent_tick < m->m_keepalive_ticks) {
+		LOCK_MUTEX(m);
+		m->m_mirror_skipped++;
+		UNLOCK_MUTEX(m);
 		return PMLIN_OK;
+	}
+	PMLIN_error_t res = PMLIN_master_send_message(m, mirror->m_device_id, mirror->m_message_type, length, data);
+	mirror->m_sent = res == PMLIN_OK;
+	mirror->m_sent_hash = hash;
+	mirror->m_sent_tick = now;
+	return res;
 }
 
-void PMLIN_define_devices(PMLIN_device_decl_t devices[], uint8_t num_devices) {
-	for (uint8_t i = 0; i < PMLIN_MAX_NUM_ID; i++)
-		g_PMLIN_id_to_device[i] = NULL;
-	for (uint8_t i = 0; i < num_devices; i++) {
-		g_PMLIN_id_to_device[devices[i].m_id] = &devices[i];
+// updates the health of a device after a mirroring transfer, puts it in or takes it out of quarantine
+static void PMLIN_update_health(PMLIN_master_t *m, PMLIN_device_health_t *h, PMLIN_error_t res, uint32_t now) {
+	LOCK_MUTEX(m);
+	h->m_last_result = res;
+	if (res == PMLIN_OK) {
+		h->m_failures = 0;
+		h->m_quarantined = false;
+	} else if (h->m_quarantined) { // failed probe
+		h->m_backoff_ticks = 2 * h->m_backoff_ticks < m->m_max_backoff_ticks ? 2 * h->m_backoff_ticks : m->m_max_backoff_ticks;
+		h->m_probe_tick = now + h->m_backoff_ticks;
+	} else {
+		if (h->m_failures < UINT8_MAX)
+			h->m_failures++;
+		if (m->m_quarantine_failures && h->m_failures >= m->m_quarantine_failures) {
+			h->m_quarantined = true;
+			h->m_quarantines++;
+			h->m_backoff_ticks = m->m_min_backoff_ticks ? m->m_min_backoff_ticks : 1;
+			h->m_probe_tick = now + h->m_backoff_ticks;
+		}
 	}
+	UNLOCK_MUTEX(m);
 }
 
-void PMLIN_define_mirroring(PMLIN_mirror_def_t mirroring[], uint8_t num_mirroring) {
-	g_PMLIN_mirroring = mirroring;
-	g_PMLIN_num_mirroring = num_mirroring;
+// adds a PMLIN_SLAVE_TO_HOST entry to the changed list if the payload it received differs from the previous one
+static void PMLIN_received_mirror(PMLIN_master_t *m, PMLIN_mirror_def_t *mirror, volatile uint8_t *data, uint16_t length) {
+	if (!m->m_changed_fp)
+		return;
+	uint32_t hash = PMLIN_hash_buffer(data, length);
+	if (mirror->m_received && mirror->m_received_hash == hash)
+		return;
+	mirror->m_received = true;
+	mirror->m_received_hash = hash;
+	if (mirror->m_changed)
+		return; // changed twice during the tick, notified once
+	mirror->m_changed = true;
+	mirror->m_changed_next = NULL;
+	if (m->m_changed_tail)
+		m->m_changed_tail->m_changed_next = mirror;
+	else
+		m->m_changed_head = mirror;
+	m->m_changed_tail = mirror;
 }
 
-PMLIN_error_t PMLIN_mirror_tick(uint8_t *device_id_ptr) {
-	for (uint8_t i = 0; i < g_PMLIN_num_mirroring; i++) {
-		PMLIN_mirror_def_t *m = &g_PMLIN_mirroring[i];
-		if (m->m_ticker)
-			m->m_ticker--;
-		else
-			m->m_ticker = m->m_tick_period - 1;
-		if (m->m_ticker == m->m_tick_phase) {
-			uint8_t id = m->m_device_id;
-			PMLIN_device_decl_t *d = g_PMLIN_id_to_device[id];
-			if (d) {
-				uint8_t mtype = m->m_message_type;
-				PMLIN_error_t res;
-				if (d->m_messages[mtype].m_message_dir == PMLIN_HOST_TO_SLAVE)
-					res = PMLIN_send_message(id, mtype, d->m_messages[mtype].m_message_length, m->m_buffer);
-				else
-					res = PMLIN_receive_message(id, mtype, d->m_messages[mtype].m_message_length, m->m_buffer);
-				if (res != PMLIN_OK) {
-					if (device_id_ptr)
-						*device_id_ptr = id;
-					return res;
-				}
+// calls the change notification callback for the entries changed during the tick
+static void PMLIN_notify_changed(PMLIN_master_t *m) {
+	PMLIN_mirror_def_t *mirror = m->m_changed_head;
+	if (!mirror)
+		return;
+	m->m_changed_head = NULL;
+	m->m_changed_tail = NULL;
+	PMLIN_mirror_changed_fp changed_fp = m->m_changed_fp;
+	while (mirror) {
+		PMLIN_mirror_def_t *next = mirror->m_changed_next;
+		mirror->m_changed = false;
+		if (changed_fp)
+			changed_fp(mirror, m->m_changed_user);
+		mirror = next;
+	}
+	if (changed_fp)
+		changed_fp(NULL, m->m_changed_user);
+}
+
+// receives a PMLIN_SLAVE_TO_HOST entry and adds the payload to its history, if any, with the time the frame completed
+static PMLIN_error_t PMLIN_receive_mirror(PMLIN_master_t *m, PMLIN_mirror_def_t *mirror, uint8_t len, volatile uint8_t *data) {
+	PMLIN_transaction_t t = PMLIN_RECEIVE_TRANSACTION(mirror->m_device_id & PMLIN_MSG_ID_MASK, mirror->m_message_type, len, data);
+	PMLIN_error_t res = PMLIN_master_run_transaction(m, &t);
+	if (res == PMLIN_OK && mirror->m_history)
+		PMLIN_sample_ring_push(mirror->m_history, PMLIN_sample_ring_time_ns(), data, len);
+	return res;
+}
+
+// exchanges a PMLIN_EXCHANGE entry, the response goes to the history and change notification like a received entry
+static PMLIN_error_t PMLIN_exchange_mirror(PMLIN_master_t *m, PMLIN_mirror_def_t *mirror, uint8_t len, volatile uint8_t *data,
+		uint8_t resp_len, volatile uint8_t *resp) {
+	PMLIN_transaction_t t = PMLIN_EXCHANGE_TRANSACTION(mirror->m_device_id & PMLIN_MSG_ID_MASK, mirror->m_message_type, len, data,
+			resp_len, resp);
+	PMLIN_error_t res = PMLIN_master_run_transaction(m, &t);
+	if (res == PMLIN_OK) {
+		if (mirror->m_history)
+			PMLIN_sample_ring_push(mirror->m_history, PMLIN_sample_ring_time_ns(), resp, resp_len);
+		PMLIN_received_mirror(m, mirror, resp, resp_len);
+	}
+	return res;
+}
+
+// transfers a mirroring entry in the direction its message is declared unless its device is in quarantine
+static PMLIN_error_t PMLIN_transfer_mirror(PMLIN_master_t *m, PMLIN_tables_t *t, PMLIN_mirror_def_t *mirror, uint32_t now, bool force) {
+	uint8_t id = mirror->m_device_id & PMLIN_MSG_ID_MASK;
+	PMLIN_device_decl_t *d = t->m_id_to_device[id];
+	if (!d)
+		return mirror->m_result = PMLIN_OK;
+	PMLIN_device_health_t *h = &m->m_health[id];
+	if (h->m_quarantined && (int32_t) (now - h->m_probe_tick) < 0)
+		return mirror->m_result = PMLIN_QUARANTINED_ERROR;
+	PMLIN_error_t res;
+	uint8_t mtype = mirror->m_message_type;
+	uint8_t len = d->m_messages[mtype].m_message_length;
+	uint8_t resp_len = d->m_messages[mtype].m_response_length;
+	if (mirror->m_snapshot) { // transfer a private copy, the application sees only complete snapshots
+		PMLIN_mirror_buffer_t *buffer = (PMLIN_mirror_buffer_t*) mirror->m_buffer;
+		uint8_t data[255];
+		if (d->m_messages[mtype].m_message_dir == PMLIN_EXCHANGE) {
+			uint8_t resp[255];
+			if (!PMLIN_mirror_buffer_try_read(buffer, data, len, PMLIN_MIRROR_BUFFER_RETRIES))
+				return mirror->m_result;
+			res = PMLIN_exchange_mirror(m, mirror, len, data, resp_len, resp);
+			if (res == PMLIN_OK)
+				PMLIN_mirror_buffer_write((PMLIN_mirror_buffer_t*) mirror->m_response, resp, resp_len);
+		} else if (d->m_messages[mtype].m_message_dir == PMLIN_HOST_TO_SLAVE) {
+			if (!PMLIN_mirror_buffer_try_read(buffer, data, len, PMLIN_MIRROR_BUFFER_RETRIES))
+				return mirror->m_result; // written all the time, try again on the next turn
+			res = PMLIN_send_mirror(m, mirror, data, len, now, force);
+		} else {
+			res = PMLIN_receive_mirror(m, mirror, len, data);
+			if (res == PMLIN_OK) {
+				PMLIN_mirror_buffer_write(buffer, data, len);
+				PMLIN_received_mirror(m, mirror, data, len);
 			}
 		}
+	} else if (d->m_messages[mtype].m_message_dir == PMLIN_EXCHANGE)
+		res = PMLIN_exchange_mirror(m, mirror, len, mirror->m_buffer, resp_len, mirror->m_response);
+	else if (d->m_messages[mtype].m_message_dir == PMLIN_HOST_TO_SLAVE)
+		res = PMLIN_send_mirror(m, mirror, mirror->m_buffer, len, now, force);
+	else {
+		res = PMLIN_receive_mirror(m, mirror, len, mirror->m_buffer);
+		if (res == PMLIN_OK)
+			PMLIN_received_mirror(m, mirror, mirror->m_buffer, len);
 	}
-	return PMLIN_OK;
+	PMLIN_update_health(m, h, res, now);
+	return mirror->m_result = res;
 }
 
-PMLIN_error_t PMLIN_renum_id(uint8_t old_id, uint8_t new_id) {
+// makes the immediate transfers allowed by the rate limits, the entries over the limits are kept for a later tick
+static PMLIN_error_t PMLIN_send_now_tick(PMLIN_master_t *m, PMLIN_tables_t *t, uint32_t now, uint8_t *device_id_ptr) {
+	PMLIN_error_t first_res = PMLIN_OK;
+	uint32_t count = 0;
+	LOCK_MUTEX(m);
+	PMLIN_mirror_def_t **link = &m->m_send_now_head;
+	PMLIN_mirror_def_t *prev = NULL;
+	while (*link && count < m->m_send_now_per_tick) {
+		PMLIN_mirror_def_t *mirror = *link;
+		if (mirror->m_send_now_done && now - mirror->m_send_now_tick < m->m_send_now_interval) {
+			prev = mirror;
+			link = &mirror->m_send_now_next;
+			continue;
+		}
+		*link = mirror->m_send_now_next;
+		if (m->m_send_now_tail == mirror)
+			m->m_send_now_tail = prev;
+		mirror->m_send_now = false;
+		mirror->m_send_now_done = true;
+		mirror->m_send_now_tick = now;
+		count++;
+		// release the list while on the bus, appends only touch the tail so link stays valid
+		UNLOCK_MUTEX(m);
+		PMLIN_error_t res = PMLIN_transfer_mirror(m, t, mirror, now, true);
+		LOCK_MUTEX(m);
+		if (res != PMLIN_OK && res != PMLIN_QUARANTINED_ERROR && first_res == PMLIN_OK) {
+			first_res = res;
+			if (device_id_ptr)
+				*device_id_ptr = mirror->m_device_id;
+		}
+	}
+	UNLOCK_MUTEX(m);
+	return first_res;
+}
+
+PMLIN_error_t PMLIN_master_mirror_tick(PMLIN_master_t *m, uint8_t *device_id_ptr) {
+	uint32_t now = ++m->m_tick;
+	PMLIN_tables_t *t = PMLIN_enter_tick(m);
+	if (t != m->m_scheduled_tables || t->m_generation != m->m_scheduled_generation)
+		PMLIN_adopt_tables(m, t, now);
+	else if ((now & WHEEL_MASK) == 0) { // a new wheel turn, bring in the entries due during it
+		PMLIN_mirror_def_t **slot = &t->m_wheel[1][(now >> PMLIN_MIRROR_WHEEL_BITS) & WHEEL_MASK];
+		PMLIN_mirror_def_t *mirror = *slot;
+		*slot = NULL;
+		while (mirror) {
+			PMLIN_mirror_def_t *next = mirror->m_next;
+			PMLIN_schedule_mirror(m, t, mirror);
+			mirror = next;
+		}
+	}
+	// the immediate transfers go first, a failure anywhere does not stop the other transfers
+	PMLIN_error_t first_res = PMLIN_send_now_tick(m, t, now, device_id_ptr);
+	PMLIN_mirror_def_t **slot = &t->m_wheel[0][now & WHEEL_MASK];
+	PMLIN_mirror_def_t *mirror = *slot;
+	*slot = NULL;
+	while (mirror) {
+		PMLIN_mirror_def_t *next = mirror->m_next;
+		PMLIN_error_t res = PMLIN_transfer_mirror(m, t, mirror, now, false);
+		mirror->m_due += mirror->m_tick_period;
+		PMLIN_schedule_mirror(m, t, mirror);
+		if (res != PMLIN_OK && res != PMLIN_QUARANTINED_ERROR && first_res == PMLIN_OK) {
+			first_res = res;
+			if (device_id_ptr)
+				*device_id_ptr = mirror->m_device_id;
+		}
+		mirror = next;
+	}
+	PMLIN_notify_changed(m);
+	atomic_store(&m->m_tick_tables, NULL);
+	return first_res;
+}
+
+void PMLIN_master_set_tick_period_us(PMLIN_master_t *m, uint32_t tick_period_us) {
+	m->m_tick_period_us = tick_period_us;
+}
+
+void PMLIN_master_set_mirror_keepalive(PMLIN_master_t *m, uint32_t keepalive_ticks) {
+	m->m_keepalive_ticks = keepalive_ticks;
+}
+
+void PMLIN_master_mirror_send_now(PMLIN_master_t *m, PMLIN_mirror_def_t *mirror) {
+	LOCK_MUTEX(m);
+	if (!mirror->m_send_now) {
+		mirror->m_send_now = true;
+		mirror->m_send_now_next = NULL;
+		if (m->m_send_now_tail)
+			m->m_send_now_tail->m_send_now_next = mirror;
+		else
+			m->m_send_now_head = mirror;
+		m->m_send_now_tail = mirror;
+	}
+	UNLOCK_MUTEX(m);
+}
+
+void PMLIN_master_set_send_now_limits(PMLIN_master_t *m, uint32_t min_interval_ticks, uint32_t max_per_tick) {
+	m->m_send_now_interval = min_interval_ticks;
+	m->m_send_now_per_tick = max_per_tick;
+}
+
+void PMLIN_master_set_mirror_changed_callback(PMLIN_master_t *m, PMLIN_mirror_changed_fp changed_fp, void *user) {
+	m->m_changed_fp = changed_fp;
+	m->m_changed_user = user;
+}
+
+void PMLIN_master_set_quarantine(PMLIN_master_t *m, uint8_t failures, uint32_t min_backoff_ticks, uint32_t max_backoff_ticks) {
+	LOCK_MUTEX(m);
+	m->m_quarantine_failures = failures;
+	m->m_min_backoff_ticks = min_backoff_ticks;
+	m->m_max_backoff_ticks = max_backoff_ticks;
+	if (!failures) // quarantine turned off, release all devices
+		for (uint8_t i = 0; i < PMLIN_MAX_NUM_ID; i++)
+			m->m_health[i].m_quarantined = false;
+	UNLOCK_MUTEX(m);
+}
+
+void PMLIN_master_get_device_health(PMLIN_master_t *m, uint8_t id, PMLIN_device_health_t *health) {
+	LOCK_MUTEX(m);
+	*health = m->m_health[id & PMLIN_MSG_ID_MASK];
+	UNLOCK_MUTEX(m);
+}
+
+uint32_t PMLIN_frame_airtime_us(uint8_t message_type, uint8_t message_dir, uint8_t message_length, uint32_t turnaround_us) {
+	uint16_t chars = 2; // header and header CRC
+	if (message_type == PMLIN_MESSAGE_TYPE_CMD)
+		chars += PMLIN_CMD_MSG_LEN + CRC_LEN + PMLIN_CMD_RESP_LEN + CRC_LEN;
+	else if (message_dir == PMLIN_HOST_TO_SLAVE)
+		chars += message_length + CRC_LEN + ACK_LEN;
+	else
+		chars += message_length + CRC_LEN;
+	return PMLIN_BREAK_AIRTIME_US + chars * PMLIN_CHAR_TIME_US + turnaround_us;
+}
+
+uint32_t PMLIN_exchange_airtime_us(uint8_t request_length, uint8_t response_length, uint32_t turnaround_us) {
+	uint16_t chars = 2 + request_length + CRC_LEN + response_length + CRC_LEN;
+	return PMLIN_BREAK_AIRTIME_US + chars * PMLIN_CHAR_TIME_US + turnaround_us;
+}
+
+static uint32_t PMLIN_tables_airtime_us(PMLIN_master_t *m, PMLIN_tables_t *t, uint8_t id, uint8_t message_type) {
+	PMLIN_device_decl_t *d = t->m_id_to_device[id & PMLIN_MSG_ID_MASK];
+	if (!d || message_type >= PMLIN_MAX_MESSAGE_TYPES)
+		return 0;
+	PMLIN_message_def_t *msg = &d->m_messages[message_type];
+	if (message_type != PMLIN_MESSAGE_TYPE_CMD && msg->m_message_length == 0)
+		return 0;
+	// an unlearned slack is a guess for the timeouts, the minimum is a better estimate here
+	uint32_t slack = m->m_response_slack_us[id & PMLIN_MSG_ID_MASK];
+	if (message_type != PMLIN_MESSAGE_TYPE_CMD && msg->m_message_dir == PMLIN_EXCHANGE)
+		return PMLIN_exchange_airtime_us(msg->m_message_length, msg->m_response_length, slack ? slack : m->m_min_slack_us);
+	return PMLIN_frame_airtime_us(message_type, msg->m_message_dir, msg->m_message_length, slack ? slack : m->m_min_slack_us);
+}
+
+uint32_t PMLIN_master_message_airtime_us(PMLIN_master_t *m, uint8_t id, uint8_t message_type) {
+	LOCK_MUTEX(m);
+	uint32_t airtime = PMLIN_tables_airtime_us(m, PMLIN_pin_tables(m), id, message_type);
+	PMLIN_unpin_tables(m);
+	UNLOCK_MUTEX(m);
+	return airtime;
+}
+
+void PMLIN_master_set_utilization_limits(PMLIN_master_t *m, uint32_t warning_permille, uint32_t limit_permille) {
+	m->m_utilization_warning_permille = warning_permille;
+	m->m_utilization_limit_permille = limit_permille;
+}
+
+void PMLIN_master_get_utilization(PMLIN_master_t *m, PMLIN_utilization_t *utilization, bool reset) {
+	LOCK_MUTEX(m);
+	utilization->m_predicted_permille = PMLIN_pin_tables(m)->m_predicted_permille;
+	PMLIN_unpin_tables(m);
+	utilization->m_busy_us = m->m_busy_us;
+	utilization->m_elapsed_us = m->m_elapsed_us;
+	utilization->m_frames = m->m_frames;
+	utilization->m_mirror_skipped = m->m_mirror_skipped;
+	utilization->m_actual_permille = m->m_elapsed_us ? 1000 * m->m_busy_us / m->m_elapsed_us : 0;
+	if (reset) {
+		m->m_measuring = false;
+		m->m_busy_us = 0;
+		m->m_elapsed_us = 0;
+		m->m_frames = 0;
+		m->m_mirror_skipped = 0;
+	}
+	UNLOCK_MUTEX(m);
+}
+
+PMLIN_error_t PMLIN_master_renum_id(PMLIN_master_t *m, uint8_t old_id, uint8_t new_id) {
 	uint16_t retry = 1000;
 	PMLIN_error_t res = PMLIN_OK;
 	while (retry) {
@@ -326,7 +1163,7 @@ PMLIN_error_t PMLIN_renum_id(uint8_t old_id, uint8_t new_id) {
 		uint8_t cmd_resp[PMLIN_CMD_MSG_LEN] = { 0 };
 		cmd_msg[PMLIN_CMD_MSG_CMD_IDX] = PMLIN_CMD_MSG_CMD_RENUM;
 		cmd_msg[PMLIN_CMD_MSG_RENUM_ID_IDX] = new_id;
-		res = PMLIN_send_cmd_message(old_id, cmd_msg, cmd_resp);
+		res = PMLIN_master_send_cmd_message(m, old_id, cmd_msg, cmd_resp);
 		if (res == PMLIN_OK) {
 			break;
 		}
@@ -335,41 +1172,42 @@ PMLIN_error_t PMLIN_renum_id(uint8_t old_id, uint8_t new_id) {
 	return res;
 }
 
-static PMLIN_error_t PMLIN_check_config_internal(uint8_t *device_id_ptr) {
+static PMLIN_error_t PMLIN_check_config_internal(PMLIN_master_t *m, PMLIN_tables_t *tables, uint8_t *device_id_ptr) {
 	for (uint8_t id = PMLIN_FIRST_DEVICE_ID; id < PMLIN_MAX_NUM_ID; id++) {
 		if (id == PMLIN_RESERVED_ID)
 			continue;
-		if (!g_PMLIN_id_to_device[id])
+		if (!tables->m_id_to_device[id])
 			continue;
 		if (device_id_ptr)
 			*device_id_ptr = id;
 		uint8_t cmd_msg[PMLIN_CMD_MSG_LEN] = { 0 };
 		uint8_t cmd_resp[PMLIN_CMD_MSG_LEN] = { 0 };
 		cmd_msg[PMLIN_CMD_MSG_CMD_IDX] = PMLIN_CMD_MSG_CMD_PROBE;
-		PMLIN_error_t res = PMLIN_send_cmd_message(id, cmd_msg, cmd_resp);
+		PMLIN_error_t res = PMLIN_master_send_cmd_message(m, id, cmd_msg, cmd_resp);
 		if (res != PMLIN_OK)
 			return res;
 
 		cmd_msg[PMLIN_CMD_MSG_CMD_IDX] = PMLIN_CMD_MSG_CMD_INQUIRE;
-		res = PMLIN_send_cmd_message(id, cmd_msg, cmd_resp);
+		res = PMLIN_master_send_cmd_message(m, id, cmd_msg, cmd_resp);
 		if (res != PMLIN_OK)
 			return res;
 		uint16_t type = (cmd_resp[PMLIN_CMD_RESP_DEV_TYPE_MSB_IDX] << 8) | cmd_resp[PMLIN_CMD_RESP_DEV_TYPE_LSB_IDX];
-		if (type != g_PMLIN_id_to_device[id]->m_device_type)
+		if (type != tables->m_id_to_device[id]->m_device_type)
 			return PMLIN_TYPE_CONFLICT_ERROR;
 
 	}
 	return PMLIN_OK;
 }
 
-PMLIN_error_t PMLIN_check_config(uint8_t *device_id_ptr) {
-	LOCK_MUTEX();
-	PMLIN_error_t res = PMLIN_check_config_internal(device_id_ptr);
-	UNLOCK_MUTEX();
+PMLIN_error_t PMLIN_master_check_config(PMLIN_master_t *m, uint8_t *device_id_ptr) {
+	LOCK_MUTEX(m);
+	PMLIN_error_t res = PMLIN_check_config_internal(m, PMLIN_pin_tables(m), device_id_ptr);
+	PMLIN_unpin_tables(m);
+	UNLOCK_MUTEX(m);
 	return res;
 }
 
-static PMLIN_error_t PMLIN_auto_config_internal(PMLIN_error_t renum[]) {
+static PMLIN_error_t PMLIN_auto_config_internal(PMLIN_master_t *m, PMLIN_tables_t *tables, PMLIN_error_t renum[]) {
 	ACD_PRINT("PMLIN_autoconfig starting...\n");
 
 	PMLIN_error_t ret = PMLIN_OK;
@@ -398,12 +1236,12 @@ static PMLIN_error_t PMLIN_auto_config_internal(PMLIN_error_t renum[]) {
 			ACD_PRINT(" probe device id = %d ", id);
 
 			cmd_msg[PMLIN_CMD_MSG_CMD_IDX] = PMLIN_CMD_MSG_CMD_PROBE;
-			resp[id] = PMLIN_send_cmd_message(id, cmd_msg, cmd_resp);
+			resp[id] = PMLIN_master_send_cmd_message(m, id, cmd_msg, cmd_resp);
 			ACD_PRINT(",  send CMD_ENUM res: %s ", PMLIN_result_to_string(resp[id]));
 
 			if (PMLIN_OK == resp[id]) {
 				cmd_msg[PMLIN_CMD_MSG_CMD_IDX] = PMLIN_CMD_MSG_CMD_INQUIRE;
-				PMLIN_error_t res = PMLIN_send_cmd_message(id, cmd_msg, cmd_resp);
+				PMLIN_error_t res = PMLIN_master_send_cmd_message(m, id, cmd_msg, cmd_resp);
 				ACD_PRINT(",  send CMD_INQUIRY, res: %s", PMLIN_result_to_string(res));
 
 				if (PMLIN_OK == res) {
@@ -455,7 +1293,7 @@ static PMLIN_error_t PMLIN_auto_config_internal(PMLIN_error_t renum[]) {
 		} else {
 			ACD_PRINT("try to renumber id %d to id %d\n", cnflct_id, free_id);
 
-			PMLIN_error_t res = PMLIN_renum_id(cnflct_id, free_id);
+			PMLIN_error_t res = PMLIN_master_renum_id(m, cnflct_id, free_id);
 			if (res != PMLIN_OK)
 				return res;
 
@@ -481,7 +1319,7 @@ static PMLIN_error_t PMLIN_auto_config_internal(PMLIN_error_t renum[]) {
 	for (uint8_t id = PMLIN_FIRST_DEVICE_ID; id < PMLIN_MAX_NUM_ID; id++) {
 		if (id == PMLIN_RESERVED_ID)
 			continue;
-		PMLIN_device_decl_t *dev = g_PMLIN_id_to_device[id];
+		PMLIN_device_decl_t *dev = tables->m_id_to_device[id];
 		if (dev != NULL && resp[id] == PMLIN_NO_RESP_ERROR)
 			missing = id;
 		if (dev == NULL && resp[id] == PMLIN_OK)
@@ -489,7 +1327,7 @@ static PMLIN_error_t PMLIN_auto_config_internal(PMLIN_error_t renum[]) {
 		if (extra != 0 && missing != 0) {
 			ACD_PRINT("try to renumber id %d to id %d\n", extra, missing);
 
-			PMLIN_error_t res = PMLIN_renum_id(extra, missing);
+			PMLIN_error_t res = PMLIN_master_renum_id(m, extra, missing);
 			if (res != PMLIN_OK)
 				return res;
 
@@ -518,8 +1356,8 @@ static PMLIN_error_t PMLIN_auto_config_internal(PMLIN_error_t renum[]) {
 	for (uint8_t id = PMLIN_FIRST_DEVICE_ID; id < PMLIN_MAX_NUM_ID; id++) {
 		if (id == PMLIN_RESERVED_ID)
 			continue;
-		if (PMLIN_OK == resp[id] && g_PMLIN_id_to_device[id]->m_device_type != type[id]) {
-			ACD_PRINT(" type conflict %d was %d should have been %d\n", id, type[id], g_PMLIN_id_to_device[id]->m_device_type);
+		if (PMLIN_OK == resp[id] && tables->m_id_to_device[id]->m_device_type != type[id]) {
+			ACD_PRINT(" type conflict %d was %d should have been %d\n", id, type[id], tables->m_id_to_device[id]->m_device_type);
 
 			cnflct_id_1 = id;
 			break;
@@ -530,11 +1368,11 @@ static PMLIN_error_t PMLIN_auto_config_internal(PMLIN_error_t renum[]) {
 		ret = PMLIN_TYPE_CONFLICT_WARNING;
 		// check if there is an other conflicting device of the same type so we could swap that to fix this
 		uint8_t cnflct_id_2 = 0;
-		uint16_t cnflct_id_1_type = g_PMLIN_id_to_device[cnflct_id_1]->m_device_type;
+		uint16_t cnflct_id_1_type = tables->m_id_to_device[cnflct_id_1]->m_device_type;
 		for (uint8_t id = cnflct_id_1 + 1; id < PMLIN_RESERVED_ID; id++) {
 			if (type[id] == cnflct_id_1_type) { // so we found a device that potentially could resolve this
 				// if not in range or if it self is conflicting then we can use it
-				if (type[id] != g_PMLIN_id_to_device[id]->m_device_type) {
+				if (type[id] != tables->m_id_to_device[id]->m_device_type) {
 					cnflct_id_2 = id;
 					break;
 				}
@@ -550,19 +1388,25 @@ static PMLIN_error_t PMLIN_auto_config_internal(PMLIN_error_t renum[]) {
 
 		ACD_PRINT(" swap id %d and id %d\n", cnflct_id_1, cnflct_id_2);
 
-		// swap the conflicting ids
-		uint8_t temp_id = 0;
-		ACD_PRINT(" renum id %d => id %d\n", cnflct_id_1, temp_id);
+		// swap the conflicting ids through an id nobody answers to, the broadcast id cannot be used for that
+		uint8_t temp_id = PMLIN_RESERVED_ID;
+		for (uint8_t id = PMLIN_FIRST_DEVICE_ID; id < PMLIN_RESERVED_ID; id++) {
+			if (PMLIN_NO_RESP_ERROR == resp[id]) {
+				temp_id = id;
+				break;
+			}
+		}
+		ACD_PRINT(" renum id %d => id %d\n", cnflct_id_2, temp_id);
 
-		PMLIN_error_t res = PMLIN_renum_id(cnflct_id_2, temp_id);
+		PMLIN_error_t res = PMLIN_master_renum_id(m, cnflct_id_2, temp_id);
 
 		ACD_PRINT(" renum id %d => id %d\n", cnflct_id_1, cnflct_id_2);
 
-		res = res == PMLIN_OK ? PMLIN_renum_id(cnflct_id_1, cnflct_id_2) : res;
+		res = res == PMLIN_OK ? PMLIN_master_renum_id(m, cnflct_id_1, cnflct_id_2) : res;
 
-		ACD_PRINT(" renum id %d and id %d\n", cnflct_id_1, cnflct_id_2);
+		ACD_PRINT(" renum id %d => id %d\n", temp_id, cnflct_id_1);
 
-		res = res == PMLIN_OK ? PMLIN_renum_id(temp_id, cnflct_id_1) : res;
+		res = res == PMLIN_OK ? PMLIN_master_renum_id(m, temp_id, cnflct_id_1) : res;
 		if (res != PMLIN_OK)
 			return res;
 
@@ -578,17 +1422,20 @@ static PMLIN_error_t PMLIN_auto_config_internal(PMLIN_error_t renum[]) {
 	return ret;
 }
 
-PMLIN_error_t PMLIN_auto_config(PMLIN_error_t renum[]) {
-	LOCK_MUTEX();
-	PMLIN_error_t res = PMLIN_auto_config_internal(renum);
-	UNLOCK_MUTEX();
+PMLIN_error_t PMLIN_master_auto_config(PMLIN_master_t *m, PMLIN_error_t renum[]) {
+	LOCK_MUTEX(m);
+	PMLIN_error_t res = PMLIN_auto_config_internal(m, PMLIN_pin_tables(m), renum);
+	PMLIN_unpin_tables(m);
+	UNLOCK_MUTEX(m);
 	return res;
 }
 
-void PMLIN_print_out_devices() {
+void PMLIN_master_print_out_devices(PMLIN_master_t *m) {
 	printf("PMLIN_print_out_devices\n");
-	for (uint8_t i = 0; i <= PMLIN_MAX_NUM_ID; i++) {
-		PMLIN_device_decl_t *p = g_PMLIN_id_to_device[i];
+	LOCK_MUTEX(m);
+	PMLIN_tables_t *tables = PMLIN_pin_tables(m);
+	for (uint8_t i = 0; i < PMLIN_MAX_NUM_ID; i++) {
+		PMLIN_device_decl_t *p = tables->m_id_to_device[i];
 		if (!p)
 			continue;
 		printf("g_PMLIN_devices[%d]->m_device_type = %d\n", i, p->m_device_type);
@@ -597,20 +1444,173 @@ void PMLIN_print_out_devices() {
 				printf("g_PMLIN_devices[%d]->m_messages[%d]\n", i, j);
 				printf("	.m_message_dir    = %d\n", p->m_messages[j].m_message_dir);
 				printf("	.m_message_length = %d\n", p->m_messages[j].m_message_length);
+				if (p->m_messages[j].m_message_dir == PMLIN_EXCHANGE)
+					printf("	.m_response_length = %d\n", p->m_messages[j].m_response_length);
+				printf("	airtime           = %d usec\n", PMLIN_master_message_airtime_us(m, i, j));
 			}
 		}
 	}
 
-	for (uint8_t i = 0; i < g_PMLIN_num_mirroring; i++) {
-		PMLIN_mirror_def_t *p = &g_PMLIN_mirroring[i];
-		printf("g_PMLIN_mirroring[%d]\n", i);
+	for (uint32_t i = 0; i < tables->m_num_mirroring; i++) {
+		PMLIN_mirror_def_t *p = &tables->m_mirroring[i];
+		printf("g_PMLIN_mirroring[%u]\n", i);
 		printf("	.m_device_id    = %d\n", p->m_device_id);
 		printf("	.m_message_type = %d\n", p->m_message_type);
 		printf("	.m_tick_period  = %d\n", p->m_tick_period);
 		printf("	.m_tick_phase   = %d\n", p->m_tick_phase);
-		printf("	.m_ticker       = %d\n", p->m_ticker);
+		printf("	.m_due          = %u\n", p->m_due);
 	}
+	PMLIN_unpin_tables(m);
+	UNLOCK_MUTEX(m);
+}
+
+// the functions that do not take a PMLIN_master_t operate on the default instance
+
+void PMLIN_set_debug_trafic(bool debug_traffic) {
+	PMLIN_master_set_debug_trafic(&g_PMLIN_default_master, debug_traffic);
+}
+
+void PMLIN_initialize_nonblocking(int poll_fd, PMLIN_time_us_fp time_fp) {
+	PMLIN_master_initialize_nonblocking(&g_PMLIN_default_master, poll_fd, time_fp);
+}
+
+int PMLIN_get_poll_fd() {
+	return PMLIN_master_get_poll_fd(&g_PMLIN_default_master);
+}
+
+void PMLIN_set_timeouts(uint32_t min_slack_us, uint32_t gap_us) {
+	PMLIN_master_set_timeouts(&g_PMLIN_default_master, min_slack_us, gap_us);
+}
+
+uint32_t PMLIN_get_response_slack(uint8_t id) {
+	return PMLIN_master_get_response_slack(&g_PMLIN_default_master, id);
+}
+
+PMLIN_error_t PMLIN_send_message(uint8_t id, uint8_t type, uint8_t len, volatile uint8_t *data) {
+	return PMLIN_master_send_message(&g_PMLIN_default_master, id, type, len, data);
+}
+
+PMLIN_error_t PMLIN_send_cmd_message(uint8_t id, volatile uint8_t *data, volatile uint8_t *resp) {
+	return PMLIN_master_send_cmd_message(&g_PMLIN_default_master, id, data, resp);
+}
+
+PMLIN_error_t PMLIN_send_group(uint8_t type, uint32_t mask, uint8_t slice_len, volatile uint8_t *slices) {
+	return PMLIN_master_send_group(&g_PMLIN_default_master, type, mask, slice_len, slices);
+}
+
+PMLIN_error_t PMLIN_exchange_message(uint8_t id, uint8_t type, uint8_t len, volatile uint8_t *data, uint8_t resp_len,
+		volatile uint8_t *resp) {
+	return PMLIN_master_exchange_message(&g_PMLIN_default_master, id, type, len, data, resp_len, resp);
+}
+
+PMLIN_error_t PMLIN_poll_messages(uint8_t type, uint8_t first_id, uint8_t last_id, uint8_t len, volatile uint8_t *data,
+		PMLIN_error_t results[]) {
+	return PMLIN_master_poll_messages(&g_PMLIN_default_master, type, first_id, last_id, len, data, results);
+}
+
+void PMLIN_set_poll_guard_us(uint32_t guard_us) {
+	PMLIN_master_set_poll_guard_us(&g_PMLIN_default_master, guard_us);
+}
+
+PMLIN_error_t PMLIN_send_trigger(uint32_t mask) {
+	return PMLIN_master_send_trigger(&g_PMLIN_default_master, mask);
+}
+
+PMLIN_error_t PMLIN_receive_message(uint8_t id, uint8_t type, uint8_t len, volatile uint8_t *data) {
+	return PMLIN_master_receive_message(&g_PMLIN_default_master, id, type, len, data);
+}
+
+PMLIN_error_t PMLIN_run_transaction(PMLIN_transaction_t *t) {
+	return PMLIN_master_run_transaction(&g_PMLIN_default_master, t);
+}
+
+PMLIN_error_t PMLIN_transact_batch(PMLIN_transaction_t transactions[], uint16_t num_transactions) {
+	return PMLIN_master_transact_batch(&g_PMLIN_default_master, transactions, num_transactions);
+}
+
+PMLIN_error_t PMLIN_start_transaction(PMLIN_transaction_t *t) {
+	return PMLIN_master_start_transaction(&g_PMLIN_default_master, t);
+}
+
+void PMLIN_define_devices(PMLIN_device_decl_t devices[], uint8_t num_devices) {
+	PMLIN_master_define_devices(&g_PMLIN_default_master, devices, num_devices);
+}
 
+PMLIN_error_t PMLIN_define_mirroring(PMLIN_mirror_def_t mirroring[], uint32_t num_mirroring) {
+	return PMLIN_master_define_mirroring(&g_PMLIN_default_master, mirroring, num_mirroring);
+}
+
+PMLIN_error_t PMLIN_prepare_tables(PMLIN_tables_t *tables, PMLIN_device_decl_t devices[], uint8_t num_devices,
+		PMLIN_mirror_def_t mirroring[], uint32_t num_mirroring) {
+	return PMLIN_master_prepare_tables(&g_PMLIN_default_master, tables, devices, num_devices, mirroring, num_mirroring);
+}
+
+PMLIN_tables_t* PMLIN_swap_tables(PMLIN_tables_t *tables) {
+	return PMLIN_master_swap_tables(&g_PMLIN_default_master, tables);
+}
+
+bool PMLIN_tables_in_use(PMLIN_tables_t *tables) {
+	return PMLIN_master_tables_in_use(&g_PMLIN_default_master, tables);
+}
+
+PMLIN_error_t PMLIN_mirror_tick(uint8_t *device_id_ptr) {
+	return PMLIN_master_mirror_tick(&g_PMLIN_default_master, device_id_ptr);
+}
+
+void PMLIN_set_tick_period_us(uint32_t tick_period_us) {
+	PMLIN_master_set_tick_period_us(&g_PMLIN_default_master, tick_period_us);
+}
+
+void PMLIN_set_mirror_keepalive(uint32_t keepalive_ticks) {
+	PMLIN_master_set_mirror_keepalive(&g_PMLIN_default_master, keepalive_ticks);
+}
+
+void PMLIN_mirror_send_now(PMLIN_mirror_def_t *mirror) {
+	PMLIN_master_mirror_send_now(&g_PMLIN_default_master, mirror);
+}
+
+void PMLIN_set_send_now_limits(uint32_t min_interval_ticks, uint32_t max_per_tick) {
+	PMLIN_master_set_send_now_limits(&g_PMLIN_default_master, min_interval_ticks, max_per_tick);
+}
+
+void PMLIN_set_mirror_changed_callback(PMLIN_mirror_changed_fp changed_fp, void *user) {
+	PMLIN_master_set_mirror_changed_callback(&g_PMLIN_default_master, changed_fp, user);
+}
+
+void PMLIN_set_quarantine(uint8_t failures, uint32_t min_backoff_ticks, uint32_t max_backoff_ticks) {
+	PMLIN_master_set_quarantine(&g_PMLIN_default_master, failures, min_backoff_ticks, max_backoff_ticks);
+}
+
+void PMLIN_get_device_health(uint8_t id, PMLIN_device_health_t *health) {
+	PMLIN_master_get_device_health(&g_PMLIN_default_master, id, health);
+}
+
+uint32_t PMLIN_message_airtime_us(uint8_t id, uint8_t message_type) {
+	return PMLIN_master_message_airtime_us(&g_PMLIN_default_master, id, message_type);
+}
+
+void PMLIN_set_utilization_limits(uint32_t warning_permille, uint32_t limit_permille) {
+	PMLIN_master_set_utilization_limits(&g_PMLIN_default_master, warning_permille, limit_permille);
+}
+
+void PMLIN_get_utilization(PMLIN_utilization_t *utilization, bool reset) {
+	PMLIN_master_get_utilization(&g_PMLIN_default_master, utilization, reset);
+}
+
+PMLIN_error_t PMLIN_renum_id(uint8_t old_id, uint8_t new_id) {
+	return PMLIN_master_renum_id(&g_PMLIN_default_master, old_id, new_id);
+}
+
+PMLIN_error_t PMLIN_check_config(uint8_t *device_id_ptr) {
+	return PMLIN_master_check_config(&g_PMLIN_default_master, device_id_ptr);
+}
+
+PMLIN_error_t PMLIN_auto_config(PMLIN_error_t renum[]) {
+	return PMLIN_master_auto_config(&g_PMLIN_default_master, renum);
+}
+
+void PMLIN_print_out_devices() {
+	PMLIN_master_print_out_devices(&g_PMLIN_default_master);
 }
 
 char* PMLIN_result_to_string(PMLIN_error_t res) {
@@ -629,10 +1629,26 @@ char* PMLIN_result_to_string(PMLIN_error_t res) {
 		return "PMLIN_NO_FREE_ID_ERROR";
 	case PMLIN_TYPE_CONFLICT_ERROR:
 		return "PMLIN_TYPE_CONFLICT_ERROR";
+	case PMLIN_NO_INITIALIZED_ERROR:
+		return "PMLIN_NO_INITIALIZED_ERROR";
+	case PMLIN_QUEUE_FULL_ERROR:
+		return "PMLIN_QUEUE_FULL_ERROR";
+	case PMLIN_COLLISION_ERROR:
+		return "PMLIN_COLLISION_ERROR";
+	case PMLIN_OVERLOAD_ERROR:
+		return "PMLIN_OVERLOAD_ERROR";
+	case PMLIN_NO_MEMORY_ERROR:
+		return "PMLIN_NO_MEMORY_ERROR";
+	case PMLIN_QUARANTINED_ERROR:
+		return "PMLIN_QUARANTINED_ERROR";
+	case PMLIN_INVALID_ARGUMENT_ERROR:
+		return "PMLIN_INVALID_ARGUMENT_ERROR";
 	case PMLIN_TYPE_CONFLICT_WARNING:
 		return "PMLIN_TYPE_CONFLICT_WARNING";
 	case PMLIN_ID_RENUM_WARNING:
 		return "PMLIN_ID_RENUM_WARNING";
+	case PMLIN_UTILIZATION_WARNING:
+		return "PMLIN_UTILIZATION_WARNING";
 	default:
 		return "<UNKNOW ERRON RESULT CODE>";
 	}
@@ -36,6 +36,7 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include "pmlin.h"
 
 
@@ -51,22 +52,69 @@ typedef uint8_t PMLIN_error_t ; // return type from various functions aka error
 #define PMLIN_NO_FREE_ID_ERROR 5 // No free ID could be found when renumbering slaves in PMLIN_auto_config
 #define PMLIN_TYPE_CONFLICT_ERROR 6 // A slave responded with an unexpected type in PMLIN_check_config
 #define PMLIN_NO_INITIALIZED_ERROR 7 // PMLIN master library has not been initalized with PMLIN_initialize_master
+#define PMLIN_QUEUE_FULL_ERROR 8 // No free slot in the bus thread request queue in PMLIN_submit_request
+#define PMLIN_COLLISION_ERROR 9 // The echo of the master's own frame was corrupted, someone else was transmitting
+#define PMLIN_OVERLOAD_ERROR 10 // The mirroring transfers of a tick do not fit into the tick period, see PMLIN_compile_schedule
+#define PMLIN_NO_MEMORY_ERROR 11 // Memory allocation failed in PMLIN_compile_schedule
+#define PMLIN_QUARANTINED_ERROR 12 // The mirroring was not transferred because the device is in quarantine, see PMLIN_set_quarantine
+#define PMLIN_INVALID_ARGUMENT_ERROR 13 // An argument is out of range or the message does not fit in one frame, nothing was sent
 
 #define PMLIN_TYPE_CONFLICT_WARNING 128 // At least one slave had a conflicting type in PMLIN_auto_config
 #define PMLIN_ID_RENUM_WARNING 129  // At least one slave was given a new ID in PMLIN_auto_config
-
-#define PMLIN_TIMEOUT 1000000 // read message timeout value in micro seconds
+#define PMLIN_UTILIZATION_WARNING 130 // The mirroring was defined but needs more bus time than the warning limit in PMLIN_define_mirroring
+
+#define PMLIN_TIMEOUT 1000000 // maximum read message timeout value in micro seconds
+
+// The frame is read in two phases: first the echo of what the master sent, which is checked byte by byte,
+// and then the response, which must arrive within its airtime plus twice the response slack that
+// PMLIN learns for each device (requires a time source, see PMLIN_initialize_nonblocking).
+#define PMLIN_CHAR_BITS 11 // start bit, 8 data bits and two stop bits as sent by the master
+#define PMLIN_CHAR_TIME_US ((1000000UL * PMLIN_CHAR_BITS + PMLIN_BAUDRATE - 1) / PMLIN_BAUDRATE)
+#define PMLIN_INITIAL_RESPONSE_SLACK_US 10000 // response slack assumed for a device before it has responded
+#define PMLIN_MIN_RESPONSE_SLACK_US 2000 // default lower limit for the learned response slack
+#define PMLIN_GAP_TIMEOUT_US 20000 // default inter-byte timeout, i.e. how long a pause in the data is tolerated
+#define PMLIN_DEFAULT_POLL_GUARD_US 1500 // default idle time between the slots of a poll, see PMLIN_set_poll_guard_us
+#define PMLIN_RENUM_MAX_WAIT_US (64 * PMLIN_CHAR_TIME_US) // slaves wait a random time up to this before responding to RENUM
+#define PMLIN_DEFAULT_TICK_PERIOD_US 10000 // assumed time between PMLIN_mirror_tick calls, see PMLIN_set_tick_period_us
+#define PMLIN_BREAK_AIRTIME_US 650 // BREAK and the idle time after it as generated by the POSIX HAL
+#define PMLIN_UTILIZATION_WARNING_PERMILLE 800 // default bus utilization above which PMLIN_define_mirroring warns
+#define PMLIN_UTILIZATION_LIMIT_PERMILLE 1000 // default bus utilization above which PMLIN_define_mirroring refuses
+#define PMLIN_DEFAULT_SEND_NOW_INTERVAL 1 // default minimum ticks between immediate transfers of an entry, see PMLIN_set_send_now_limits
+#define PMLIN_DEFAULT_SEND_NOW_PER_TICK 2 // default maximum immediate transfers per tick, see PMLIN_set_send_now_limits
+#define PMLIN_DEFAULT_QUARANTINE_FAILURES 3 // default consecutive mirroring failures that put a device in quarantine
+#define PMLIN_DEFAULT_MIN_BACKOFF_TICKS 10 // default ticks between the first probes of a device in quarantine
+#define PMLIN_DEFAULT_MAX_BACKOFF_TICKS 1000 // default upper limit for the ticks between probes
 
 // this structure holds  device mirroring info, i.e. automatic transfers
 typedef struct PMLIN_mirror_def_t {
 	volatile uint8_t m_device_id; // the device id
 	volatile uint8_t m_message_type; // message type (type implicitly defines  transfer direction)
 	volatile uint8_t *m_buffer; // pointer to buffer from which or to which message data is transferred
+	volatile uint8_t *m_response; // only for PMLIN_EXCHANGE messages, buffer to which the response is transferred
 	volatile uint16_t m_tick_period; // how often the message is transferred, expressed in calls to PMLIN_mirror_tick()
-	volatile uint16_t m_tick_phase; // a transfer takes place when m_tick_phase == m_ticker
-	volatile uint16_t m_ticker; // down counter [0..m_tick_period[ decremented in PMLIN_mirror_tick()
+	volatile uint16_t m_tick_phase; // [0..m_tick_period[, the first transfer takes place on tick m_tick_period - m_tick_phase
+	uint32_t m_due; // private, tick number of the next transfer
+	struct PMLIN_mirror_def_t *m_next; // private, next entry in the same mirror scheduler slot
+	struct PMLIN_mirror_def_t *m_send_now_next; // private, next entry waiting for an immediate transfer
+	uint32_t m_sent_hash; // private, hash of the payload last transferred successfully
+	uint32_t m_sent_tick; // private, tick number of the last successful send
+	uint32_t m_send_now_tick; // private, tick number of the last immediate transfer
+	bool m_sent; // private, m_sent_hash and m_sent_tick are valid
+	uint32_t m_received_hash; // private, hash of the payload last received, for the change notifications
+	bool m_received; // private, m_received_hash is valid
+	bool m_send_now; // private, the entry is waiting for an immediate transfer, see PMLIN_mirror_send_now
+	bool m_send_now_done; // private, m_send_now_tick is valid
+	bool m_snapshot; // m_buffer points to a tear free PMLIN_mirror_buffer_t, see PMLIN_MIRROR_BUFFER_DEF
+	bool m_changed; // private, the entry is in the changed list of the current tick
+	struct PMLIN_mirror_def_t *m_changed_next; // private, next entry in the changed list of the current tick
+	PMLIN_error_t m_result; // read only, result of the latest transfer, PMLIN_QUARANTINED_ERROR if it was skipped
+	struct PMLIN_sample_ring_t *m_history; // optional ring that keeps the received samples, see pmlin-sample-ring.h
 } PMLIN_mirror_def_t;
 
+// the mirror scheduler is a two level timing wheel, two levels of this many slots cover any m_tick_period
+#define PMLIN_MIRROR_WHEEL_BITS 8
+#define PMLIN_MIRROR_WHEEL_SIZE (1 << PMLIN_MIRROR_WHEEL_BITS)
+
 // macro used to declare and define one message mirroring, used to to define an array of mirroring ops, see pmlin-mirror-demo.c
 #define PMLIN_MIRROR_DEF(device_id, message_type, buffer, tick_period, tick_phase) ((PMLIN_mirror_def_t) { \
 	.m_device_id = device_id, \
@@ -76,6 +124,115 @@ typedef struct PMLIN_mirror_def_t {
 	.m_tick_phase = tick_phase \
 	})
 
+// macro used to declare the mirroring of a PMLIN_EXCHANGE message, buffer is sent and response received in the same frame
+#define PMLIN_EXCHANGE_MIRROR_DEF(device_id, message_type, buffer, response, tick_period, tick_phase) ((PMLIN_mirror_def_t) { \
+	.m_device_id = device_id, \
+	.m_message_type = message_type, \
+	.m_buffer = (volatile uint8_t *)buffer, \
+	.m_response = (volatile uint8_t *)response, \
+	.m_tick_period = tick_period, \
+	.m_tick_phase = tick_phase \
+	})
+
+// transaction kinds, see PMLIN_transaction_t
+#define PMLIN_TRANSACTION_SEND 0 // send a message to a slave, same as PMLIN_send_message
+#define PMLIN_TRANSACTION_RECEIVE 1 // receive a message from a slave, same as PMLIN_receive_message
+#define PMLIN_TRANSACTION_CMD 2 // send a command message to a slave, same as PMLIN_send_cmd_message
+#define PMLIN_TRANSACTION_BROADCAST 3 // send a message to PMLIN_BROADCAST_ID, not acknowledged, see PMLIN_send_group and PMLIN_send_trigger
+#define PMLIN_TRANSACTION_EXCHANGE 4 // send a request and receive the response in one frame, same as PMLIN_exchange_message
+#define PMLIN_TRANSACTION_POLL 5 // poll a range of slaves in one frame, same as PMLIN_poll_messages
+
+// transaction states, see PMLIN_transaction_t
+#define PMLIN_TRANSACTION_IDLE 0 // not started or already completed
+#define PMLIN_TRANSACTION_WAIT_RESPONSE 1 // frame has been sent, waiting for the echo and the response
+#define PMLIN_TRANSACTION_DONE 2 // complete, result is available in m_result
+
+// longest possible frame as seen by the master, i.e. break + header + 255 byte request + crc + 255 byte response + crc
+#define PMLIN_MAX_FRAME_LEN (1 + PMLIN_HEADER_LEN + 255 + 1 + 255 + 1)
+
+typedef struct PMLIN_master_t PMLIN_master_t; // one bus, see PMLIN_master_initialize
+
+// this structure holds one transaction (message exchange) with a slave for the non-blocking API
+typedef struct PMLIN_transaction_t {
+	uint8_t m_kind; // PMLIN_TRANSACTION_xxx kind
+	uint8_t m_id; // the device id
+	uint8_t m_type; // message type, ignored for PMLIN_TRANSACTION_CMD
+	uint8_t m_len; // payload length, ignored for PMLIN_TRANSACTION_CMD
+	uint8_t m_resp_len; // response payload length, only used with PMLIN_TRANSACTION_EXCHANGE
+	volatile uint8_t *m_data; // payload to send or buffer to receive to
+	volatile uint8_t *m_resp; // buffer for the response payload, only used with PMLIN_TRANSACTION_CMD and PMLIN_TRANSACTION_EXCHANGE
+	uint8_t m_first_id; // first polled device id, only used with PMLIN_TRANSACTION_POLL
+	uint8_t m_last_id; // last polled device id, only used with PMLIN_TRANSACTION_POLL
+	PMLIN_error_t *m_results; // result of each slot, only used with PMLIN_TRANSACTION_POLL
+	// following fields are private to PMLIN master code
+	PMLIN_master_t *m_master; // the bus the transaction was started on
+	uint8_t m_state; // PMLIN_TRANSACTION_xxx state
+	PMLIN_error_t m_result; // result once m_state == PMLIN_TRANSACTION_DONE
+	uint16_t m_sn; // number of bytes sent (not including the break)
+	uint16_t m_rn; // number of bytes expected back (including the echo)
+	uint16_t m_n; // number of bytes received so far
+	uint32_t m_start_us; // time stamp (micro seconds) when the transaction was started or the echo completed
+	uint32_t m_bus_start_us; // time stamp (micro seconds) when the transaction was started
+	uint32_t m_deadline; // time stamp (micro seconds) by which the echo or the response must have been received
+	uint32_t m_gap_us; // inter-byte timeout for this transaction
+	uint32_t m_last_rx_us; // time stamp of the latest data received (or the start of the transaction)
+	uint32_t m_end_us; // time stamp (micro seconds) when the transaction completed on the bus
+	uint8_t m_buffer[PMLIN_MAX_FRAME_LEN]; // frame to send and later the received echo and response
+} PMLIN_transaction_t;
+
+// macros used to declare and define a transaction for PMLIN_start_transaction, see pmlin-nonblocking-demo.c
+#define PMLIN_SEND_TRANSACTION(id, type, len, data) ((PMLIN_transaction_t) { \
+	.m_kind = PMLIN_TRANSACTION_SEND, \
+	.m_id = id, \
+	.m_type = type, \
+	.m_len = len, \
+	.m_data = (volatile uint8_t *)data \
+	})
+
+#define PMLIN_RECEIVE_TRANSACTION(id, type, len, data) ((PMLIN_transaction_t) { \
+	.m_kind = PMLIN_TRANSACTION_RECEIVE, \
+	.m_id = id, \
+	.m_type = type, \
+	.m_len = len, \
+	.m_data = (volatile uint8_t *)data \
+	})
+
+#define PMLIN_CMD_TRANSACTION(id, data, resp) ((PMLIN_transaction_t) { \
+	.m_kind = PMLIN_TRANSACTION_CMD, \
+	.m_id = id, \
+	.m_data = (volatile uint8_t *)data, \
+	.m_resp = (volatile uint8_t *)resp \
+	})
+
+#define PMLIN_EXCHANGE_TRANSACTION(id, type, len, data, resp_len, resp) ((PMLIN_transaction_t) { \
+	.m_kind = PMLIN_TRANSACTION_EXCHANGE, \
+	.m_id = id, \
+	.m_type = type, \
+	.m_len = len, \
+	.m_data = (volatile uint8_t *)data, \
+	.m_resp_len = resp_len, \
+	.m_resp = (volatile uint8_t *)resp \
+	})
+
+#define PMLIN_POLL_TRANSACTION(type, first_id, last_id, len, data, results) ((PMLIN_transaction_t) { \
+	.m_kind = PMLIN_TRANSACTION_POLL, \
+	.m_id = PMLIN_BROADCAST_ID, \
+	.m_type = type, \
+	.m_first_id = first_id, \
+	.m_last_id = last_id, \
+	.m_len = len, \
+	.m_data = (volatile uint8_t *)data, \
+	.m_results = results \
+	})
+
+#define PMLIN_BROADCAST_TRANSACTION(type, len, data) ((PMLIN_transaction_t) { \
+	.m_kind = PMLIN_TRANSACTION_BROADCAST, \
+	.m_id = PMLIN_BROADCAST_ID, \
+	.m_type = type, \
+	.m_len = len, \
+	.m_data = (volatile uint8_t *)data \
+	})
+
 // Purpose: send a message to a slave
 //		This call blocks until the message has been sent
 // Parameters:
@@ -124,6 +281,102 @@ PMLIN_error_t PMLIN_receive_message(uint8_t id, uint8_t type, uint8_t len, volat
 //
 PMLIN_error_t PMLIN_send_cmd_message(uint8_t id, volatile uint8_t *data, volatile uint8_t *resp);
 
+// Purpose: send a request to a slave and receive its response in the same frame
+//		This call blocks until the response has been received or a timeout occurs.
+//		The message type must be declared PMLIN_EXCHANGE, see PMLIN_EXCHANGE_MESSAGE_DEF.
+// Parameters:
+// 		id (in)				Target slave id
+//		type (in)			Message type
+//		len (in)			Request payload length
+//		data (in)			Pointer to the request payload data to be sent
+//		resp_len (in)		Response payload length
+//		resp (out)			Pointer to a buffer to receive the response payload data
+//	Returns:				Error code, see below and top of this header
+//		PMLIN_OK
+//		PMLIN_NO_RESP_ERROR		also when the slave did not receive the request intact
+//		PMLIN_TIMEOUT_ERROR
+//		PMLIN_CRC_ERROR
+//
+PMLIN_error_t PMLIN_exchange_message(uint8_t id, uint8_t type, uint8_t len, volatile uint8_t *data, uint8_t resp_len,
+		volatile uint8_t *resp);
+
+#define PMLIN_GROUP_MAX_SLICES_LEN (255 - PMLIN_GROUP_HEADER_LEN) // room for the slices in a group write
+
+// Purpose: Build the payload of a group write broadcast, see PMLIN_send_group
+// Parameters:
+//		payload (out)		Pointer to a buffer of at least PMLIN_GROUP_HEADER_LEN + PMLIN_GROUP_MAX_SLICES_LEN bytes
+//		mask (in)			Devices in the group, bit n for device id n
+//		slice_len (in)		Length of the slice of each device
+//		slices (in)			The slices of the devices in the mask, in id order
+// Returns:					Payload length or 0 if the slices do not fit in one frame
+
+uint8_t PMLIN_build_group_payload(uint8_t *payload, uint32_t mask, uint8_t slice_len, volatile const uint8_t *slices);
+
+// Purpose: Send a message to a group of slaves in one frame
+//		Each device in the mask receives its slice as the payload of its message of the given type, as if
+//		it had been sent to it with PMLIN_send_message, but with a single BREAK, header and CRC for the group.
+//		The message is a broadcast so the slaves do not acknowledge it, only the echo of the frame is checked.
+//		Periodically repeat the message, or read back the state of the slaves, if delivery matters.
+//		The airtime is PMLIN_frame_airtime_us(type, PMLIN_SLAVE_TO_HOST, payload length, 0).
+// Parameters:
+//		type (in)			Message type, any but PMLIN_MESSAGE_TYPE_CMD
+//		mask (in)			Devices in the group, bit n for device id n
+//		slice_len (in)		Length of the slice of each device, normally the length of the message
+//		slices (in)			The slices of the devices in the mask, in id order
+//	Returns:				Error code, see top of this header
+//		PMLIN_OK
+//		PMLIN_COLLISION_ERROR
+//		PMLIN_TIMEOUT_ERROR
+//		PMLIN_INVALID_ARGUMENT_ERROR	if the type is PMLIN_MESSAGE_TYPE_CMD or the slices do not fit in one frame
+
+PMLIN_error_t PMLIN_send_group(uint8_t type, uint32_t mask, uint8_t slice_len, volatile uint8_t *slices);
+
+// Purpose: Make a group of slaves act at the same moment
+//		Sends a broadcast trigger command. Each slave in the mask calls its PMLIN_trigger when the last byte
+//		of the frame arrives, which is at the same moment for all of them. Slaves that latch the messages
+//		they receive instead of acting on them right away (this is up to the device) apply them then.
+//		First send the messages to latch, with PMLIN_send_message or PMLIN_send_group, then the trigger.
+//		As with PMLIN_send_group nothing is acknowledged.
+// Parameters:
+//		mask (in)			Devices to trigger, bit n for device id n
+//	Returns:				Error code, see top of this header
+//		PMLIN_OK
+//		PMLIN_COLLISION_ERROR
+//		PMLIN_TIMEOUT_ERROR
+
+PMLIN_error_t PMLIN_send_trigger(uint32_t mask);
+
+// Purpose: Receive a message from a range of slaves in one frame
+//		Broadcasts a poll command naming the message type and the range of ids. Each slave in the range that
+//		transmits the message type answers in its own time slot, in id order, with the payload and its own CRC.
+//		The slots are timed by the slaves, so the guard between slots (see PMLIN_set_poll_guard_us) must cover
+//		the timer period and interrupt latency of the slowest slave.
+//		The poll frame must fit in PMLIN_MAX_FRAME_LEN, i.e. (last_id - first_id + 1) * (len + 2) <= 255 + 1 + 255.
+// Parameters:
+//		type (in)			Message type, any but PMLIN_MESSAGE_TYPE_CMD
+//		first_id (in)		First device id to poll
+//		last_id (in)		Last device id to poll
+//		len (in)			Payload length
+//		data (out)			Buffer for the payloads, len bytes for each id from first_id to last_id
+//		results (out)		Result of each id from first_id to last_id:
+//							PMLIN_OK, PMLIN_NO_RESP_ERROR (the slot stayed empty), PMLIN_CRC_ERROR or
+//							PMLIN_TIMEOUT_ERROR (the answer was cut short)
+//	Returns:				Error code, see top of this header
+//		PMLIN_OK					if all the slots were received
+//		PMLIN_COLLISION_ERROR
+//		PMLIN_TIMEOUT_ERROR			if the poll itself did not go out
+//		PMLIN_INVALID_ARGUMENT_ERROR	if the range or the type is invalid or the payloads do not fit in one frame
+//		otherwise the result of the first slot that failed
+
+PMLIN_error_t PMLIN_poll_messages(uint8_t type, uint8_t first_id, uint8_t last_id, uint8_t len, volatile uint8_t *data,
+		PMLIN_error_t results[]);
+
+// Purpose: Set the idle time left between the slots of PMLIN_poll_messages
+// Parameters:
+//		guard_us (in)		Guard time in micro seconds, default PMLIN_DEFAULT_POLL_GUARD_US
+
+void PMLIN_set_poll_guard_us(uint32_t guard_us);
+
 // Purpose: Inform PMLIN master of all the expected slave devices
 // Parameters:
 //		devices[] (in)		An permanently allocated array of device declarations
@@ -132,21 +385,241 @@ PMLIN_error_t PMLIN_send_cmd_message(uint8_t id, volatile uint8_t *data, volatil
 void PMLIN_define_devices(PMLIN_device_decl_t devices[], uint8_t num_devices);
 
 // Purpose: Inform PMLIN master of all slaves and messages that are to be mirrored
+//		Entries with zero m_tick_period or with m_tick_phase not less than m_tick_period are never transferred.
+//		The bus utilization the mirroring needs is predicted from the airtime of the messages (see
+//		PMLIN_message_airtime_us) and the tick period (see PMLIN_set_tick_period_us), so declare the devices
+//		and set the tick period first. If the utilization would exceed the limit the mirroring is not defined.
 // Parameters:
+//		mirroring[] (in)	An permanently allocated array of mirroring definitions
+//		num_mirroring (in) 	Size of the mirroring[] array, only limited by memory
+// Returns:					Error code
+//		PMLIN_OK
+//		PMLIN_UTILIZATION_WARNING	The mirroring was defined but the utilization exceeds the warning limit
+//		PMLIN_OVERLOAD_ERROR		The mirroring was not defined, the previous mirroring remains in effect
+//		See PMLIN_set_utilization_limits and PMLIN_get_utilization
+
+PMLIN_error_t PMLIN_define_mirroring(PMLIN_mirror_def_t mirroring[], uint32_t num_mirroring);
+
+// The devices and the mirroring can also be replaced while PMLIN_mirror_tick is running, for example to switch
+// between a service mode and a production configuration. The new configuration is prepared off-line in a
+// PMLIN_tables_t and then swapped in: a tick in progress finishes with the tables it started with and the
+// next tick uses the new ones. PMLIN_mirror_tick takes no lock for this, it only reads the tables pointer.
+// The entries of the new mirroring are scheduled as if it had been defined with PMLIN_define_mirroring at
+// the swap. The health of the devices (see PMLIN_get_device_health) is kept, pending PMLIN_mirror_send_now
+// requests are dropped. PMLIN_define_devices and PMLIN_define_mirroring work on tables of their own, calling
+// them swaps those tables back in but they are still boot-time only.
+
+// this structure holds one set of device and mirroring tables, all fields are private to PMLIN master code
+typedef struct PMLIN_tables_t {
+	PMLIN_device_decl_t *m_id_to_device[PMLIN_MAX_NUM_ID];
+	PMLIN_mirror_def_t *m_mirroring;
+	uint32_t m_num_mirroring;
+	uint32_t m_predicted_permille;
+	uint32_t m_generation; // incremented each time the tables are prepared
+	bool m_prepared; // the tables passed admission control and can be swapped in
+	PMLIN_mirror_def_t *m_wheel[2][PMLIN_MIRROR_WHEEL_SIZE]; // entries due during this and the following wheel turns
+	PMLIN_mirror_def_t *m_wheel_tail[PMLIN_MIRROR_WHEEL_SIZE]; // last entry of each m_wheel[0] slot
+} PMLIN_tables_t;
+
+// Purpose: Prepare a set of tables to be swapped in with PMLIN_swap_tables
+//		Does for the tables what PMLIN_define_devices and PMLIN_define_mirroring do, including the admission
+//		control, without affecting the bus. The tables must not be in use, see PMLIN_tables_in_use.
+// Parameters:
+//		tables (out)		The tables to prepare, must stay allocated as long as they are in use
 //		devices[] (in)		An permanently allocated array of device declarations
-//		num_devices (in) 	Size of the devices[] array
+//		num_devices (in) 	Size of the devices[] array
+//		mirroring[] (in)	An permanently allocated array of mirroring definitions, must not be in use by
+//							other tables
+//		num_mirroring (in) 	Size of the mirroring[] array
+// Returns:					Error code as PMLIN_define_mirroring, on PMLIN_OVERLOAD_ERROR the tables cannot be swapped in
+
+PMLIN_error_t PMLIN_prepare_tables(PMLIN_tables_t *tables, PMLIN_device_decl_t devices[], uint8_t num_devices,
+		PMLIN_mirror_def_t mirroring[], uint32_t num_mirroring);
+
+// Purpose: Make prepared tables the ones used by the next PMLIN_mirror_tick and all the other calls
+//		Can be called from any thread. The tables replaced may still be used by a tick in progress or by
+//		an other call that reads them, such as PMLIN_auto_config, wait until PMLIN_tables_in_use returns
+//		false before preparing them again or freeing them.
+//		Swapping the same tables in again requires preparing them again.
+// Parameters:
+//		tables (in)			Tables prepared with PMLIN_prepare_tables
+// Returns:					The tables replaced or NULL if the tables were not prepared successfully,
+//							in which case nothing was swapped
+
+PMLIN_tables_t* PMLIN_swap_tables(PMLIN_tables_t *tables);
 
-void PMLIN_define_mirroring(PMLIN_mirror_def_t mirroring[], uint8_t num_mirroring);
+// Purpose: Tell if tables are in use, i.e. swapped in or still used by a tick in progress
+// Parameters:
+//		tables (in)			The tables
+// Returns:					True if the tables are in use
+
+bool PMLIN_tables_in_use(PMLIN_tables_t *tables);
 
 // Purpose: Mirror data between the master and all slaves/messages whose turn it is
-//		This call blocks until all the mirroring whose turn it is has been completed
+//		This call blocks until all the mirroring whose turn it is has been completed.
+//		The entries whose turn it is are transferred in the order they appear in the mirroring[] array.
+//		The cost of a call depends on the number of entries whose turn it is, not on the size of the array.
+//		A failed transfer does not affect the others, the result of each is kept in its m_result.
+//		Devices that keep failing are put in quarantine and only probed now and then, see PMLIN_set_quarantine.
 // Parameters:
 //		device_id (out)		Pointer (can be NULL) to device id which the PMLIN_mirror_tick sets
 //							to the id of the first device that did NOT respond PMLIN_OK
-// Returns:					Error code, see PMLIN_send_message and PMLIN_receive_message for possible values
+// Returns:					Error code of the first failed transfer, see PMLIN_send_message and
+//							PMLIN_receive_message for possible values, skipping a device in quarantine is not an error
 
 PMLIN_error_t PMLIN_mirror_tick(uint8_t *device_id);
 
+// Purpose: Tell PMLIN how often PMLIN_mirror_tick is called, used when planning the mirroring
+// Parameters:
+//		tick_period_us (in)	Time between PMLIN_mirror_tick calls in micro seconds, default is PMLIN_DEFAULT_TICK_PERIOD_US
+
+void PMLIN_set_tick_period_us(uint32_t tick_period_us);
+
+// Purpose: Configure the quarantine of devices that keep failing in PMLIN_mirror_tick
+//		A device whose mirroring fails this many times in a row is put in quarantine: its mirroring is skipped
+//		except for a probe, i.e. the first of its transfers due after the backoff. The probes allow the learned
+//		response slack of the device plus the minimum slack (see PMLIN_set_timeouts) instead of twice the
+//		learned or initial slack, so a dead device costs a short timeout now and then instead of a full
+//		timeout every period.
+//		A successful probe ends the quarantine. After each failed probe the backoff is doubled up to the maximum.
+//		All transactions to a device in quarantine, not just the mirroring, use the short timeout.
+// Parameters:
+//		failures (in)			Consecutive failures that put a device in quarantine, 0 turns quarantine off,
+//								default PMLIN_DEFAULT_QUARANTINE_FAILURES
+//		min_backoff_ticks (in)	Ticks from the start of the quarantine to the first probe,
+//								default PMLIN_DEFAULT_MIN_BACKOFF_TICKS
+//		max_backoff_ticks (in)	Upper limit for the ticks between probes, default PMLIN_DEFAULT_MAX_BACKOFF_TICKS
+
+void PMLIN_set_quarantine(uint8_t failures, uint32_t min_backoff_ticks, uint32_t max_backoff_ticks);
+
+// this structure holds the mirroring health of one device, see PMLIN_get_device_health
+typedef struct PMLIN_device_health_t {
+	bool m_quarantined; // the device is in quarantine
+	uint8_t m_failures; // consecutive failed transfers
+	PMLIN_error_t m_last_result; // result of the latest transfer
+	uint32_t m_backoff_ticks; // ticks between probes while in quarantine
+	uint32_t m_probe_tick; // tick number of the next probe while in quarantine, see PMLIN_mirror_tick
+	uint32_t m_quarantines; // number of times the device has been put in quarantine
+} PMLIN_device_health_t;
+
+// Purpose: Get the mirroring health of a device
+// Parameters:
+//		id (in)				Device id
+//		health (out)		Pointer to structure to receive the health
+
+void PMLIN_get_device_health(uint8_t id, PMLIN_device_health_t *health);
+
+// Purpose: Only send PMLIN_HOST_TO_SLAVE mirroring when the buffer has changed or keepalive ticks have passed
+//		On each turn of an entry a hash of its buffer is compared with the hash of the payload last sent
+//		successfully; if they match and the last send is less than keepalive_ticks ago the transfer is
+//		skipped and the bus is left free. The keepalive resends unchanged buffers so that a slave that has
+//		restarted gets up to date, it also covers the unlikely case of a changed buffer with the same hash.
+//		A failed send is always retried on the next turn. Slave to host mirroring is not affected.
+// Parameters:
+//		keepalive_ticks (in)	Maximum number of PMLIN_mirror_tick calls between sends of an unchanged buffer,
+//								0 (the default) sends every buffer on every turn
+
+void PMLIN_set_mirror_keepalive(uint32_t keepalive_ticks);
+
+// Purpose: Transfer a mirroring entry on the next PMLIN_mirror_tick instead of waiting for its turn
+//		Call this after writing a latency critical buffer. The transfer is made at the start of the next tick,
+//		before the entries whose turn it is, and in addition to the periodic transfers of the entry.
+//		Calling again before the transfer has been made has no further effect. The transfers are rate limited,
+//		see PMLIN_set_send_now_limits, a request over the limit waits for a later tick but is not lost.
+//		Can be called from any thread. An immediate transfer that fails is not retried, the periodic
+//		transfers of the entry take care of that.
+// Parameters:
+//		mirror (in)			Pointer to an entry of the array passed to PMLIN_define_mirroring
+
+void PMLIN_mirror_send_now(PMLIN_mirror_def_t *mirror);
+
+// Typedef for the mirroring change notification callback, see PMLIN_set_mirror_changed_callback
+typedef void (*PMLIN_mirror_changed_fp)(PMLIN_mirror_def_t *mirror, void *user);
+
+// Purpose: Get notified when the data received by PMLIN_SLAVE_TO_HOST (or the response of PMLIN_EXCHANGE) mirroring changes
+//		At the end of each PMLIN_mirror_tick the callback is called once for every entry whose received payload
+//		differs from the payload it received previously (or that received its first payload since
+//		PMLIN_define_mirroring), in the order the changes were received, and then once with a NULL entry
+//		if there was at least one change. So a wakeup, such as signalling an eventfd (see PMLIN_posix_notify_fd),
+//		can be done once per tick. Unchanged payloads do not cause calls. The changes are detected with a hash
+//		of the payload which catches every change confined to one byte, in theory a change of several bytes
+//		could go unnoticed. Called from the thread calling PMLIN_mirror_tick, keep it short.
+// Parameters:
+//		changed_fp (in)		Pointer (can be NULL) to the callback
+//		user (in)			Passed to the callback, not used by PMLIN
+
+void PMLIN_set_mirror_changed_callback(PMLIN_mirror_changed_fp changed_fp, void *user);
+
+// Purpose: Limit the bus time taken by PMLIN_mirror_send_now
+//		The worst case extra bus time per tick is max_per_tick times the airtime of the longest entry.
+// Parameters:
+//		min_interval_ticks (in)	Minimum number of ticks between immediate transfers of the same entry,
+//								default PMLIN_DEFAULT_SEND_NOW_INTERVAL
+//		max_per_tick (in)		Maximum number of immediate transfers per tick, default PMLIN_DEFAULT_SEND_NOW_PER_TICK
+
+void PMLIN_set_send_now_limits(uint32_t min_interval_ticks, uint32_t max_per_tick);
+
+// Purpose: Calculate how long the bus is occupied by one frame
+//		The airtime is the BREAK (PMLIN_BREAK_AIRTIME_US), the header and its CRC, the payload and its CRC,
+//		the ACK for master to slave messages, and the turnaround, i.e. the time the slave takes to respond.
+// Parameters:
+//		message_type (in)	Message type, for PMLIN_MESSAGE_TYPE_CMD the length and direction are ignored
+//		message_dir (in)	PMLIN_HOST_TO_SLAVE or PMLIN_SLAVE_TO_HOST
+//		message_length (in)	Payload length
+//		turnaround_us (in)	Time from the end of the master's part of the frame to the start of the slave's part
+// Returns:					Airtime in micro seconds
+
+uint32_t PMLIN_frame_airtime_us(uint8_t message_type, uint8_t message_dir, uint8_t message_length, uint32_t turnaround_us);
+
+// Purpose: Calculate how long the bus is occupied by one PMLIN_EXCHANGE frame
+//		As PMLIN_frame_airtime_us but with a request and its CRC from the master followed by a response and its
+//		CRC from the slave, and no ACK.
+// Parameters:
+//		request_length (in)		Request payload length
+//		response_length (in)	Response payload length
+//		turnaround_us (in)		Time from the end of the request to the start of the response
+// Returns:						Airtime in micro seconds
+
+uint32_t PMLIN_exchange_airtime_us(uint8_t request_length, uint8_t response_length, uint32_t turnaround_us);
+
+// Purpose: Estimate how long the bus is occupied by one transfer of a message
+//		As PMLIN_frame_airtime_us with the message declaration of the device and its learned response slack
+//		as the turnaround (the minimum slack, see PMLIN_set_timeouts, until the device has responded)
+// Parameters:
+//		id (in)				Device id, the device must have been declared with PMLIN_define_devices
+//		message_type (in)	Message type
+// Returns:					Airtime in micro seconds or 0 if the device or message is not declared
+
+uint32_t PMLIN_message_airtime_us(uint8_t id, uint8_t message_type);
+
+// Purpose: Set the predicted bus utilization limits that PMLIN_define_mirroring enforces
+// Parameters:
+//		warning_permille (in)	Utilization in 1/1000 above which PMLIN_UTILIZATION_WARNING is returned,
+//								default PMLIN_UTILIZATION_WARNING_PERMILLE
+//		limit_permille (in)		Utilization in 1/1000 above which the mirroring is refused,
+//								default PMLIN_UTILIZATION_LIMIT_PERMILLE, 0 turns off the check
+
+void PMLIN_set_utilization_limits(uint32_t warning_permille, uint32_t limit_permille);
+
+// this structure holds the bus utilization, all utilizations in 1/1000 of the bus capacity
+typedef struct PMLIN_utilization_t {
+	uint32_t m_predicted_permille; // utilization needed by the mirroring, as predicted by PMLIN_define_mirroring
+	uint32_t m_actual_permille; // time the bus was in use per elapsed time, by all transactions not just mirroring
+	uint64_t m_busy_us; // time the bus was in use, from the start of the BREAK to the end of the response
+	uint64_t m_elapsed_us; // time the utilization has been measured
+	uint32_t m_frames; // number of transactions
+	uint32_t m_mirror_skipped; // number of unchanged mirroring transfers skipped, see PMLIN_set_mirror_keepalive
+} PMLIN_utilization_t;
+
+// Purpose: Get the predicted and the actual bus utilization
+//		The actual utilization is only measured if a time source has been given to PMLIN_initialize_nonblocking,
+//		it is measured from the first transaction after the previous reset to the latest transaction.
+// Parameters:
+//		utilization (out)	Pointer to structure to receive the utilization
+//		reset (in)			If true the actual utilization measurement is restarted
+
+void PMLIN_get_utilization(PMLIN_utilization_t *utilization, bool reset);
+
 // Purpose: Attempts to renumber devices based on their type to correspond to the list passed to PMLIN_define_devices
 //		This call blocks until the task is complete or fails
 // Parameters:
@@ -182,6 +655,7 @@ typedef void (*PMLIN_write_fp)(uint8_t *buffer, uint16_t len); // send len bytes
 typedef uint16_t (*PMLIN_read_fp)(uint8_t *buffer, uint16_t len, uint32_t timeout_us); // receive len bytes to buffer or until timeout_us micro seconds
 typedef void (*PMLIN_send_break_fp)(); // send break
 typedef void (*PMLIN_mutex_fp)(void*); // lock mutex/unlock mutex, block until successfull
+typedef uint16_t (*PMLIN_read_gap_fp)(uint8_t *buffer, uint16_t len, uint32_t timeout_us, uint32_t gap_us); // as PMLIN_read_fp but also stop if no data for gap_us after the first byte
 
 // Purpose: Pass pointers to the callback and gives PMLIN master code chance to do its initializations
 //		Initialisation includes finding, opening and configuring the serial port used by PMLIN master
@@ -203,6 +677,93 @@ void PMLIN_initialize_master( //
 		PMLIN_mutex_fp unlock_fp //
 		);
 
+// Typedef for the optional time source callback that the non-blocking API needs
+typedef uint32_t (*PMLIN_time_us_fp)(); // return a free running (wrapping) time stamp in micro seconds
+
+// Purpose: Enable the non-blocking transaction API (PMLIN_start_transaction / PMLIN_step_transaction)
+//		Must be called after PMLIN_initialize_master
+// Parameters:
+//		poll_fd (in)		File descriptor (or -1 if not applicable) that becomes readable when the
+//							serial port has received data, returned by PMLIN_get_poll_fd for select/poll/epoll
+//		time_fp (in)		Pointer to function that returns current time in micro seconds
+
+void PMLIN_initialize_nonblocking(int poll_fd, PMLIN_time_us_fp time_fp);
+
+// Purpose: Returns the file descriptor passed to PMLIN_initialize_nonblocking
+//		Wait for this to become readable and then call PMLIN_step_transaction
+
+int PMLIN_get_poll_fd();
+
+// Purpose: Pass an optional read callback that also implements an inter-byte timeout
+//		If this is set it is used instead of the read callback passed to PMLIN_initialize_master
+//		so that a missing or stalled response is detected within the gap timeout.
+// Parameters:
+//		read_gap_fp (in)	Pointer to function to receive data from the serial port
+
+void PMLIN_set_read_gap_callback(PMLIN_read_gap_fp read_gap_fp);
+
+// Purpose: Configure the adaptive timeouts
+// Parameters:
+//		min_slack_us (in)	Lower limit for the learned response slack, default PMLIN_MIN_RESPONSE_SLACK_US
+//		gap_us (in)			Inter-byte timeout, default PMLIN_GAP_TIMEOUT_US
+
+void PMLIN_set_timeouts(uint32_t min_slack_us, uint32_t gap_us);
+
+// Purpose: Returns the learned response slack for a device, i.e. how much longer than the pure airtime
+//		the transactions with the device have recently taken, in micro seconds
+
+uint32_t PMLIN_get_response_slack(uint8_t id);
+
+// Purpose: Start a transaction without waiting for the response
+//		This call blocks only for the duration of sending the break and the frame.
+//		The PMLIN mutex is locked from this call until the transaction completes in PMLIN_step_transaction,
+//		so both must be called from the same thread and only one transaction can be in progress at a time.
+// Parameters:
+//		t (in/out)			Transaction to start, declare with PMLIN_SEND_TRANSACTION, PMLIN_RECEIVE_TRANSACTION
+//							PMLIN_CMD_TRANSACTION or PMLIN_EXCHANGE_TRANSACTION. Must stay allocated until the transaction is done.
+//	Returns:				Error code
+//		PMLIN_OK
+//		PMLIN_NO_INITIALIZED_ERROR
+
+PMLIN_error_t PMLIN_start_transaction(PMLIN_transaction_t *t);
+
+// Purpose: Advance a started transaction, never blocks
+//		Call this when the poll fd is readable or when the time returned by PMLIN_transaction_time_left
+//		has elapsed.
+// Parameters:
+//		t (in/out)			Transaction started with PMLIN_start_transaction
+//	Returns:				true when the transaction is done and t->m_result holds the same result
+//							that PMLIN_send_message, PMLIN_receive_message or PMLIN_send_cmd_message would return
+
+bool PMLIN_step_transaction(PMLIN_transaction_t *t);
+
+// Purpose: Perform a transaction
+//		This call blocks until the transaction is complete, exactly like PMLIN_send_message,
+//		PMLIN_receive_message and PMLIN_send_cmd_message
+// Parameters:
+//		t (in/out)			Transaction to perform, declare with PMLIN_SEND_TRANSACTION, PMLIN_RECEIVE_TRANSACTION
+//							or PMLIN_CMD_TRANSACTION.
+//	Returns:				Error code, same as the corresponding blocking call
+
+PMLIN_error_t PMLIN_run_transaction(PMLIN_transaction_t *t);
+
+// Purpose: Perform a number of transactions back to back without releasing the bus in between
+//		All frames are built before the bus is taken and no other thread can interleave its
+//		transactions with the batch. All transactions are performed even if some of them fail.
+// Parameters:
+//		transactions (in/out)	Transactions to perform in array order, declare with PMLIN_SEND_TRANSACTION,
+//								PMLIN_RECEIVE_TRANSACTION or PMLIN_CMD_TRANSACTION. The result of each
+//								transaction is left in its m_result field.
+//		num_transactions (in)	Size of the transactions[] array
+//	Returns:				PMLIN_OK if all transactions succeeded, otherwise the first error encountered
+//		PMLIN_NO_INITIALIZED_ERROR
+
+PMLIN_error_t PMLIN_transact_batch(PMLIN_transaction_t transactions[], uint16_t num_transactions);
+
+// Purpose: Returns the number of micro seconds until a started transaction times out, use as the poll timeout
+
+uint32_t PMLIN_transaction_time_left(PMLIN_transaction_t *t);
+
 // Purpose: Given an error returns a pointer to human readable English language text string
 // Parameters:
 //		res (in)			The error code for which to return a human readable string
@@ -210,6 +771,10 @@ void PMLIN_initialize_master( //
 
 char* PMLIN_result_to_string(PMLIN_error_t res);
 
+// Purpose: Update a PMLIN CRC with one byte, start from PMLIN_CRC_INIT_VAL
+
+uint8_t PMLIN_crc8(uint8_t crc, uint8_t data);
+
 // Purpose: Turn on human readable serial data traffic logging to console
 // Parameters:
 //		debug_trafic (in)	If true (not zero) turns on the logging, 0 turns it off.
@@ -224,10 +789,144 @@ void PMLIN_set_debug_trafic(bool debug_trafic);
 
 PMLIN_error_t PMLIN_renum_id(uint8_t old_id, uint8_t new_id);
 
+// Multiple buses
+//
+// All the functions above operate on a default bus. To drive several buses from one process each bus
+// gets its own PMLIN_master_t, initialized with PMLIN_master_initialize, and the PMLIN_master_xxx
+// functions below which work exactly like the corresponding PMLIN_xxx functions but on the given bus.
+// Different buses can be used concurrently from different threads.
+
+// Typedefs for function pointers to HAL callbacks that receive the port they operate on
+typedef void (*PMLIN_hal_send_break_fp)(void *port); // send break
+typedef void (*PMLIN_hal_write_fp)(void *port, uint8_t *buffer, uint16_t len); // send len bytes from buffer
+typedef uint16_t (*PMLIN_hal_read_gap_fp)(void *port, uint8_t *buffer, uint16_t len, uint32_t timeout_us, uint32_t gap_us); // see PMLIN_read_gap_fp
+
+// this structure holds the HAL of one bus
+typedef struct PMLIN_hal_t {
+	PMLIN_hal_send_break_fp m_send_break;
+	PMLIN_hal_write_fp m_write;
+	PMLIN_hal_read_gap_fp m_read_gap;
+	void *m_port; // passed as the first argument to the functions above, e.g. a PMLIN_posix_port_t
+} PMLIN_hal_t;
+
+// macro used to define a HAL
+#define PMLIN_HAL(send_break, write, read_gap, port) ((PMLIN_hal_t) { \
+	.m_send_break = send_break, \
+	.m_write = write, \
+	.m_read_gap = read_gap, \
+	.m_port = port \
+	})
+
+// this structure holds all the state of one bus, all fields are private to PMLIN master code
+struct PMLIN_master_t {
+	bool m_initialized;
+	PMLIN_hal_t m_hal;
+	void *m_mutex;
+	PMLIN_mutex_fp m_lock_mutex;
+	PMLIN_mutex_fp m_unlock_mutex;
+	PMLIN_time_us_fp m_time_us;
+	int m_poll_fd;
+	bool m_debug_traffic;
+	PMLIN_tables_t m_boot_tables; // the tables of PMLIN_define_devices and PMLIN_define_mirroring
+	_Atomic(PMLIN_tables_t*) m_tables; // the tables swapped in
+	_Atomic(PMLIN_tables_t*) m_tick_tables; // the tables used by the tick in progress, NULL between ticks
+	_Atomic(PMLIN_tables_t*) m_call_tables; // the tables used by the call holding the PMLIN mutex, NULL if none
+	uint32_t m_call_pins; // nesting depth of the calls using m_call_tables, protected by the PMLIN mutex
+	PMLIN_tables_t *m_scheduled_tables; // the tables whose entries are in their wheel, only used by the tick
+	uint32_t m_scheduled_generation; // m_generation of m_scheduled_tables when they were scheduled
+	uint32_t m_response_slack_us[PMLIN_MAX_NUM_ID]; // learned, zero means not yet learned
+	PMLIN_device_health_t m_health[PMLIN_MAX_NUM_ID];
+	uint8_t m_quarantine_failures;
+	uint32_t m_min_backoff_ticks;
+	uint32_t m_max_backoff_ticks;
+	uint32_t m_min_slack_us;
+	uint32_t m_gap_us;
+	uint32_t m_poll_guard_us;
+	uint32_t m_tick; // number of PMLIN_master_mirror_tick calls
+	uint32_t m_tick_period_us;
+	uint32_t m_keepalive_ticks;
+	PMLIN_mirror_def_t *m_send_now_head; // entries waiting for an immediate transfer, in request order
+	PMLIN_mirror_def_t *m_send_now_tail;
+	uint32_t m_send_now_interval;
+	uint32_t m_send_now_per_tick;
+	PMLIN_mirror_changed_fp m_changed_fp;
+	void *m_changed_user;
+	PMLIN_mirror_def_t *m_changed_head; // entries whose received payload changed during the current tick
+	PMLIN_mirror_def_t *m_changed_tail;
+	uint32_t m_mirror_skipped;
+	uint32_t m_utilization_warning_permille;
+	uint32_t m_utilization_limit_permille;
+	bool m_measuring; // set once the first transaction since the previous reset has been accounted for
+	uint32_t m_measured_us; // time stamp of the latest transaction accounted for
+	uint64_t m_busy_us;
+	uint64_t m_elapsed_us;
+	uint32_t m_frames;
+	struct PMLIN_queue_t *m_queue; // the bus thread and its request queue, see pmlin-master-queue.h, NULL if never started
+};
+
+// Purpose: Initialize a bus, must be called before any other PMLIN_master_xxx function on the bus
+// Parameters:
+//		m (out)				The bus to initialize
+//		hal (in)			The HAL of the bus, declare with PMLIN_HAL
+//		mutex (in)			Pointer to a recursive mutex object that is compatible with the lock_fp and unlock_fp,
+//							each bus needs its own mutex
+//		lock_fp (in)		Pointer to function to lock a mutex
+//		unlock_fp (in)		Pointer to function to unlock a mutex
+
+void PMLIN_master_initialize(PMLIN_master_t *m, PMLIN_hal_t hal, void *mutex, PMLIN_mutex_fp lock_fp, PMLIN_mutex_fp unlock_fp);
+
+// Purpose: Returns the bus used by the functions that do not take a PMLIN_master_t
+
+PMLIN_master_t* PMLIN_default_master();
+
+void PMLIN_master_initialize_nonblocking(PMLIN_master_t *m, int poll_fd, PMLIN_time_us_fp time_fp);
+int PMLIN_master_get_poll_fd(PMLIN_master_t *m);
+void PMLIN_master_set_timeouts(PMLIN_master_t *m, uint32_t min_slack_us, uint32_t gap_us);
+uint32_t PMLIN_master_get_response_slack(PMLIN_master_t *m, uint8_t id);
+void PMLIN_master_set_debug_trafic(PMLIN_master_t *m, bool debug_trafic);
+PMLIN_error_t PMLIN_master_send_message(PMLIN_master_t *m, uint8_t id, uint8_t type, uint8_t len, volatile uint8_t *data);
+PMLIN_error_t PMLIN_master_receive_message(PMLIN_master_t *m, uint8_t id, uint8_t type, uint8_t len, volatile uint8_t *data);
+PMLIN_error_t PMLIN_master_exchange_message(PMLIN_master_t *m, uint8_t id, uint8_t type, uint8_t len, volatile uint8_t *data,
+		uint8_t resp_len, volatile uint8_t *resp);
+PMLIN_error_t PMLIN_master_send_cmd_message(PMLIN_master_t *m, uint8_t id, volatile uint8_t *data, volatile uint8_t *resp);
+PMLIN_error_t PMLIN_master_send_group(PMLIN_master_t *m, uint8_t type, uint32_t mask, uint8_t slice_len, volatile uint8_t *slices);
+PMLIN_error_t PMLIN_master_send_trigger(PMLIN_master_t *m, uint32_t mask);
+PMLIN_error_t PMLIN_master_poll_messages(PMLIN_master_t *m, uint8_t type, uint8_t first_id, uint8_t last_id, uint8_t len,
+		volatile uint8_t *data, PMLIN_error_t results[]);
+void PMLIN_master_set_poll_guard_us(PMLIN_master_t *m, uint32_t guard_us);
+PMLIN_error_t PMLIN_master_run_transaction(PMLIN_master_t *m, PMLIN_transaction_t *t);
+PMLIN_error_t PMLIN_master_transact_batch(PMLIN_master_t *m, PMLIN_transaction_t transactions[], uint16_t num_transactions);
+PMLIN_error_t PMLIN_master_start_transaction(PMLIN_master_t *m, PMLIN_transaction_t *t); // step with PMLIN_step_transaction
+void PMLIN_master_define_devices(PMLIN_master_t *m, PMLIN_device_decl_t devices[], uint8_t num_devices);
+PMLIN_error_t PMLIN_master_define_mirroring(PMLIN_master_t *m, PMLIN_mirror_def_t mirroring[], uint32_t num_mirroring);
+PMLIN_error_t PMLIN_master_prepare_tables(PMLIN_master_t *m, PMLIN_tables_t *tables, PMLIN_device_decl_t devices[],
+		uint8_t num_devices, PMLIN_mirror_def_t mirroring[], uint32_t num_mirroring);
+PMLIN_tables_t* PMLIN_master_swap_tables(PMLIN_master_t *m, PMLIN_tables_t *tables);
+bool PMLIN_master_tables_in_use(PMLIN_master_t *m, PMLIN_tables_t *tables);
+PMLIN_error_t PMLIN_master_mirror_tick(PMLIN_master_t *m, uint8_t *device_id);
+void PMLIN_master_set_tick_period_us(PMLIN_master_t *m, uint32_t tick_period_us);
+void PMLIN_master_set_mirror_keepalive(PMLIN_master_t *m, uint32_t keepalive_ticks);
+void PMLIN_master_mirror_send_now(PMLIN_master_t *m, PMLIN_mirror_def_t *mirror);
+void PMLIN_master_set_send_now_limits(PMLIN_master_t *m, uint32_t min_interval_ticks, uint32_t max_per_tick);
+void PMLIN_master_set_mirror_changed_callback(PMLIN_master_t *m, PMLIN_mirror_changed_fp changed_fp, void *user);
+void PMLIN_master_set_quarantine(PMLIN_master_t *m, uint8_t failures, uint32_t min_backoff_ticks, uint32_t max_backoff_ticks);
+void PMLIN_master_get_device_health(PMLIN_master_t *m, uint8_t id, PMLIN_device_health_t *health);
+uint32_t PMLIN_master_message_airtime_us(PMLIN_master_t *m, uint8_t id, uint8_t message_type);
+void PMLIN_master_set_utilization_limits(PMLIN_master_t *m, uint32_t warning_permille, uint32_t limit_permille);
+void PMLIN_master_get_utilization(PMLIN_master_t *m, PMLIN_utilization_t *utilization, bool reset);
+PMLIN_error_t PMLIN_master_auto_config(PMLIN_master_t *m, PMLIN_error_t renum[]);
+PMLIN_error_t PMLIN_master_check_config(PMLIN_master_t *m, uint8_t *device_id);
+PMLIN_error_t PMLIN_master_renum_id(PMLIN_master_t *m, uint8_t old_id, uint8_t new_id);
+void PMLIN_master_print_out_devices(PMLIN_master_t *m);
+
 // Given a global array of PMLIN_device_decl_t this calls PMLIN_define_devices, used to make code more readable
 #define PMLIN_DEFINE_DEVICES(device_array) PMLIN_define_devices(device_array,sizeof(device_array)/sizeof(device_array[0]))
 
 // Given a global array of PMLIN_mirror_def_t this calls PMLIN_define_mirroring, used to make code more readable
 #define PMLIN_DEFINE_MIRRORING(mirroring_array) PMLIN_define_mirroring(mirroring_array,sizeof(mirroring_array)/sizeof(mirroring_array[0]))
 
+// As above but for a given bus
+#define PMLIN_MASTER_DEFINE_DEVICES(m, device_array) PMLIN_master_define_devices(m,device_array,sizeof(device_array)/sizeof(device_array[0]))
+#define PMLIN_MASTER_DEFINE_MIRRORING(m, mirroring_array) PMLIN_master_define_mirroring(m,mirroring_array,sizeof(mirroring_array)/sizeof(mirroring_array[0]))
+
 #endif
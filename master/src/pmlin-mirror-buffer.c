@@ -0,0 +1,86 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "pmlin-mirror-buffer.h"
+
+// The sequence lock follows Boehm, "Can Seqlocks Get Along With Programming Language Memory Models?":
+// the writer makes the sequence number odd, fences, updates and then releases the next even number,
+// the reader acquires the sequence number, copies, fences and checks that the number did not change.
+
+volatile uint8_t* PMLIN_mirror_buffer_begin_write(PMLIN_mirror_buffer_t *buffer) {
+	unsigned seq = atomic_load_explicit(&buffer->m_seq, memory_order_relaxed);
+	// an odd number means an other writer is updating, wait for it to finish
+	while ((seq & 1) || !atomic_compare_exchange_weak_explicit(&buffer->m_seq, &seq, seq + 1, memory_order_acquire,
+			memory_order_relaxed))
+		seq = atomic_load_explicit(&buffer->m_seq, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	return buffer->m_data;
+}
+
+void PMLIN_mirror_buffer_end_write(PMLIN_mirror_buffer_t *buffer) {
+	atomic_fetch_add_explicit(&buffer->m_seq, 1, memory_order_release);
+}
+
+void PMLIN_mirror_buffer_write(PMLIN_mirror_buffer_t *buffer, const void *data, uint16_t length) {
+	volatile uint8_t *dst = PMLIN_mirror_buffer_begin_write(buffer);
+	for (uint16_t i = 0; i < length; i++)
+		dst[i] = ((const uint8_t*) data)[i];
+	PMLIN_mirror_buffer_end_write(buffer);
+}
+
+// one attempt at a consistent copy, returns false if a write was in progress or happened during the copy
+static bool PMLIN_mirror_buffer_copy(PMLIN_mirror_buffer_t *buffer, void *data, uint16_t length, unsigned *seq) {
+	unsigned seq0 = atomic_load_explicit(&buffer->m_seq, memory_order_acquire);
+	if (seq0 & 1)
+		return false;
+	for (uint16_t i = 0; i < length; i++)
+		((uint8_t*) data)[i] = buffer->m_data[i];
+	atomic_thread_fence(memory_order_acquire);
+	*seq = seq0;
+	return atomic_load_explicit(&buffer->m_seq, memory_order_relaxed) == seq0;
+}
+
+uint32_t PMLIN_mirror_buffer_read(PMLIN_mirror_buffer_t *buffer, void *data, uint16_t length) {
+	unsigned seq;
+	while (!PMLIN_mirror_buffer_copy(buffer, data, length, &seq))
+		;
+	return seq / 2;
+}
+
+bool PMLIN_mirror_buffer_try_read(PMLIN_mirror_buffer_t *buffer, void *data, uint16_t length, uint32_t retries) {
+	unsigned seq;
+	for (uint32_t i = 0; i < retries; i++)
+		if (PMLIN_mirror_buffer_copy(buffer, data, length, &seq))
+			return true;
+	return false;
+}
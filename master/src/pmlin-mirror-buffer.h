@@ -0,0 +1,128 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __PMLIN_MIRROR_BUFFER_H__
+#define	__PMLIN_MIRROR_BUFFER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "pmlin-master.h"
+
+// Optional tear free mirroring buffers.
+//
+// A plain mirroring buffer is copied byte by byte by the mirroring while the application may be writing
+// or reading it, so a multi byte message can be sent half updated or read half received. A mirroring
+// buffer declared with PMLIN_MIRROR_BUFFER is protected by a sequence lock: writers publish a complete
+// snapshot by bumping the sequence number before and after the update, readers copy the data and retry
+// if the sequence number was odd or changed meanwhile. Neither side ever takes the PMLIN mutex and the
+// mirroring never waits for a writer: if it cannot get a consistent copy the transfer waits for the next turn.
+
+#define PMLIN_MIRROR_BUFFER_RETRIES 100 // attempts the mirroring makes to get a consistent copy to send
+
+// this structure holds one tear free mirroring buffer, all fields are private to PMLIN master code
+typedef struct PMLIN_mirror_buffer_t {
+	atomic_uint m_seq; // odd while a write is in progress
+	volatile uint8_t *m_data; // the message data, as long as the message
+} PMLIN_mirror_buffer_t;
+
+// macro used to declare and define a tear free mirroring buffer for a data array of the length of the message
+#define PMLIN_MIRROR_BUFFER(data) ((PMLIN_mirror_buffer_t) { \
+	.m_seq = 0, \
+	.m_data = (volatile uint8_t *)data \
+	})
+
+// macro used to declare and define one message mirroring using a tear free buffer, see PMLIN_MIRROR_DEF
+#define PMLIN_MIRROR_BUFFER_DEF(device_id, message_type, mirror_buffer, tick_period, tick_phase) ((PMLIN_mirror_def_t) { \
+	.m_device_id = device_id, \
+	.m_message_type = message_type, \
+	.m_buffer = (volatile uint8_t *)(mirror_buffer), \
+	.m_tick_period = tick_period, \
+	.m_tick_phase = tick_phase, \
+	.m_snapshot = true \
+	})
+
+// as PMLIN_MIRROR_BUFFER_DEF for a PMLIN_EXCHANGE message, the request is taken from and the response published to tear free buffers
+#define PMLIN_EXCHANGE_MIRROR_BUFFER_DEF(device_id, message_type, mirror_buffer, response_buffer, tick_period, tick_phase) ((PMLIN_mirror_def_t) { \
+	.m_device_id = device_id, \
+	.m_message_type = message_type, \
+	.m_buffer = (volatile uint8_t *)(mirror_buffer), \
+	.m_response = (volatile uint8_t *)(response_buffer), \
+	.m_tick_period = tick_period, \
+	.m_tick_phase = tick_phase, \
+	.m_snapshot = true \
+	})
+
+// Purpose: Publish new data to a mirroring buffer
+//		Can be called from any number of threads, concurrent writers wait for each other.
+// Parameters:
+//		buffer (in/out)		The buffer
+//		data (in)			The new data
+//		length (in)			Number of bytes to write from the start of the buffer
+
+void PMLIN_mirror_buffer_write(PMLIN_mirror_buffer_t *buffer, const void *data, uint16_t length);
+
+// Purpose: Start updating a mirroring buffer in place, for changing only some bytes
+//		Must be followed by PMLIN_mirror_buffer_end_write, keep the update short as readers wait for it.
+// Parameters:
+//		buffer (in/out)		The buffer
+// Returns:					Pointer to the data to update
+
+volatile uint8_t* PMLIN_mirror_buffer_begin_write(PMLIN_mirror_buffer_t *buffer);
+
+// Purpose: Publish an update started with PMLIN_mirror_buffer_begin_write
+// Parameters:
+//		buffer (in/out)		The buffer
+
+void PMLIN_mirror_buffer_end_write(PMLIN_mirror_buffer_t *buffer);
+
+// Purpose: Get a consistent copy of the data in a mirroring buffer, waits while a write is in progress
+// Parameters:
+//		buffer (in)			The buffer
+//		data (out)			Where to copy the data
+//		length (in)			Number of bytes to copy from the start of the buffer
+// Returns:					Number of the snapshot that was copied, it changes every time new data is published
+
+uint32_t PMLIN_mirror_buffer_read(PMLIN_mirror_buffer_t *buffer, void *data, uint16_t length);
+
+// Purpose: As PMLIN_mirror_buffer_read but gives up after a number of attempts
+// Parameters:
+//		buffer (in)			The buffer
+//		data (out)			Where to copy the data
+//		length (in)			Number of bytes to copy from the start of the buffer
+//		retries (in)		Maximum number of attempts
+// Returns:					True if a consistent copy was made
+
+bool PMLIN_mirror_buffer_try_read(PMLIN_mirror_buffer_t *buffer, void *data, uint16_t length, uint32_t retries);
+
+#endif
@@ -0,0 +1,409 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifdef __linux__
+#define _GNU_SOURCE // for ppoll()
+#endif
+
+#include "pmlin-posix-hal.h"
+
+#include "pmlin.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/select.h>
+#include <sys/ioctl.h>
+
+// PARMRK escape sequence decoding states
+#define PMLIN_POSIX_RX_DATA 0
+#define PMLIN_POSIX_RX_ESCAPE 1 // got \377
+#define PMLIN_POSIX_RX_ERROR 2 // got \377 \0
+
+// the port used by the functions that do not take a PMLIN_posix_port_t
+static PMLIN_posix_port_t g_PMLIN_posix_port = { .m_fd = -1, .m_break_us = PMLIN_POSIX_BREAK_US, .m_rx_synced = true };
+
+// termios speeds are symbolic constants, which on some systems (e.g. macOS) happen to be the baudrate itself
+static speed_t PMLIN_posix_speed(uint32_t baudrate) {
+	switch (baudrate) {
+	case 9600:
+		return B9600;
+	case 19200:
+		return B19200;
+	case 38400:
+		return B38400;
+	case 57600:
+		return B57600;
+	default:
+		return B38400;
+	}
+}
+
+// wait until the fd is readable or timeout_us micro seconds have elapsed, returns > 0 if readable
+static int PMLIN_posix_wait_readable(int fd, uint32_t timeout_us) {
+#ifdef __linux__
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	struct timespec tout = { .tv_sec = timeout_us / 1000000, .tv_nsec = (timeout_us % 1000000) * 1000L };
+	return ppoll(&pfd, 1, &tout, NULL);
+#else
+	fd_set fdset;
+	FD_ZERO(&fdset);
+	FD_SET(fd, &fdset);
+	struct timeval tout = { .tv_sec = timeout_us / 1000000, .tv_usec = timeout_us % 1000000 };
+	return select(fd + 1, &fdset, NULL, NULL, &tout);
+#endif
+}
+
+int PMLIN_posix_port_open(PMLIN_posix_port_t *port, const char *port_name) {
+	PMLIN_posix_port_t init = { .m_fd = -1, .m_break_us = PMLIN_POSIX_BREAK_US, .m_rx_synced = true };
+	*port = init;
+	int com = open(port_name, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (com < 0)
+		return -1;
+
+	struct termios opts;
+
+	if (tcgetattr(com, &opts) != 0) {
+		close(com);
+		return -1;
+	}
+
+	opts.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
+
+	opts.c_cflag |= (CLOCAL | CREAD);
+	opts.c_cflag &= ~PARENB;
+	opts.c_cflag |= CSTOPB; // two stop bits
+	opts.c_cflag &= ~CSIZE;
+	opts.c_cflag |= CS8;
+
+	opts.c_oflag &= ~OPOST;
+
+	opts.c_iflag &= ~(IXON | IXOFF | IXANY | ICRNL | INLCR | IGNCR | ISTRIP);
+	// BREAKs and framing errors are marked in the byte stream, see PMLIN_posix_port_decode
+	opts.c_iflag &= ~(IGNBRK | BRKINT | IGNPAR);
+	opts.c_iflag |= PARMRK | INPCK;
+	// reads never block, PMLIN_posix_read waits for data with poll/select
+	opts.c_cc[VMIN] = 0;
+	opts.c_cc[VTIME] = 0;
+
+	cfsetispeed(&opts, PMLIN_posix_speed(PMLIN_BAUDRATE));
+	cfsetospeed(&opts, PMLIN_posix_speed(PMLIN_BAUDRATE));
+
+	if (tcsetattr(com, TCSANOW, &opts) != 0) {
+		close(com);
+		return -1;
+	}
+
+	tcflush(com, TCIOFLUSH); // just in case some crap is the buffers
+	port->m_fd = com;
+	return com;
+}
+
+int PMLIN_posix_open_serial_port(const char *port_name) {
+	return PMLIN_posix_port_open(&g_PMLIN_posix_port, port_name);
+}
+
+int PMLIN_posix_get_fd() {
+	return g_PMLIN_posix_port.m_fd;
+}
+
+uint32_t PMLIN_posix_time_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t) (ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+void PMLIN_posix_port_write(void *p, uint8_t *buffer, uint16_t len) {
+	PMLIN_posix_port_t *port = p;
+	int fd = port->m_fd;
+	uint16_t n = 0;
+	while (n < len) {
+		ssize_t w = write(fd, (const void*) &buffer[n], len - n);
+		port->m_syscall_count++;
+		if (w > 0)
+			n += w;
+		else if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			return;
+		else {
+			struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+			poll(&pfd, 1, 10);
+			port->m_syscall_count++;
+		}
+	}
+	tcdrain(fd);
+	port->m_syscall_count++;
+}
+
+void PMLIN_posix_write(uint8_t *buffer, uint16_t len) {
+	PMLIN_posix_port_write(&g_PMLIN_posix_port, buffer, len);
+}
+
+uint16_t PMLIN_posix_read(uint8_t *buffer, uint16_t len, uint32_t timeout_us) {
+	return PMLIN_posix_port_read_gap(&g_PMLIN_posix_port, buffer, len, timeout_us, timeout_us);
+}
+
+uint16_t PMLIN_posix_read_gap(uint8_t *buffer, uint16_t len, uint32_t timeout_us, uint32_t gap_us) {
+	return PMLIN_posix_port_read_gap(&g_PMLIN_posix_port, buffer, len, timeout_us, gap_us);
+}
+
+uint16_t PMLIN_posix_port_read_gap(void *p, uint8_t *buffer, uint16_t len, uint32_t timeout_us, uint32_t gap_us) {
+	PMLIN_posix_port_t *port = p;
+	int fd = port->m_fd;
+	uint32_t t0 = PMLIN_posix_time_us();
+	uint32_t t_rx = t0;
+	uint16_t n = 0;
+	while (n < len) {
+		// take everything that has arrived in one go
+		ssize_t r = read(fd, &buffer[n], len - n);
+		port->m_syscall_count++;
+		if (r > 0) {
+			n = PMLIN_posix_port_decode(port, buffer, n, r);
+			t_rx = PMLIN_posix_time_us();
+			continue;
+		}
+		if (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+			break;
+		// one absolute deadline for the whole read, not per byte
+		uint32_t now = PMLIN_posix_time_us();
+		if (now - t0 >= timeout_us)
+			break;
+		uint32_t wait = timeout_us - (now - t0);
+		if (n > 0) { // once data has started to flow also the inter-byte timeout applies
+			if (now - t_rx >= gap_us)
+				break;
+			if (gap_us - (now - t_rx) < wait)
+				wait = gap_us - (now - t_rx);
+		}
+		port->m_syscall_count++;
+		if (PMLIN_posix_wait_readable(fd, wait) < 0 && errno != EINTR)
+			break;
+	}
+	return n;
+}
+
+uint16_t PMLIN_posix_port_decode(PMLIN_posix_port_t *port, uint8_t *buffer, uint16_t n, uint16_t raw_len) {
+	// decoding never produces more bytes than it consumes so this can be done in place
+	uint8_t *raw = &buffer[n];
+	for (uint16_t i = 0; i < raw_len; i++) {
+		uint8_t c = raw[i];
+		switch (port->m_rx_state) {
+		case PMLIN_POSIX_RX_DATA:
+			if (c == 0xFF) {
+				port->m_rx_state = PMLIN_POSIX_RX_ESCAPE;
+				continue;
+			}
+			break;
+		case PMLIN_POSIX_RX_ESCAPE:
+			port->m_rx_state = PMLIN_POSIX_RX_DATA;
+			if (c == 0) {
+				port->m_rx_state = PMLIN_POSIX_RX_ERROR;
+				continue;
+			}
+			break; // \377 \377 is \377
+		case PMLIN_POSIX_RX_ERROR:
+			port->m_rx_state = PMLIN_POSIX_RX_DATA;
+			if (c == 0) { // BREAK, a frame starts here so anything before it is stale
+				port->m_rx_stats.m_break_count++;
+				port->m_rx_stats.m_stale_count += n;
+				port->m_rx_break_seen = true;
+				port->m_rx_synced = true;
+				n = 0;
+				buffer[n++] = 0; // the master expects to read back the BREAK as 0x00
+				continue;
+			}
+			port->m_rx_stats.m_framing_error_count++;
+			break; // pass the char on, the CRC check will reject the frame
+		}
+		if (!port->m_rx_synced) {
+			port->m_rx_stats.m_stale_count++;
+			continue;
+		}
+		buffer[n++] = c;
+	}
+	return n;
+}
+
+void PMLIN_posix_port_resync(PMLIN_posix_port_t *port) {
+	if (port->m_rx_break_seen) {
+		// no need to flush, whatever is received before the BREAK will be dropped
+		port->m_rx_synced = false;
+	} else {
+		tcflush(port->m_fd, TCIFLUSH); // get rid of any extra crap
+		port->m_syscall_count++;
+		port->m_rx_state = PMLIN_POSIX_RX_DATA;
+	}
+}
+
+static uint64_t PMLIN_posix_time_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// sleep until the absolute CLOCK_MONOTONIC time t_ns so that the time taken by the
+// system calls in between does not add to the delay
+static void PMLIN_posix_sleep_until(uint64_t t_ns) {
+#ifdef __linux__
+	struct timespec ts = { .tv_sec = t_ns / 1000000000ULL, .tv_nsec = t_ns % 1000000000ULL };
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+#else
+	uint64_t now = PMLIN_posix_time_ns();
+	if (now < t_ns) {
+		struct timespec ts = { .tv_sec = (t_ns - now) / 1000000000ULL, .tv_nsec = (t_ns - now) % 1000000000ULL };
+		nanosleep(&ts, NULL);
+	}
+#endif
+}
+
+static void PMLIN_posix_set_speed(struct termios *opts, uint32_t baudrate) {
+	cfsetispeed(opts, PMLIN_posix_speed(baudrate));
+	cfsetospeed(opts, PMLIN_posix_speed(baudrate));
+}
+
+// sends a 0x00 char at half the baudrate, works with drivers that do not support TIOCSBRK
+static void PMLIN_posix_send_half_baud_break(PMLIN_posix_port_t *port) {
+	struct termios opts;
+
+	tcgetattr(port->m_fd, &opts);
+	PMLIN_posix_set_speed(&opts, PMLIN_BAUDRATE / 2);
+	tcsetattr(port->m_fd, TCSADRAIN, &opts); // wait for tx queue empty and then set baudrate
+
+	uint8_t break_char = 0;
+	PMLIN_posix_port_write(port, &break_char, 1);
+	// tcdrain() does not realy wait for the break char to be sent with all drivers, hence wait for
+	// the char time (ten bits at half the baudrate) plus some margin before restoring the baudrate
+	PMLIN_posix_sleep_until(PMLIN_posix_time_ns() + 2 * 10 * 2 * 1000000000ULL / PMLIN_BAUDRATE);
+	PMLIN_posix_set_speed(&opts, PMLIN_BAUDRATE);
+	tcsetattr(port->m_fd, TCSADRAIN, &opts);
+	port->m_syscall_count += 4; // the write counts itself
+}
+
+void PMLIN_posix_port_set_break_width(PMLIN_posix_port_t *port, uint32_t break_us) {
+	port->m_break_us = break_us;
+}
+
+void PMLIN_posix_port_set_break_measurement(PMLIN_posix_port_t *port, bool enable) {
+	port->m_measure_break = enable;
+}
+
+void PMLIN_posix_port_get_break_stats(PMLIN_posix_port_t *port, PMLIN_posix_break_stats_t *stats, bool reset) {
+	*stats = port->m_break_stats;
+	if (reset) {
+		PMLIN_posix_break_stats_t zero = { 0 };
+		port->m_break_stats = zero;
+	}
+}
+
+void PMLIN_posix_port_get_rx_stats(PMLIN_posix_port_t *port, PMLIN_posix_rx_stats_t *stats, bool reset) {
+	*stats = port->m_rx_stats;
+	if (reset) {
+		PMLIN_posix_rx_stats_t zero = { 0 };
+		port->m_rx_stats = zero;
+	}
+}
+
+void PMLIN_posix_set_break_width(uint32_t break_us) {
+	PMLIN_posix_port_set_break_width(&g_PMLIN_posix_port, break_us);
+}
+
+void PMLIN_posix_set_break_measurement(bool enable) {
+	PMLIN_posix_port_set_break_measurement(&g_PMLIN_posix_port, enable);
+}
+
+void PMLIN_posix_get_break_stats(PMLIN_posix_break_stats_t *stats, bool reset) {
+	PMLIN_posix_port_get_break_stats(&g_PMLIN_posix_port, stats, reset);
+}
+
+void PMLIN_posix_get_rx_stats(PMLIN_posix_rx_stats_t *stats, bool reset) {
+	PMLIN_posix_port_get_rx_stats(&g_PMLIN_posix_port, stats, reset);
+}
+
+void PMLIN_posix_send_break() {
+	PMLIN_posix_port_send_break(&g_PMLIN_posix_port);
+}
+
+void PMLIN_posix_port_send_break(void *p) {
+	PMLIN_posix_port_t *port = p;
+	uint64_t t0 = PMLIN_posix_time_ns();
+	tcdrain(port->m_fd); // previous frame must be out before the line is pulled down
+	port->m_syscall_count++;
+	PMLIN_posix_port_resync(port);
+	port->m_syscall_count++; // the TIOCSBRK
+
+	uint64_t t_set = 0, t_clr = 0;
+	if (!port->m_no_break_ioctl && ioctl(port->m_fd, TIOCSBRK) == 0) {
+		port->m_syscall_count += 3; // TIOCCBRK and the two sleeps
+		t_set = PMLIN_posix_time_ns();
+		PMLIN_posix_sleep_until(t_set + port->m_break_us * 1000ULL);
+		ioctl(port->m_fd, TIOCCBRK);
+		t_clr = PMLIN_posix_time_ns();
+		// line must stay idle (mark) for a while after the break before the header start bit
+		PMLIN_posix_sleep_until(t_clr + PMLIN_POSIX_BREAK_DELIMITER_BITS * 1000000000ULL / PMLIN_BAUDRATE);
+	} else {
+		port->m_no_break_ioctl = true; // do not try again
+		PMLIN_posix_send_half_baud_break(port);
+	}
+
+	if (port->m_measure_break) {
+		PMLIN_posix_break_stats_t *st = &port->m_break_stats;
+		uint32_t overhead = (PMLIN_posix_time_ns() - t0) / 1000;
+		if (t_clr) {
+			uint32_t width = (t_clr - t_set) / 1000;
+			if (width < st->m_width_min_us || st->m_width_count == 0)
+				st->m_width_min_us = width;
+			if (width > st->m_width_max_us)
+				st->m_width_max_us = width;
+			st->m_width_total_us += width;
+			st->m_width_count++;
+		} else
+			st->m_fallback_count++;
+		if (overhead > st->m_overhead_max_us)
+			st->m_overhead_max_us = overhead;
+		st->m_overhead_total_us += overhead;
+		st->m_count++;
+	}
+}
+
+void PMLIN_posix_notify_fd(struct PMLIN_mirror_def_t *mirror, void *user) {
+	if (mirror)
+		return;
+	uint64_t one = 1;
+	if (write((int) (intptr_t) user, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN)
+		perror("PMLIN_posix_notify_fd");
+}
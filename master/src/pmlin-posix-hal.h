@@ -0,0 +1,199 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef __PMLIN_POSIX_HAL_H__
+#define	__PMLIN_POSIX_HAL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Hardware Abstraction Layer (HAL) implementation for POSIX compatible systems.
+//
+// Pass PMLIN_posix_send_break, PMLIN_posix_write and PMLIN_posix_read to PMLIN_initialize_master,
+// PMLIN_posix_read_gap to PMLIN_set_read_gap_callback and PMLIN_posix_get_fd and PMLIN_posix_time_us
+// to PMLIN_initialize_nonblocking.
+//
+// For multiple buses open each port with PMLIN_posix_port_open and pass PMLIN_POSIX_HAL(port)
+// to PMLIN_master_initialize. The functions that do not take a port operate on a default port.
+
+// Purpose: Open and configure the serial port for PMLIN use
+// Parameters:
+//		port_name (in)		Path to the serial port device, for example "/dev/ttyUSB0"
+// Returns:					The file descriptor, or -1 on failure in which case errno tells why
+
+int PMLIN_posix_open_serial_port(const char *port_name);
+
+// Purpose: Returns the file descriptor of the serial port opened with PMLIN_posix_open_serial_port
+
+int PMLIN_posix_get_fd();
+
+#define PMLIN_POSIX_BREAK_US 600 // default BREAK width in micro seconds, must be longer than 11 bit times
+#define PMLIN_POSIX_BREAK_DELIMITER_BITS 2 // idle time after the BREAK before the header is sent, in bit times
+
+// this structure holds the BREAK timing measurements, all times in micro seconds
+typedef struct PMLIN_posix_break_stats_t {
+	uint32_t m_count; // number of BREAKs sent
+	uint32_t m_fallback_count; // number of BREAKs sent with the half baudrate trick (no width measured)
+	uint32_t m_width_count; // number of BREAK widths measured
+	uint32_t m_width_min_us; // shortest time between setting and clearing the BREAK
+	uint32_t m_width_max_us; // longest time between setting and clearing the BREAK
+	uint64_t m_width_total_us; // sum of the measured widths
+	uint32_t m_overhead_max_us; // longest time spent in PMLIN_posix_send_break
+	uint64_t m_overhead_total_us; // total time spent in PMLIN_posix_send_break
+} PMLIN_posix_break_stats_t;
+
+// this structure holds the receive statistics
+typedef struct PMLIN_posix_rx_stats_t {
+	uint32_t m_break_count; // number of BREAKs received
+	uint32_t m_framing_error_count; // number of chars received with a framing error
+	uint32_t m_stale_count; // number of bytes dropped because they were received before the BREAK of the frame
+} PMLIN_posix_rx_stats_t;
+
+// this structure holds one serial port, all fields are private to the HAL
+typedef struct PMLIN_posix_port_t {
+	int m_fd;
+	uint32_t m_break_us;
+	bool m_no_break_ioctl; // set if the driver does not support TIOCSBRK
+	bool m_measure_break;
+	PMLIN_posix_break_stats_t m_break_stats;
+	uint8_t m_rx_state; // PARMRK escape sequence decoding state
+	bool m_rx_break_seen; // set once a BREAK has been received, i.e. the driver reports BREAKs
+	bool m_rx_synced; // set when the BREAK of the current frame has been received
+	PMLIN_posix_rx_stats_t m_rx_stats;
+	uint32_t m_syscall_count; // number of system calls made, for comparing the HALs
+} PMLIN_posix_port_t;
+
+// Purpose: Open and configure a serial port for use with PMLIN_master_initialize
+// Parameters:
+//		port (out)			The port to initialize
+//		port_name (in)		Path to the serial port device, for example "/dev/ttyUSB0"
+// Returns:					The file descriptor, or -1 on failure in which case errno tells why
+
+int PMLIN_posix_port_open(PMLIN_posix_port_t *port, const char *port_name);
+
+// PMLIN_hal_xxx_fp implementations taking a PMLIN_posix_port_t, otherwise as the functions below
+void PMLIN_posix_port_send_break(void *port);
+void PMLIN_posix_port_write(void *port, uint8_t *buffer, uint16_t len);
+uint16_t PMLIN_posix_port_read_gap(void *port, uint8_t *buffer, uint16_t len, uint32_t timeout_us, uint32_t gap_us);
+void PMLIN_posix_port_set_break_width(PMLIN_posix_port_t *port, uint32_t break_us);
+void PMLIN_posix_port_set_break_measurement(PMLIN_posix_port_t *port, bool enable);
+void PMLIN_posix_port_get_break_stats(PMLIN_posix_port_t *port, PMLIN_posix_break_stats_t *stats, bool reset);
+void PMLIN_posix_port_get_rx_stats(PMLIN_posix_port_t *port, PMLIN_posix_rx_stats_t *stats, bool reset);
+
+// Purpose: Prepare the receive side for a new frame, called before the BREAK is sent
+//		If the driver reports BREAKs bytes are dropped until the BREAK is received,
+//		otherwise whatever is in the input buffer is flushed.
+//		For HALs built on top of PMLIN_posix_port_t, such as pmlin-uring-hal.c.
+
+void PMLIN_posix_port_resync(PMLIN_posix_port_t *port);
+
+// Purpose: Decode bytes read from the serial port
+//		The port is configured with PARMRK so a BREAK is received as \377 \0 \0, a char with a framing
+//		error as \377 \0 char and \377 as \377 \377. A BREAK is passed on as a single 0x00 and drops
+//		any bytes decoded before it. Escape sequences may be split between calls.
+//		For HALs built on top of PMLIN_posix_port_t, such as pmlin-uring-hal.c.
+// Parameters:
+//		buffer (in/out)		Decoded bytes followed by the raw bytes to decode, decoded in place
+//		n (in)				Number of already decoded bytes in the buffer
+//		raw_len (in)		Number of raw bytes following them
+// Returns:					Number of decoded bytes in the buffer
+
+uint16_t PMLIN_posix_port_decode(PMLIN_posix_port_t *port, uint8_t *buffer, uint16_t n, uint16_t raw_len);
+
+// macro used to define the HAL for PMLIN_master_initialize
+#define PMLIN_POSIX_HAL(port) PMLIN_HAL(PMLIN_posix_port_send_break, PMLIN_posix_port_write, PMLIN_posix_port_read_gap, port)
+
+// Purpose: PMLIN_send_break_fp implementation
+//		Uses TIOCSBRK/TIOCCBRK with the BREAK width timed against CLOCK_MONOTONIC, if the serial driver
+//		does not support those falls back to sending a 0x00 char at half the baudrate.
+
+void PMLIN_posix_send_break();
+
+// Purpose: Set the BREAK width
+// Parameters:
+//		break_us (in)		BREAK width in micro seconds, default is PMLIN_POSIX_BREAK_US
+
+void PMLIN_posix_set_break_width(uint32_t break_us);
+
+// Purpose: Turn the BREAK timing measurement on or off
+// Parameters:
+//		enable (in)			If true PMLIN_posix_send_break collects statistics of achieved BREAK
+//							widths and the time spent per frame sending the BREAK
+
+void PMLIN_posix_set_break_measurement(bool enable);
+
+// Purpose: Get the BREAK timing statistics
+// Parameters:
+//		stats (out)			Pointer to structure to receive the statistics
+//		reset (in)			If true the statistics are zeroed after taking the snapshot
+
+void PMLIN_posix_get_break_stats(PMLIN_posix_break_stats_t *stats, bool reset);
+
+// Purpose: Get the receive statistics
+// Parameters:
+//		stats (out)			Pointer to structure to receive the statistics
+//		reset (in)			If true the statistics are zeroed after taking the snapshot
+
+void PMLIN_posix_get_rx_stats(PMLIN_posix_rx_stats_t *stats, bool reset);
+
+// Purpose: PMLIN_write_fp implementation, blocks until the data has been sent
+
+void PMLIN_posix_write(uint8_t *buffer, uint16_t len);
+
+// Purpose: PMLIN_read_fp implementation
+//		Reads whatever is available in as large chunks as possible until len bytes have been
+//		received or timeout_us micro seconds, counted from the call, have elapsed.
+//		With zero timeout returns immediately with what has already been received.
+
+uint16_t PMLIN_posix_read(uint8_t *buffer, uint16_t len, uint32_t timeout_us);
+
+// Purpose: PMLIN_read_gap_fp implementation
+//		As PMLIN_posix_read but also returns if no more data arrives within gap_us after the latest data
+
+uint16_t PMLIN_posix_read_gap(uint8_t *buffer, uint16_t len, uint32_t timeout_us, uint32_t gap_us);
+
+// Purpose: PMLIN_time_us_fp implementation, CLOCK_MONOTONIC in micro seconds
+
+uint32_t PMLIN_posix_time_us();
+
+// Purpose: PMLIN_mirror_changed_fp implementation that signals a file descriptor once per tick with changes
+//		Pass an eventfd (or the write end of a pipe) cast to a pointer as the user argument of
+//		PMLIN_set_mirror_changed_callback, for example (void*)(intptr_t)eventfd(0, EFD_NONBLOCK).
+//		A 64 bit one is written to the descriptor after the last changed entry of the tick, so a poll()
+//		loop wakes up once per tick no matter how many entries changed.
+
+struct PMLIN_mirror_def_t;
+void PMLIN_posix_notify_fd(struct PMLIN_mirror_def_t *mirror, void *user);
+
+#endif
@@ -0,0 +1,91 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "pmlin-sample-ring.h"
+
+#include <time.h>
+
+uint64_t PMLIN_sample_ring_time_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void PMLIN_sample_ring_push(PMLIN_sample_ring_t *ring, uint64_t time_ns, volatile const uint8_t *data, uint16_t length) {
+	unsigned n = atomic_load_explicit(&ring->m_head, memory_order_relaxed);
+	PMLIN_sample_slot_t *slot = &ring->m_slots[n % ring->m_capacity];
+	volatile uint8_t *dst = &ring->m_data[(n % ring->m_capacity) * ring->m_length];
+	// same sequence lock protocol as pmlin-mirror-buffer.c, with the sample number in the sequence
+	atomic_store_explicit(&slot->m_seq, 2 * n + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	slot->m_time_ns = time_ns;
+	for (uint16_t i = 0; i < ring->m_length; i++)
+		dst[i] = i < length ? data[i] : 0;
+	atomic_store_explicit(&slot->m_seq, 2 * n + 2, memory_order_release);
+	atomic_store_explicit(&ring->m_head, n + 1, memory_order_release);
+}
+
+uint32_t PMLIN_sample_ring_head(PMLIN_sample_ring_t *ring) {
+	return atomic_load_explicit(&ring->m_head, memory_order_acquire);
+}
+
+uint32_t PMLIN_sample_ring_read(PMLIN_sample_ring_t *ring, uint32_t *cursor, uint64_t times_ns[], void *data,
+		uint32_t max_samples, uint32_t *lost) {
+	uint32_t head = atomic_load_explicit(&ring->m_head, memory_order_acquire);
+	uint32_t n = *cursor;
+	uint32_t lost_count = 0;
+	if (head - n > ring->m_capacity) { // the oldest wanted samples have already been overwritten
+		lost_count = head - n - ring->m_capacity;
+		n = head - ring->m_capacity;
+	}
+	uint32_t count = 0;
+	for (; n != head && count < max_samples; n++) {
+		PMLIN_sample_slot_t *slot = &ring->m_slots[n % ring->m_capacity];
+		volatile uint8_t *src = &ring->m_data[(n % ring->m_capacity) * ring->m_length];
+		uint8_t *dst = (uint8_t*) data + count * ring->m_length;
+		unsigned seq = atomic_load_explicit(&slot->m_seq, memory_order_acquire);
+		uint64_t time_ns = slot->m_time_ns;
+		for (uint16_t i = 0; i < ring->m_length; i++)
+			dst[i] = src[i];
+		atomic_thread_fence(memory_order_acquire);
+		if (seq != 2 * n + 2 || atomic_load_explicit(&slot->m_seq, memory_order_relaxed) != seq) {
+			lost_count++; // overwritten while we were getting to it
+			continue;
+		}
+		times_ns[count++] = time_ns;
+	}
+	*cursor = n;
+	if (lost)
+		*lost = lost_count;
+	return count;
+}
@@ -0,0 +1,109 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __PMLIN_SAMPLE_RING_H__
+#define	__PMLIN_SAMPLE_RING_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Optional history of the payloads received by PMLIN_SLAVE_TO_HOST mirroring.
+//
+// A sample ring keeps the latest samples of a mirroring entry, each time stamped with the CLOCK_MONOTONIC
+// time in nano seconds when the frame was complete, see PMLIN_sample_ring_time_ns.
+// The ring is written only by the thread calling PMLIN_mirror_tick and never allocates. Any number of
+// readers can read it at the same time without locks: each sample slot carries a sequence number that
+// tells which sample it holds, so a reader detects a slot being overwritten and drops that sample.
+// Each reader keeps its own cursor, the number of the next sample it wants.
+
+// this structure holds the time stamp of one sample, all fields are private to PMLIN master code
+typedef struct PMLIN_sample_slot_t {
+	atomic_uint m_seq; // 2 * (sample number + 1) when complete, odd while being written
+	uint64_t m_time_ns; // time stamp of the sample
+} PMLIN_sample_slot_t;
+
+// this structure holds one sample ring, all fields are private to PMLIN master code
+typedef struct PMLIN_sample_ring_t {
+	atomic_uint m_head; // number of samples written so far i.e. the number of the next sample
+	uint32_t m_capacity; // number of slots
+	uint16_t m_length; // payload length
+	PMLIN_sample_slot_t *m_slots; // m_capacity slots
+	volatile uint8_t *m_data; // m_capacity * m_length bytes of payloads
+} PMLIN_sample_ring_t;
+
+// macro used to declare and define a sample ring, slots is an array of capacity PMLIN_sample_slot_t and data
+// an array of at least capacity * length bytes, length must be the payload length of the mirrored message
+#define PMLIN_SAMPLE_RING(slots, data, capacity, length) ((PMLIN_sample_ring_t) { \
+	.m_head = 0, \
+	.m_capacity = capacity, \
+	.m_length = length, \
+	.m_slots = slots, \
+	.m_data = (volatile uint8_t *)data \
+	})
+
+// Purpose: Add a sample, only called by PMLIN master code
+// Parameters:
+//		ring (in/out)		The ring
+//		time_ns (in)		Time stamp of the sample, see PMLIN_sample_ring_time_ns
+//		data (in)			Payload
+//		length (in)			Payload length, cut or zero padded to the length of the ring
+
+void PMLIN_sample_ring_push(PMLIN_sample_ring_t *ring, uint64_t time_ns, volatile const uint8_t *data, uint16_t length);
+
+// Purpose: Returns the current CLOCK_MONOTONIC time in nano seconds, the time base of the sample time stamps
+//		The time stamps do not depend on the time source given to PMLIN_initialize_nonblocking and do not wrap.
+
+uint64_t PMLIN_sample_ring_time_ns();
+
+// Purpose: Returns the number of the next sample to be written, i.e. the number of samples written so far
+//		Start a reader cursor from this to get only new samples, or from this minus the capacity to get
+//		all the samples still in the ring.
+
+uint32_t PMLIN_sample_ring_head(PMLIN_sample_ring_t *ring);
+
+// Purpose: Read the samples from a cursor onwards
+// Parameters:
+//		ring (in)			The ring
+//		cursor (in/out)		Number of the next sample to read, advanced past the samples read and lost
+//		times_ns[] (out)	Pointer to an array of max_samples elements to receive the time stamps
+//		data (out)			Pointer to max_samples * payload length bytes to receive the payloads
+//		max_samples (in)	Maximum number of samples to read
+//		lost (out)			Pointer (can be NULL) to receive the number of samples that were overwritten
+//							before they could be read
+// Returns:					Number of samples read, oldest first
+
+uint32_t PMLIN_sample_ring_read(PMLIN_sample_ring_t *ring, uint32_t *cursor, uint64_t times_ns[], void *data,
+		uint32_t max_samples, uint32_t *lost);
+
+#endif
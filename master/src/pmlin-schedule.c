@@ -0,0 +1,170 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "pmlin-schedule.h"
+
+#include <stdlib.h>
+
+// The schedule repeats every hyperperiod ticks, the least common multiple of the periods. The bus time
+// of each tick of the hyperperiod is accumulated in load[]. Entries are placed the shortest period first
+// and within the same period the longest airtime first, each at the phase that gives the lightest busiest
+// tick, ties broken by the least variation of the load ahead of the entry.
+
+typedef struct {
+	uint32_t m_index;
+	uint32_t m_airtime_us;
+	uint16_t m_period;
+} PMLIN_schedule_item_t;
+
+static int PMLIN_schedule_order(const void *a, const void *b) {
+	const PMLIN_schedule_item_t *x = a, *y = b;
+	if (x->m_period != y->m_period)
+		return x->m_period < y->m_period ? -1 : 1;
+	if (x->m_airtime_us != y->m_airtime_us)
+		return x->m_airtime_us > y->m_airtime_us ? -1 : 1;
+	return x->m_index < y->m_index ? -1 : 1;
+}
+
+static uint64_t PMLIN_gcd(uint64_t a, uint64_t b) {
+	while (b) {
+		uint64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+PMLIN_error_t PMLIN_master_compile_schedule(PMLIN_master_t *m, PMLIN_mirror_def_t mirroring[], uint32_t num_mirroring,
+		PMLIN_schedule_entry_t entries[], PMLIN_schedule_report_t *report) {
+	PMLIN_schedule_report_t rep = { .m_hyperperiod = 1 };
+	uint64_t hyperperiod = 1;
+	for (uint32_t i = 0; i < num_mirroring; i++) {
+		uint16_t period = mirroring[i].m_tick_period;
+		if (period == 0 || rep.m_truncated)
+			continue;
+		hyperperiod = hyperperiod / PMLIN_gcd(hyperperiod, period) * period;
+		if (hyperperiod > PMLIN_SCHEDULE_MAX_TICKS) {
+			hyperperiod = PMLIN_SCHEDULE_MAX_TICKS;
+			rep.m_truncated = true;
+		}
+	}
+	uint32_t h = rep.m_hyperperiod = hyperperiod;
+
+	uint32_t *load = calloc(h, sizeof(uint32_t));
+	PMLIN_schedule_item_t *items = malloc((num_mirroring ? num_mirroring : 1) * sizeof(PMLIN_schedule_item_t));
+	if (!load || !items) {
+		free(load);
+		free(items);
+		return PMLIN_NO_MEMORY_ERROR;
+	}
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < num_mirroring; i++) {
+		PMLIN_mirror_def_t *mirror = &mirroring[i];
+		if (mirror->m_tick_period == 0)
+			continue;
+		items[n].m_index = i;
+		items[n].m_period = mirror->m_tick_period;
+		items[n].m_airtime_us = PMLIN_master_message_airtime_us(m, mirror->m_device_id, mirror->m_message_type);
+		n++;
+	}
+	qsort(items, n, sizeof(items[0]), PMLIN_schedule_order);
+
+	for (uint32_t k = 0; k < n; k++) {
+		uint16_t period = items[k].m_period;
+		uint16_t best_slot = 0;
+		uint32_t best_max = UINT32_MAX, best_spread = UINT32_MAX;
+		for (uint16_t slot = 0; slot < period && slot < h; slot++) {
+			uint32_t max = 0, min = UINT32_MAX;
+			for (uint32_t j = slot; j < h; j += period) {
+				if (load[j] > max)
+					max = load[j];
+				if (load[j] < min)
+					min = load[j];
+			}
+			if (max < best_max || (max == best_max && max - min < best_spread)) {
+				best_slot = slot;
+				best_max = max;
+				best_spread = max - min;
+			}
+		}
+		for (uint32_t j = best_slot; j < h; j += period)
+			load[j] += items[k].m_airtime_us;
+		// tick number t transfers the entry when t % m_tick_period == (m_tick_period - m_tick_phase) % m_tick_period
+		mirroring[items[k].m_index].m_tick_phase = (period - best_slot) % period;
+	}
+
+	free(items);
+
+	// the transfers of a tick take place in array order, so the latency of an entry is the airtime
+	// of the entries before it in the same tick plus its own
+	for (uint32_t j = 0; j < h; j++)
+		load[j] = 0;
+	for (uint32_t i = 0; i < num_mirroring; i++) {
+		PMLIN_mirror_def_t *mirror = &mirroring[i];
+		uint16_t period = mirror->m_tick_period;
+		uint32_t airtime = PMLIN_master_message_airtime_us(m, mirror->m_device_id, mirror->m_message_type);
+		uint32_t best = UINT32_MAX, worst = 0;
+		if (period) {
+			for (uint32_t j = (period - mirror->m_tick_phase) % period; j < h; j += period) {
+				load[j] += airtime;
+				if (load[j] < best)
+					best = load[j];
+				if (load[j] > worst)
+					worst = load[j];
+			}
+		}
+		if (entries) {
+			entries[i].m_airtime_us = airtime;
+			entries[i].m_best_latency_us = best == UINT32_MAX ? 0 : best;
+			entries[i].m_worst_latency_us = worst;
+		}
+	}
+	for (uint32_t j = 0; j < h; j++) {
+		if (load[j] > rep.m_max_tick_load_us)
+			rep.m_max_tick_load_us = load[j];
+		if (load[j] > m->m_tick_period_us)
+			rep.m_overloaded_ticks++;
+	}
+	free(load);
+	if (report)
+		*report = rep;
+
+	if (rep.m_overloaded_ticks)
+		return PMLIN_OVERLOAD_ERROR;
+	return PMLIN_master_define_mirroring(m, mirroring, num_mirroring);
+}
+
+PMLIN_error_t PMLIN_compile_schedule(PMLIN_mirror_def_t mirroring[], uint32_t num_mirroring, PMLIN_schedule_entry_t entries[],
+		PMLIN_schedule_report_t *report) {
+	return PMLIN_master_compile_schedule(PMLIN_default_master(), mirroring, num_mirroring, entries, report);
+}
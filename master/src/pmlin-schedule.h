@@ -0,0 +1,92 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __PMLIN_SCHEDULE_H__
+#define	__PMLIN_SCHEDULE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pmlin-master.h"
+
+// Mirroring schedule compiler.
+//
+// Instead of hand picking m_tick_phase for each PMLIN_MIRROR_DEF, declare the mirroring with the desired
+// m_tick_period only and let PMLIN_compile_schedule assign the phases. The phases are chosen so that the
+// transfers are spread evenly over the ticks: the busiest tick is kept as light as possible and each entry
+// is placed where the transfers ahead of it in its tick vary the least, i.e. with minimum jitter.
+// The frame lengths come from the devices declared with PMLIN_define_devices.
+
+#define PMLIN_SCHEDULE_MAX_TICKS 65536 // the schedule is analysed over at most this many ticks
+
+// this structure holds the schedule analysis of one mirroring entry
+typedef struct PMLIN_schedule_entry_t {
+	uint32_t m_airtime_us; // how long one transfer occupies the bus, see PMLIN_message_airtime_us
+	uint32_t m_best_latency_us; // shortest time from the tick to the end of the transfer
+	uint32_t m_worst_latency_us; // longest time from the tick to the end of the transfer
+} PMLIN_schedule_entry_t;
+
+// this structure holds the schedule analysis of a whole mirroring table
+typedef struct PMLIN_schedule_report_t {
+	uint32_t m_hyperperiod; // number of ticks after which the schedule repeats
+	bool m_truncated; // the hyperperiod exceeds PMLIN_SCHEDULE_MAX_TICKS, only that many ticks were analysed
+	uint32_t m_max_tick_load_us; // bus time needed by the busiest tick
+	uint32_t m_overloaded_ticks; // number of ticks in the hyperperiod whose transfers do not fit into the tick period
+} PMLIN_schedule_report_t;
+
+// Purpose: Assign m_tick_phase of each mirroring entry and define the mirroring with PMLIN_define_mirroring
+//		The devices must have been declared with PMLIN_define_devices. Entries whose device or message is
+//		not declared are scheduled as taking no bus time. Entries are still transferred in array order
+//		within a tick, so put the entries with the tightest latency requirement first.
+// Parameters:
+//		mirroring[] (in/out)	An permanently allocated array of mirroring definitions, m_tick_phase is overwritten
+//		num_mirroring (in)		Size of the mirroring[] array
+//		entries[] (out)			Pointer (can be NULL) to an array of num_mirroring elements to receive the analysis of each entry
+//		report (out)			Pointer (can be NULL) to receive the analysis of the whole schedule
+// Returns:						Error code
+//		PMLIN_OK
+//		PMLIN_OVERLOAD_ERROR	Some ticks need more bus time than the tick period, see PMLIN_set_tick_period_us,
+//								the mirroring was not defined, the previous one is kept, entries[] and report are filled in
+//		PMLIN_UTILIZATION_WARNING	See PMLIN_define_mirroring
+//		PMLIN_NO_MEMORY_ERROR	The mirroring was not defined
+
+PMLIN_error_t PMLIN_compile_schedule(PMLIN_mirror_def_t mirroring[], uint32_t num_mirroring, PMLIN_schedule_entry_t entries[],
+		PMLIN_schedule_report_t *report);
+
+// As above but for a given bus
+PMLIN_error_t PMLIN_master_compile_schedule(PMLIN_master_t *m, PMLIN_mirror_def_t mirroring[], uint32_t num_mirroring,
+		PMLIN_schedule_entry_t entries[], PMLIN_schedule_report_t *report);
+
+// Given a global array of PMLIN_mirror_def_t this calls PMLIN_compile_schedule, used to make code more readable
+#define PMLIN_COMPILE_SCHEDULE(mirroring_array, entries, report) PMLIN_compile_schedule(mirroring_array,sizeof(mirroring_array)/sizeof(mirroring_array[0]),entries,report)
+
+#endif
@@ -0,0 +1,235 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef __linux__
+#define _GNU_SOURCE // for pthread_setaffinity_np()
+#endif
+
+#include "pmlin-tick-driver.h"
+
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
+
+static uint64_t PMLIN_tick_time_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+// waits for the next grid time, returns the number of grid times passed since the previous call, 0 if interrupted
+static uint64_t PMLIN_tick_wait(PMLIN_tick_driver_t *driver) {
+	uint64_t expirations = 0;
+#ifdef __linux__
+	// the timer runs on the absolute grid set up in PMLIN_tick_driver_start and counts the expirations we miss
+	if (read(driver->m_timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+		return 0;
+#else
+	uint64_t now = PMLIN_tick_time_us();
+	if (now < driver->m_grid_us) {
+		uint64_t wait = driver->m_grid_us - now;
+		struct timespec sleep = { wait / 1000000, (wait % 1000000) * 1000L };
+		if (nanosleep(&sleep, NULL))
+			return 0;
+		now = PMLIN_tick_time_us();
+		if (now < driver->m_grid_us)
+			return 0;
+	}
+	expirations = 1 + (now - driver->m_grid_us) / driver->m_config.m_period_us;
+#endif
+	return expirations;
+}
+
+static void PMLIN_tick_realtime_setup(PMLIN_tick_driver_t *driver) {
+	bool realtime = false, pinned = false;
+	if (driver->m_config.m_priority > 0) {
+		struct sched_param param = { .sched_priority = driver->m_config.m_priority };
+		realtime = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+	}
+#ifdef __linux__
+	if (driver->m_config.m_cpu >= 0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(driver->m_config.m_cpu, &cpus);
+		pinned = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+	}
+#endif
+	pthread_mutex_lock(&driver->m_stats_mutex);
+	driver->m_stats.m_realtime = realtime;
+	driver->m_stats.m_pinned = pinned;
+	pthread_mutex_unlock(&driver->m_stats_mutex);
+}
+
+static void PMLIN_tick_account(PMLIN_tick_driver_t *driver, uint64_t expirations, uint64_t grid, uint64_t start,
+		uint64_t end, PMLIN_error_t res) {
+	PMLIN_tick_stats_t *s = &driver->m_stats;
+	uint64_t lateness = start - grid;
+	uint64_t duration = end - start;
+	pthread_mutex_lock(&driver->m_stats_mutex);
+	s->m_ticks++;
+	s->m_missed += expirations - 1;
+	if (lateness > driver->m_config.m_late_us)
+		s->m_late++;
+	if (res != PMLIN_OK)
+		s->m_errors++;
+	if (lateness > s->m_max_lateness_us)
+		s->m_max_lateness_us = lateness;
+	if (duration > s->m_max_duration_us)
+		s->m_max_duration_us = duration;
+	if (driver->m_have_prev) {
+		// compared to the intended interval, which spans the missed ticks
+		uint64_t interval = start - driver->m_prev_start_us;
+		uint64_t intended = expirations * driver->m_config.m_period_us;
+		uint64_t jitter = interval > intended ? interval - intended : intended - interval;
+		uint64_t bucket = jitter / PMLIN_TICK_JITTER_BUCKET_US;
+		driver->m_jitter[bucket < PMLIN_TICK_JITTER_BUCKETS ? bucket : PMLIN_TICK_JITTER_BUCKETS - 1]++;
+		if (jitter > s->m_jitter_max_us)
+			s->m_jitter_max_us = jitter;
+	}
+	driver->m_prev_start_us = start;
+	driver->m_have_prev = true;
+	pthread_mutex_unlock(&driver->m_stats_mutex);
+}
+
+static void* PMLIN_tick_thread_fun(void *arguments) {
+	PMLIN_tick_driver_t *driver = arguments;
+	PMLIN_tick_realtime_setup(driver);
+	while (!atomic_load(&driver->m_stop)) {
+		uint64_t expirations = PMLIN_tick_wait(driver);
+		if (!expirations || atomic_load(&driver->m_stop))
+			continue;
+		// run only the latest tick due, the ones before it are missed
+		uint64_t grid = driver->m_grid_us + (expirations - 1) * driver->m_config.m_period_us;
+		driver->m_grid_us = grid + driver->m_config.m_period_us;
+		uint64_t start = PMLIN_tick_time_us();
+		PMLIN_error_t res = PMLIN_master_mirror_tick(driver->m_master, NULL);
+		PMLIN_tick_account(driver, expirations, grid, start, PMLIN_tick_time_us(), res);
+	}
+	return NULL;
+}
+
+PMLIN_error_t PMLIN_tick_driver_start(PMLIN_tick_driver_t *driver, PMLIN_master_t *m, const PMLIN_tick_config_t *config) {
+	if (atomic_load(&driver->m_running))
+		return PMLIN_OK;
+	if (!config->m_period_us)
+		return PMLIN_NO_INITIALIZED_ERROR;
+	driver->m_master = m ? m : PMLIN_default_master();
+	driver->m_config = *config;
+	if (!driver->m_config.m_late_us)
+		driver->m_config.m_late_us = config->m_period_us / 4;
+	memset(&driver->m_stats, 0, sizeof(driver->m_stats));
+	memset(driver->m_jitter, 0, sizeof(driver->m_jitter));
+	driver->m_have_prev = false;
+	pthread_mutex_init(&driver->m_stats_mutex, NULL);
+	atomic_store(&driver->m_stop, false);
+	PMLIN_master_set_tick_period_us(driver->m_master, config->m_period_us);
+	if (config->m_lock_memory)
+		driver->m_stats.m_memory_locked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+
+	driver->m_grid_us = PMLIN_tick_time_us() + config->m_period_us;
+	driver->m_timer_fd = -1;
+#ifdef __linux__
+	driver->m_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	if (driver->m_timer_fd < 0)
+		return PMLIN_NO_INITIALIZED_ERROR;
+	struct itimerspec spec = { //
+			.it_interval = { config->m_period_us / 1000000, (config->m_period_us % 1000000) * 1000L }, //
+			.it_value = { driver->m_grid_us / 1000000, (driver->m_grid_us % 1000000) * 1000L } //
+			};
+	if (timerfd_settime(driver->m_timer_fd, TFD_TIMER_ABSTIME, &spec, NULL)) {
+		close(driver->m_timer_fd);
+		return PMLIN_NO_INITIALIZED_ERROR;
+	}
+#endif
+	if (pthread_create(&driver->m_thread, NULL, PMLIN_tick_thread_fun, driver)) {
+		if (driver->m_timer_fd >= 0)
+			close(driver->m_timer_fd);
+		return PMLIN_NO_INITIALIZED_ERROR;
+	}
+	atomic_store(&driver->m_running, true);
+	return PMLIN_OK;
+}
+
+void PMLIN_tick_driver_stop(PMLIN_tick_driver_t *driver) {
+	if (!atomic_load(&driver->m_running))
+		return;
+	atomic_store(&driver->m_running, false);
+	atomic_store(&driver->m_stop, true); // seen by the thread at the latest when the next tick is due
+	pthread_join(driver->m_thread, NULL);
+	if (driver->m_timer_fd >= 0)
+		close(driver->m_timer_fd);
+}
+
+// the upper bound of the histogram bucket that holds the given fraction (in 1/1000) of the samples
+static uint32_t PMLIN_tick_percentile(PMLIN_tick_driver_t *driver, uint64_t total, uint32_t permille) {
+	uint64_t count = 0;
+	for (uint32_t i = 0; i < PMLIN_TICK_JITTER_BUCKETS - 1; i++) {
+		count += driver->m_jitter[i];
+		if (count * 1000 >= total * permille) {
+			uint32_t upper = (i + 1) * PMLIN_TICK_JITTER_BUCKET_US;
+			return upper < driver->m_stats.m_jitter_max_us ? upper : driver->m_stats.m_jitter_max_us;
+		}
+	}
+	return driver->m_stats.m_jitter_max_us;
+}
+
+void PMLIN_tick_driver_get_stats(PMLIN_tick_driver_t *driver, PMLIN_tick_stats_t *stats, bool reset) {
+	pthread_mutex_lock(&driver->m_stats_mutex);
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < PMLIN_TICK_JITTER_BUCKETS; i++)
+		total += driver->m_jitter[i];
+	PMLIN_tick_stats_t *s = &driver->m_stats;
+	if (total) {
+		s->m_jitter_p50_us = PMLIN_tick_percentile(driver, total, 500);
+		s->m_jitter_p99_us = PMLIN_tick_percentile(driver, total, 990);
+		s->m_jitter_p999_us = PMLIN_tick_percentile(driver, total, 999);
+	}
+	*stats = *s;
+	if (reset) {
+		// the real-time setup is not a statistic
+		bool realtime = s->m_realtime, memory_locked = s->m_memory_locked, pinned = s->m_pinned;
+		memset(s, 0, sizeof(*s));
+		s->m_realtime = realtime;
+		s->m_memory_locked = memory_locked;
+		s->m_pinned = pinned;
+		memset(driver->m_jitter, 0, sizeof(driver->m_jitter));
+		driver->m_have_prev = false;
+	}
+	pthread_mutex_unlock(&driver->m_stats_mutex);
+}
@@ -0,0 +1,126 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __PMLIN_TICK_DRIVER_H__
+#define	__PMLIN_TICK_DRIVER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "pmlin-master.h"
+
+// Optional mirror tick thread for POSIX systems.
+//
+// The thread calls PMLIN_master_mirror_tick on a fixed grid of absolute CLOCK_MONOTONIC times (a timerfd
+// on Linux), so a slow tick delays only itself and not the ticks after it. A tick that overruns the next
+// grid time makes the thread skip the ticks it missed instead of bunching them up, the skipped ticks are
+// counted. The thread can optionally be made real-time: SCHED_FIFO, memory locked and pinned to a CPU.
+// Each tick is timed against its grid time and the tick-to-tick jitter is collected into a histogram.
+
+#define PMLIN_TICK_JITTER_BUCKETS 1000 // jitter histogram size, the last bucket holds everything beyond
+#define PMLIN_TICK_JITTER_BUCKET_US 10 // jitter histogram resolution in micro seconds
+
+// this structure holds the configuration of a tick driver
+typedef struct PMLIN_tick_config_t {
+	uint32_t m_period_us; // tick period, also passed to PMLIN_master_set_tick_period_us
+	uint32_t m_late_us; // a tick starting more than this after its grid time is late, 0 means a quarter of the period
+	int m_priority; // SCHED_FIFO priority of the thread, 0 leaves the scheduling as it is
+	int m_cpu; // CPU the thread is pinned to, -1 leaves it free (Linux only)
+	bool m_lock_memory; // lock all the memory of the process with mlockall to avoid page faults
+} PMLIN_tick_config_t;
+
+// macro used to declare and define a tick driver configuration with just the period
+#define PMLIN_TICK_CONFIG(period_us) ((PMLIN_tick_config_t) { \
+	.m_period_us = period_us, \
+	.m_cpu = -1 \
+	})
+
+// this structure holds the tick statistics, all times in micro seconds
+typedef struct PMLIN_tick_stats_t {
+	uint32_t m_ticks; // ticks run
+	uint32_t m_missed; // ticks skipped because an earlier tick overran
+	uint32_t m_late; // ticks that started late, see m_late_us
+	uint32_t m_errors; // ticks where PMLIN_master_mirror_tick returned an error
+	uint32_t m_max_lateness_us; // longest time from the grid time to the start of a tick
+	uint32_t m_max_duration_us; // longest PMLIN_master_mirror_tick call
+	uint32_t m_jitter_p50_us; // tick-to-tick jitter, i.e. how much the time between tick starts differs
+	uint32_t m_jitter_p99_us; // from the period, percentiles to PMLIN_TICK_JITTER_BUCKET_US resolution
+	uint32_t m_jitter_p999_us;
+	uint32_t m_jitter_max_us;
+	bool m_realtime; // SCHED_FIFO was requested and set
+	bool m_memory_locked; // mlockall was requested and succeeded
+	bool m_pinned; // CPU affinity was requested and set
+} PMLIN_tick_stats_t;
+
+// this structure holds one tick driver, all fields are private to PMLIN master code
+typedef struct PMLIN_tick_driver_t {
+	PMLIN_master_t *m_master;
+	PMLIN_tick_config_t m_config;
+	pthread_t m_thread;
+	int m_timer_fd;
+	atomic_bool m_running;
+	atomic_bool m_stop;
+	pthread_mutex_t m_stats_mutex; // taken once per tick by the thread, only contended while reading the stats
+	PMLIN_tick_stats_t m_stats;
+	uint64_t m_grid_us; // grid time of the next tick
+	uint64_t m_prev_start_us; // start of the previous tick
+	bool m_have_prev; // m_prev_start_us is valid, cleared when the stats are reset
+	uint32_t m_jitter[PMLIN_TICK_JITTER_BUCKETS];
+} PMLIN_tick_driver_t;
+
+// Purpose: Start a tick driver thread
+//		The first tick is one period from the call. The real-time settings that cannot be made, typically for
+//		lack of privileges, are skipped, see the m_realtime, m_memory_locked and m_pinned statistics.
+// Parameters:
+//		driver (out)		The driver, must stay allocated until stopped
+//		m (in)				The bus to tick, NULL for the default bus
+//		config (in)			The configuration, declare with PMLIN_TICK_CONFIG
+//	Returns:				Error code
+//		PMLIN_OK
+//		PMLIN_NO_INITIALIZED_ERROR	if the timer or the thread could not be created
+
+PMLIN_error_t PMLIN_tick_driver_start(PMLIN_tick_driver_t *driver, PMLIN_master_t *m, const PMLIN_tick_config_t *config);
+
+// Purpose: Stop a tick driver thread, returns after the tick in progress, if any, is over
+
+void PMLIN_tick_driver_stop(PMLIN_tick_driver_t *driver);
+
+// Purpose: Get a snapshot of the tick statistics
+// Parameters:
+//		stats (out)			Pointer to structure to receive the statistics
+//		reset (in)			If true the statistics are zeroed after taking the snapshot
+
+void PMLIN_tick_driver_get_stats(PMLIN_tick_driver_t *driver, PMLIN_tick_stats_t *stats, bool reset);
+
+#endif
@@ -0,0 +1,322 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "pmlin-uring-hal.h"
+
+#ifdef __linux__
+
+#include "pmlin.h"
+#include <string.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+// There is no dependency on liburing, the ring is set up and driven with the raw system calls.
+//
+// A frame is one chain of linked operations:
+//
+//		WRITE (the frame) -> READ (echo) -> LINK_TIMEOUT (read timeout)
+//
+// submitted and reaped with a single io_uring_enter. Further READ + LINK_TIMEOUT pairs are only needed if
+// the echo and response arrive in pieces. The serial port is blocking with VMIN 1 so a READ completes as soon as some data has arrived,
+// the LINK_TIMEOUT cancels it if nothing arrives in time.
+
+#define PMLIN_URING_TAG_WRITE 1
+#define PMLIN_URING_TAG_READ 2
+#define PMLIN_URING_TAG_TIMEOUT 3
+
+// the port used by the functions that do not take a PMLIN_uring_port_t
+static PMLIN_uring_port_t g_PMLIN_uring_port = { .m_ring_fd = -1, .m_serial = { .m_fd = -1 } };
+
+static int PMLIN_uring_setup(uint32_t entries, struct io_uring_params *params) {
+	return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int PMLIN_uring_enter(PMLIN_uring_port_t *port, uint32_t to_submit, uint32_t min_complete) {
+	port->m_syscall_count++;
+	return (int) syscall(__NR_io_uring_enter, port->m_ring_fd, to_submit, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+static uint64_t PMLIN_uring_time_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void PMLIN_uring_set_ts(int64_t ts[2], uint64_t ns) {
+	ts[0] = ns / 1000000000ULL;
+	ts[1] = ns % 1000000000ULL;
+}
+
+// sleep until the absolute CLOCK_MONOTONIC time t_ns
+static void PMLIN_uring_sleep_until(uint64_t t_ns) {
+	struct timespec ts = { .tv_sec = t_ns / 1000000000ULL, .tv_nsec = t_ns % 1000000000ULL };
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+}
+
+static struct io_uring_sqe* PMLIN_uring_get_sqe(PMLIN_uring_port_t *port) {
+	uint32_t tail = *port->m_sq_tail + port->m_pending;
+	uint32_t index = tail & *port->m_sq_mask;
+	struct io_uring_sqe *sqe = &((struct io_uring_sqe*) port->m_sqes)[index];
+	memset(sqe, 0, sizeof(*sqe));
+	port->m_sq_array[index] = index;
+	port->m_pending++;
+	return sqe;
+}
+
+// reaps all available completions, remembers the result of the read
+static void PMLIN_uring_reap(PMLIN_uring_port_t *port) {
+	uint32_t head = *port->m_cq_head;
+	uint32_t tail = __atomic_load_n(port->m_cq_tail, __ATOMIC_ACQUIRE);
+	while (head != tail) {
+		struct io_uring_cqe *cqe = &((struct io_uring_cqe*) port->m_cqes)[head & *port->m_cq_mask];
+		if (cqe->user_data == PMLIN_URING_TAG_READ)
+			port->m_read_result = cqe->res;
+		port->m_inflight--;
+		head++;
+	}
+	__atomic_store_n(port->m_cq_head, head, __ATOMIC_RELEASE);
+}
+
+// submits the queued entries and, if wait is true, waits for all submitted operations to complete
+static void PMLIN_uring_submit(PMLIN_uring_port_t *port, bool wait) {
+	uint32_t to_submit = port->m_pending;
+	__atomic_store_n(port->m_sq_tail, *port->m_sq_tail + to_submit, __ATOMIC_RELEASE);
+	port->m_pending = 0;
+	port->m_inflight += to_submit;
+	while (1) {
+		int r = PMLIN_uring_enter(port, to_submit, wait ? port->m_inflight : 0);
+		if (r >= 0 || errno != EINTR)
+			break;
+		to_submit = 0; // an interrupted enter has already submitted
+		if (!wait)
+			break;
+	}
+	PMLIN_uring_reap(port);
+	while (wait && port->m_inflight) {
+		if (PMLIN_uring_enter(port, 0, port->m_inflight) < 0 && errno != EINTR)
+			break;
+		PMLIN_uring_reap(port);
+	}
+}
+
+int PMLIN_uring_port_open(PMLIN_uring_port_t *port, const char *port_name) {
+	memset(port, 0, sizeof(*port));
+	port->m_ring_fd = -1;
+	int fd = PMLIN_posix_port_open(&port->m_serial, port_name);
+	if (fd < 0)
+		return -1;
+
+	// blocking reads that return as soon as there is some data, the timeouts are done by the io_uring
+	struct termios opts;
+	if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK) < 0 || tcgetattr(fd, &opts) != 0)
+		goto fail;
+	opts.c_cc[VMIN] = 1;
+	opts.c_cc[VTIME] = 0;
+	if (tcsetattr(fd, TCSANOW, &opts) != 0)
+		goto fail;
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	port->m_ring_fd = PMLIN_uring_setup(PMLIN_URING_ENTRIES, &params);
+	if (port->m_ring_fd < 0)
+		goto fail;
+	port->m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	port->m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	port->m_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	port->m_sq_ring = mmap(NULL, port->m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, port->m_ring_fd, IORING_OFF_SQ_RING);
+	port->m_cq_ring = mmap(NULL, port->m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, port->m_ring_fd, IORING_OFF_CQ_RING);
+	port->m_sqes = mmap(NULL, port->m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, port->m_ring_fd, IORING_OFF_SQES);
+	if (port->m_sq_ring == MAP_FAILED || port->m_cq_ring == MAP_FAILED || port->m_sqes == MAP_FAILED)
+		goto fail;
+
+	uint8_t *sq = port->m_sq_ring;
+	port->m_sq_head = (uint32_t*) (sq + params.sq_off.head);
+	port->m_sq_tail = (uint32_t*) (sq + params.sq_off.tail);
+	port->m_sq_mask = (uint32_t*) (sq + params.sq_off.ring_mask);
+	port->m_sq_array = (uint32_t*) (sq + params.sq_off.array);
+	uint8_t *cq = port->m_cq_ring;
+	port->m_cq_head = (uint32_t*) (cq + params.cq_off.head);
+	port->m_cq_tail = (uint32_t*) (cq + params.cq_off.tail);
+	port->m_cq_mask = (uint32_t*) (cq + params.cq_off.ring_mask);
+	port->m_cqes = cq + params.cq_off.cqes;
+	return fd;
+
+	fail: ;
+	int err = errno;
+	PMLIN_uring_port_close(port);
+	errno = err;
+	return -1;
+}
+
+void PMLIN_uring_port_close(PMLIN_uring_port_t *port) {
+	if (port->m_sq_ring && port->m_sq_ring != MAP_FAILED)
+		munmap(port->m_sq_ring, port->m_sq_ring_size);
+	if (port->m_cq_ring && port->m_cq_ring != MAP_FAILED)
+		munmap(port->m_cq_ring, port->m_cq_ring_size);
+	if (port->m_sqes && port->m_sqes != MAP_FAILED)
+		munmap(port->m_sqes, port->m_sqes_size);
+	port->m_sq_ring = port->m_cq_ring = port->m_sqes = NULL;
+	if (port->m_ring_fd >= 0)
+		close(port->m_ring_fd);
+	port->m_ring_fd = -1;
+	if (port->m_serial.m_fd >= 0)
+		close(port->m_serial.m_fd);
+	port->m_serial.m_fd = -1;
+}
+
+void PMLIN_uring_port_send_break(void *p) {
+	PMLIN_uring_port_t *port = p;
+	int fd = port->m_serial.m_fd;
+	// unlike the POSIX HAL no tcdrain() is needed, the previous frame is out as its echo has been read
+	PMLIN_uring_submit(port, true); // but make sure nothing is left in flight
+	uint32_t count = port->m_serial.m_syscall_count;
+	PMLIN_posix_port_resync(&port->m_serial);
+	port->m_syscall_count += port->m_serial.m_syscall_count - count;
+
+	if (port->m_serial.m_no_break_ioctl || ioctl(fd, TIOCSBRK) != 0) {
+		count = port->m_serial.m_syscall_count;
+		port->m_serial.m_no_break_ioctl = true;
+		PMLIN_posix_port_send_break(&port->m_serial);
+		port->m_syscall_count += port->m_serial.m_syscall_count - count;
+		return;
+	}
+	PMLIN_uring_sleep_until(PMLIN_uring_time_ns() + port->m_serial.m_break_us * 1000ULL);
+	ioctl(fd, TIOCCBRK);
+	// line must stay idle (mark) for a while after the break before the header start bit, this is not
+	// a TIMEOUT hard linked ahead of the write as a tty write issued from its completion fails with EINTR
+	PMLIN_uring_sleep_until(PMLIN_uring_time_ns() + PMLIN_POSIX_BREAK_DELIMITER_BITS * 1000000000ULL / PMLIN_BAUDRATE);
+	port->m_syscall_count += 4;
+}
+
+void PMLIN_uring_port_write(void *p, uint8_t *buffer, uint16_t len) {
+	PMLIN_uring_port_t *port = p;
+	if (len > sizeof(port->m_tx))
+		len = sizeof(port->m_tx);
+	memcpy(port->m_tx, buffer, len);
+	struct io_uring_sqe *sqe = PMLIN_uring_get_sqe(port);
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = port->m_serial.m_fd;
+	sqe->addr = (uint64_t) (uintptr_t) port->m_tx;
+	sqe->len = len;
+	sqe->off = (uint64_t) -1; // current position, i.e. a stream
+	sqe->flags = IOSQE_IO_LINK; // the read must not start before the write is done
+	sqe->user_data = PMLIN_URING_TAG_WRITE;
+}
+
+// collects what has already been received without waiting
+static uint16_t PMLIN_uring_read_now(PMLIN_uring_port_t *port, uint8_t *buffer, uint16_t len) {
+	int available = 0;
+	PMLIN_uring_submit(port, false);
+	ioctl(port->m_serial.m_fd, FIONREAD, &available);
+	port->m_syscall_count++;
+	if (available <= 0)
+		return 0;
+	ssize_t r = read(port->m_serial.m_fd, buffer, available < len ? available : len);
+	port->m_syscall_count++;
+	return r > 0 ? PMLIN_posix_port_decode(&port->m_serial, buffer, 0, r) : 0;
+}
+
+uint16_t PMLIN_uring_port_read_gap(void *p, uint8_t *buffer, uint16_t len, uint32_t timeout_us, uint32_t gap_us) {
+	PMLIN_uring_port_t *port = p;
+	if (timeout_us == 0)
+		return PMLIN_uring_read_now(port, buffer, len);
+	uint64_t t0 = PMLIN_uring_time_ns();
+	uint64_t wait_ns = timeout_us * 1000ULL;
+	uint16_t n = 0;
+	while (n < len) {
+		struct io_uring_sqe *sqe = PMLIN_uring_get_sqe(port);
+		sqe->opcode = IORING_OP_READ;
+		sqe->fd = port->m_serial.m_fd;
+		sqe->addr = (uint64_t) (uintptr_t) &buffer[n];
+		sqe->len = len - n;
+		sqe->off = (uint64_t) -1;
+		sqe->flags = IOSQE_IO_LINK;
+		sqe->user_data = PMLIN_URING_TAG_READ;
+
+		PMLIN_uring_set_ts(port->m_timeout_ts, wait_ns);
+		sqe = PMLIN_uring_get_sqe(port);
+		sqe->opcode = IORING_OP_LINK_TIMEOUT;
+		sqe->fd = -1;
+		sqe->addr = (uint64_t) (uintptr_t) port->m_timeout_ts;
+		sqe->len = 1;
+		sqe->user_data = PMLIN_URING_TAG_TIMEOUT;
+
+		port->m_read_result = 0;
+		PMLIN_uring_submit(port, true);
+		if (port->m_read_result <= 0)
+			break; // timed out (cancelled) or failed
+		n = PMLIN_posix_port_decode(&port->m_serial, buffer, n, port->m_read_result);
+
+		// one absolute deadline for the whole read, once data flows also the inter-byte timeout applies
+		uint64_t elapsed = PMLIN_uring_time_ns() - t0;
+		if (elapsed >= timeout_us * 1000ULL)
+			break;
+		wait_ns = timeout_us * 1000ULL - elapsed;
+		if (gap_us * 1000ULL < wait_ns)
+			wait_ns = gap_us * 1000ULL;
+	}
+	return n;
+}
+
+int PMLIN_uring_open_serial_port(const char *port_name) {
+	return PMLIN_uring_port_open(&g_PMLIN_uring_port, port_name);
+}
+
+int PMLIN_uring_get_fd() {
+	return g_PMLIN_uring_port.m_serial.m_fd;
+}
+
+void PMLIN_uring_send_break() {
+	PMLIN_uring_port_send_break(&g_PMLIN_uring_port);
+}
+
+void PMLIN_uring_write(uint8_t *buffer, uint16_t len) {
+	PMLIN_uring_port_write(&g_PMLIN_uring_port, buffer, len);
+}
+
+uint16_t PMLIN_uring_read(uint8_t *buffer, uint16_t len, uint32_t timeout_us) {
+	return PMLIN_uring_port_read_gap(&g_PMLIN_uring_port, buffer, len, timeout_us, timeout_us);
+}
+
+uint16_t PMLIN_uring_read_gap(uint8_t *buffer, uint16_t len, uint32_t timeout_us, uint32_t gap_us) {
+	return PMLIN_uring_port_read_gap(&g_PMLIN_uring_port, buffer, len, timeout_us, gap_us);
+}
+
+#endif
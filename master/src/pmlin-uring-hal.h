@@ -0,0 +1,129 @@
+/*
+Copyright 2023 Planmeca Oy 
+
+Author Kustaa Nyholm (kustaa.nyholm@planmeca.com)
+
+Redistribution and use in source and binary forms, with or without 
+modification, are permitted provided that the following conditions are met:
+
+1. Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+
+2. Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+
+3. Neither the name of the copyright holder nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS “AS IS” 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ARE DISCLAIMED. 
+
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY 
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND 
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF 
+THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __PMLIN_URING_HAL_H__
+#define	__PMLIN_URING_HAL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pmlin-master.h"
+#include "pmlin-posix-hal.h"
+
+// Hardware Abstraction Layer (HAL) implementation for Linux using io_uring.
+//
+// Works like pmlin-posix-hal.c except that the write of the frame and the read of the echo/response together
+// with its timeout are submitted as one chain of linked io_uring operations with a single system call,
+// and their completions are reaped in one batch.
+//
+// Pass PMLIN_uring_send_break, PMLIN_uring_write and PMLIN_uring_read to PMLIN_initialize_master,
+// PMLIN_uring_read_gap to PMLIN_set_read_gap_callback and PMLIN_uring_get_fd and PMLIN_posix_time_us
+// to PMLIN_initialize_nonblocking. For multiple buses use PMLIN_uring_port_open and PMLIN_URING_HAL(port).
+
+#define PMLIN_URING_ENTRIES 8 // submission queue size, a frame needs at most three entries
+
+// this structure holds one serial port and its io_uring, all fields are private to the HAL
+typedef struct PMLIN_uring_port_t {
+	PMLIN_posix_port_t m_serial; // the serial port, opened and configured as in the POSIX HAL
+	int m_ring_fd;
+	void *m_sq_ring;
+	void *m_cq_ring;
+	void *m_sqes;
+	uint32_t m_sq_ring_size;
+	uint32_t m_cq_ring_size;
+	uint32_t m_sqes_size;
+	uint32_t *m_sq_head;
+	uint32_t *m_sq_tail;
+	uint32_t *m_sq_mask;
+	uint32_t *m_sq_array;
+	uint32_t *m_cq_head;
+	uint32_t *m_cq_tail;
+	uint32_t *m_cq_mask;
+	void *m_cqes;
+	uint32_t m_pending; // entries queued but not yet submitted
+	uint32_t m_inflight; // entries submitted whose completions have not been reaped
+	int32_t m_read_result; // result of the latest read
+	int64_t m_timeout_ts[2]; // struct __kernel_timespec for the read timeout
+	uint8_t m_tx[PMLIN_MAX_FRAME_LEN]; // copy of the frame being sent, must stay valid until written
+	uint32_t m_syscall_count; // number of system calls made, for comparing the HALs
+} PMLIN_uring_port_t;
+
+// Purpose: Open and configure a serial port and set up its io_uring
+// Parameters:
+//		port (out)			The port to initialize
+//		port_name (in)		Path to the serial port device, for example "/dev/ttyUSB0"
+// Returns:					The file descriptor of the serial port, or -1 on failure in which case errno tells why
+//							(io_uring not supported or disabled gives ENOSYS or EPERM)
+
+int PMLIN_uring_port_open(PMLIN_uring_port_t *port, const char *port_name);
+
+// Purpose: Close the serial port and release the io_uring
+
+void PMLIN_uring_port_close(PMLIN_uring_port_t *port);
+
+// PMLIN_hal_xxx_fp implementations taking a PMLIN_uring_port_t, otherwise as the functions below
+void PMLIN_uring_port_send_break(void *port);
+void PMLIN_uring_port_write(void *port, uint8_t *buffer, uint16_t len);
+uint16_t PMLIN_uring_port_read_gap(void *port, uint8_t *buffer, uint16_t len, uint32_t timeout_us, uint32_t gap_us);
+
+// macro used to define the HAL for PMLIN_master_initialize
+#define PMLIN_URING_HAL(port) PMLIN_HAL(PMLIN_uring_port_send_break, PMLIN_uring_port_write, PMLIN_uring_port_read_gap, port)
+
+// Purpose: Open and configure the serial port used by the functions below
+// Returns:					The file descriptor, or -1 on failure in which case errno tells why
+
+int PMLIN_uring_open_serial_port(const char *port_name);
+
+// Purpose: Returns the file descriptor of the serial port opened with PMLIN_uring_open_serial_port
+
+int PMLIN_uring_get_fd();
+
+// Purpose: PMLIN_send_break_fp implementation
+//		Timed as in PMLIN_posix_send_break but without the tcdrain(), the previous frame is known
+//		to be out as its echo has been read.
+
+void PMLIN_uring_send_break();
+
+// Purpose: PMLIN_write_fp implementation
+//		Only queues the write, it is submitted together with the following read
+
+void PMLIN_uring_write(uint8_t *buffer, uint16_t len);
+
+// Purpose: PMLIN_read_fp implementation, see PMLIN_posix_read
+
+uint16_t PMLIN_uring_read(uint8_t *buffer, uint16_t len, uint32_t timeout_us);
+
+// Purpose: PMLIN_read_gap_fp implementation, see PMLIN_posix_read_gap
+
+uint16_t PMLIN_uring_read_gap(uint8_t *buffer, uint16_t len, uint32_t timeout_us, uint32_t gap_us);
+
+#endif
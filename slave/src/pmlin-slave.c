@@ -42,12 +42,21 @@ volatile uint8_t g_PMLIN_trf_idx = 0;
 volatile uint8_t g_PMLIN_trf_len = 0;
 volatile uint8_t g_PMLIN_verf_idx = 0;
 volatile uint8_t g_PMLIN_crc = 0;
-volatile uint16_t g_PMLIN_timer = 0; // counts in micro seconds
+volatile uint32_t g_PMLIN_timer = 0; // counts in micro seconds
 volatile uint16_t g_PMLIN_timer_period = 1000; // in micro seconds
 volatile uint16_t g_PMLIN_renum_to_id = 0;
 
 volatile uint8_t g_PMLIN_buffer[PMLIN_BUFFER_SIZE];
 
+// default for firmware that does not use trigger commands, see PMLIN_trigger in pmlin-slave.h
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((weak)) void PMLIN_trigger() {
+}
+#elif !defined(PMLIN_SLAVE_TRIGGER)
+void PMLIN_trigger() {
+}
+#endif
+
 #define PMLIN_STATE_WAIT_BREAK 0
 #define PMLIN_STATE_RX_HEADER 1
 #define PMLIN_STATE_RX_MSG 2
@@ -59,6 +68,14 @@ volatile uint8_t g_PMLIN_buffer[PMLIN_BUFFER_SIZE];
 #define PMLIN_STATE_TX_ACK 8
 #define PMLIN_STATE_CHECK_RX_MSG_CRC 9
 #define PMLIN_STATE_CHECK_RX_CTRL_MSG_CRC 10
+#define PMLIN_STATE_RX_GROUP_HEADER 11
+#define PMLIN_STATE_RX_GROUP_SLICES 12
+#define PMLIN_STATE_CHECK_RX_GROUP_CRC 13
+#define PMLIN_STATE_RX_EXCHANGE_MSG 14
+#define PMLIN_STATE_CHECK_RX_EXCHANGE_CRC 15
+#define PMLIN_STATE_TX_EXCHANGE_RESP 16
+#define PMLIN_STATE_WAIT_POLL_SLOT 17
+#define PMLIN_STATE_TX_POLL_RESP 18
 
 volatile uint8_t g_PMLIN_state = PMLIN_STATE_WAIT_BREAK;
 
@@ -92,10 +109,28 @@ static uint8_t PMLIN_crc8(uint8_t crc, uint8_t data) {
 volatile uint8_t g_PMLIN_msg_type;
 volatile uint8_t g_PMLIN_msg_id;
 
+// our part of a group write broadcast payload, empty if we are not in the group
+static volatile uint8_t g_PMLIN_slice_start;
+static volatile uint8_t g_PMLIN_slice_end;
+static volatile bool g_PMLIN_group_member;
+
+// the slot header of a poll answer is still to be transmitted
+static volatile bool g_PMLIN_slot_header;
+
 static void PMLIN_handle_id() {
 	g_PMLIN_trf_idx = 0;
 	g_PMLIN_crc = PMLIN_CRC_INIT_VAL;
 	g_PMLIN_state = PMLIN_STATE_WAIT_BREAK;
+	if (PMLIN_BROADCAST_ID == g_PMLIN_msg_id) {
+		if (PMLIN_MESSAGE_TYPE_CMD == g_PMLIN_msg_type) {
+			g_PMLIN_state = PMLIN_STATE_RX_CTRL_MSG;
+			g_PMLIN_trf_len = PMLIN_CMD_MSG_LEN;
+		} else {
+			g_PMLIN_state = PMLIN_STATE_RX_GROUP_HEADER;
+			g_PMLIN_trf_len = PMLIN_GROUP_HEADER_LEN;
+		}
+		return;
+	}
 	if (g_PMLIN_my_id == g_PMLIN_msg_id) {
 		if (PMLIN_MESSAGE_TYPE_CMD == g_PMLIN_msg_type) {
 			g_PMLIN_state = PMLIN_STATE_RX_CTRL_MSG;
@@ -109,6 +144,9 @@ static void PMLIN_handle_id() {
 				g_PMLIN_state = PMLIN_STATE_TX_MSG;
 				PMLIN_UART_enable_data_register_empty_interrupt(1);
 				break;
+			case PMLIN_INIT_EXCHANGE_MSG:
+				g_PMLIN_state = PMLIN_STATE_RX_EXCHANGE_MSG;
+				break;
 			default:
 				break;
 			}
@@ -116,6 +154,63 @@ static void PMLIN_handle_id() {
 	}
 }
 
+// works out where our slice is from the group write header in the buffer
+static void PMLIN_handle_group_header() {
+	uint8_t slice_len = g_PMLIN_buffer[PMLIN_GROUP_SLICE_LEN_IDX];
+	uint32_t mask = 0;
+	for (uint8_t i = 0; i < 4; i++)
+		mask |= (uint32_t) g_PMLIN_buffer[PMLIN_GROUP_MASK_IDX + i] << (8 * i);
+	uint16_t before = 0, total = 0;
+	for (uint8_t id = PMLIN_FIRST_DEVICE_ID; id < PMLIN_MAX_NUM_ID; id++) {
+		if (mask & ((uint32_t) 1 << id)) {
+			if (id < g_PMLIN_my_id)
+				before += slice_len;
+			total += slice_len;
+		}
+	}
+	if (total > 255 - PMLIN_GROUP_HEADER_LEN) { // cannot be, the header is corrupt
+		g_PMLIN_state = PMLIN_STATE_WAIT_BREAK;
+		return;
+	}
+	g_PMLIN_trf_idx = 0;
+	g_PMLIN_trf_len = total;
+	g_PMLIN_slice_start = before;
+	g_PMLIN_slice_end = before;
+	g_PMLIN_group_member = false;
+	if (slice_len && (mask & ((uint32_t) 1 << g_PMLIN_my_id)) && PMLIN_init_transfer(g_PMLIN_msg_type) == PMLIN_INIT_RX_MSG) {
+		g_PMLIN_slice_end = before + slice_len;
+		g_PMLIN_group_member = true;
+	}
+	g_PMLIN_state = total ? PMLIN_STATE_RX_GROUP_SLICES : PMLIN_STATE_CHECK_RX_GROUP_CRC;
+}
+
+static void PMLIN_start_poll_slot() {
+	g_PMLIN_crc = PMLIN_CRC_INIT_VAL;
+	g_PMLIN_slot_header = true;
+	g_PMLIN_state = PMLIN_STATE_TX_POLL_RESP;
+	PMLIN_UART_enable_data_register_empty_interrupt(1);
+}
+
+// works out when our slot is if the poll in the buffer includes us
+static void PMLIN_handle_poll() {
+	uint8_t first = g_PMLIN_buffer[PMLIN_CMD_MSG_POLL_FIRST_ID_IDX];
+	g_PMLIN_state = PMLIN_STATE_WAIT_BREAK;
+	if (g_PMLIN_my_id < first || g_PMLIN_my_id > g_PMLIN_buffer[PMLIN_CMD_MSG_POLL_LAST_ID_IDX])
+		return;
+	g_PMLIN_msg_type = g_PMLIN_buffer[PMLIN_CMD_MSG_POLL_TYPE_IDX] & (PMLIN_MSG_TYPE_MASK >> PMLIN_MSG_TYPE_BITPOS);
+	if (PMLIN_MESSAGE_TYPE_CMD == g_PMLIN_msg_type || PMLIN_init_transfer(g_PMLIN_msg_type) != PMLIN_INIT_TX_MSG)
+		return;
+	uint32_t delay = (uint32_t) (g_PMLIN_my_id - first) * g_PMLIN_buffer[PMLIN_CMD_MSG_POLL_SLOT_LEN_IDX] * PMLIN_POLL_CHAR_TIME_US;
+	if (!delay) {
+		PMLIN_start_poll_slot();
+		return;
+	}
+	// the first timer interrupt comes anything up to a period from now, the extra period makes sure
+	// that the slot never starts early, only up to a period late
+	g_PMLIN_timer = delay + g_PMLIN_timer_period;
+	g_PMLIN_state = PMLIN_STATE_WAIT_POLL_SLOT;
+}
+
 static void fill_buffer_with_random_data(uint8_t len) {
 	while (len > 0)
 		g_PMLIN_buffer[--len] = PMLIN_random();
@@ -131,8 +226,24 @@ static void PMLIN_handle_message() {
 		PMLIN_UART_enable_data_register_empty_interrupt(1);
 		PMLIN_end_transfer(g_PMLIN_msg_type);
 		break;
+	case PMLIN_STATE_CHECK_RX_EXCHANGE_CRC:
+		PMLIN_end_transfer(g_PMLIN_msg_type);
+		g_PMLIN_state = PMLIN_STATE_TX_EXCHANGE_RESP;
+		PMLIN_UART_enable_data_register_empty_interrupt(1);
+		break;
 	case PMLIN_STATE_CHECK_RX_CTRL_MSG_CRC: {
 		uint8_t cmd = g_PMLIN_buffer[PMLIN_CMD_MSG_CMD_IDX];
+		if (PMLIN_BROADCAST_ID == g_PMLIN_msg_id) { // nobody responds to a broadcast
+			uint32_t mask = 0;
+			for (uint8_t i = 0; i < 4; i++)
+				mask |= (uint32_t) g_PMLIN_buffer[PMLIN_CMD_MSG_TRIGGER_MASK_IDX + i] << (8 * i);
+			if (PMLIN_CMD_MSG_CMD_TRIGGER == cmd && (mask & ((uint32_t) 1 << g_PMLIN_my_id)))
+				PMLIN_trigger();
+			g_PMLIN_state = PMLIN_STATE_WAIT_BREAK;
+			if (PMLIN_CMD_MSG_CMD_POLL == cmd)
+				PMLIN_handle_poll();
+			break;
+		}
 		if (PMLIN_CMD_MSG_CMD_PROBE == cmd) {
 			g_PMLIN_trf_len = PMLIN_CMD_RESP_LEN;
 			fill_buffer_with_random_data(PMLIN_CMD_RESP_LEN);
@@ -142,6 +253,10 @@ static void PMLIN_handle_message() {
 		}
 		if (PMLIN_CMD_MSG_CMD_RENUM == cmd) {
 			g_PMLIN_renum_to_id = g_PMLIN_buffer[PMLIN_CMD_MSG_RENUM_ID_IDX];
+			if (PMLIN_BROADCAST_ID == g_PMLIN_renum_to_id || g_PMLIN_renum_to_id >= PMLIN_MAX_NUM_ID) { // we could never be addressed again
+				g_PMLIN_state = PMLIN_STATE_WAIT_BREAK;
+				break;
+			}
 			fill_buffer_with_random_data(PMLIN_CMD_RESP_LEN);
 			g_PMLIN_state = PMLIN_STATE_WAIT_RENUM_TIMER;
 			// random wait time is random [0..31] * 2.0 * UART char time in microseconds
@@ -215,13 +330,41 @@ void PMLIN_UART_data_received_interrupt_handler(uint8_t data_in, bool break_dete
 		if (!PMLIN_handle_byte_received_from_host(data_in))
 			g_PMLIN_state = PMLIN_STATE_CHECK_RX_MSG_CRC;
 		break;
+	case PMLIN_STATE_RX_EXCHANGE_MSG:
+		g_PMLIN_crc = PMLIN_crc8(g_PMLIN_crc, data_in);
+		if (!PMLIN_handle_byte_received_from_host(data_in))
+			g_PMLIN_state = PMLIN_STATE_CHECK_RX_EXCHANGE_CRC;
+		break;
 	case PMLIN_STATE_RX_CTRL_MSG:
 		g_PMLIN_crc = PMLIN_crc8(g_PMLIN_crc, data_in);
 		g_PMLIN_buffer[g_PMLIN_trf_idx++] = data_in;
 		if (g_PMLIN_trf_idx >= g_PMLIN_trf_len)
 			g_PMLIN_state = PMLIN_STATE_CHECK_RX_CTRL_MSG_CRC;
 		break;
+	case PMLIN_STATE_RX_GROUP_HEADER:
+		g_PMLIN_crc = PMLIN_crc8(g_PMLIN_crc, data_in);
+		g_PMLIN_buffer[g_PMLIN_trf_idx++] = data_in;
+		if (g_PMLIN_trf_idx >= g_PMLIN_trf_len)
+			PMLIN_handle_group_header();
+		break;
+	case PMLIN_STATE_RX_GROUP_SLICES:
+		g_PMLIN_crc = PMLIN_crc8(g_PMLIN_crc, data_in);
+		if (g_PMLIN_trf_idx >= g_PMLIN_slice_start && g_PMLIN_trf_idx < g_PMLIN_slice_end) {
+			if (!PMLIN_handle_byte_received_from_host(data_in))
+				g_PMLIN_slice_end = g_PMLIN_trf_idx + 1; // our message is shorter than the slice
+		}
+		if (++g_PMLIN_trf_idx >= g_PMLIN_trf_len)
+			g_PMLIN_state = PMLIN_STATE_CHECK_RX_GROUP_CRC;
+		break;
+	case PMLIN_STATE_CHECK_RX_GROUP_CRC:
+		// no ACK, every slave in the group would send one at the same time
+		g_PMLIN_crc = PMLIN_crc8(g_PMLIN_crc, data_in);
+		if (g_PMLIN_crc == 0 && g_PMLIN_group_member)
+			PMLIN_end_transfer(g_PMLIN_msg_type);
+		g_PMLIN_state = PMLIN_STATE_WAIT_BREAK;
+		break;
 	case PMLIN_STATE_CHECK_RX_CTRL_MSG_CRC: // fall through
+	case PMLIN_STATE_CHECK_RX_EXCHANGE_CRC: // fall through
 	case PMLIN_STATE_CHECK_RX_MSG_CRC:
 		g_PMLIN_crc = PMLIN_crc8(g_PMLIN_crc, data_in);
 		if (g_PMLIN_crc != 0) {
@@ -263,7 +406,11 @@ uint8_t PMLIN_UART_data_register_empty_interrupt_handler() {
 		return PMLIN_ACK_CHAR;
 	}
 	int16_t data;
-	if (g_PMLIN_state == PMLIN_STATE_TX_MSG)
+	if (PMLIN_STATE_TX_POLL_RESP == g_PMLIN_state && g_PMLIN_slot_header) {
+		g_PMLIN_slot_header = false;
+		data = (g_PMLIN_msg_type << PMLIN_MSG_TYPE_BITPOS) | g_PMLIN_my_id;
+	} else if (g_PMLIN_state == PMLIN_STATE_TX_MSG || g_PMLIN_state == PMLIN_STATE_TX_EXCHANGE_RESP
+			|| g_PMLIN_state == PMLIN_STATE_TX_POLL_RESP)
 		data = PMLIN_get_byte_to_transmit_to_host();
 	else {
 		if (g_PMLIN_trf_idx < g_PMLIN_trf_len)
@@ -281,11 +428,13 @@ uint8_t PMLIN_UART_data_register_empty_interrupt_handler() {
 		case PMLIN_STATE_TX_RENUM_CONF:
 			// either break char or verification brings us out of this state
 			break;
-		case PMLIN_STATE_TX_MSG:
+		case PMLIN_STATE_TX_MSG: // fall through
+		case PMLIN_STATE_TX_POLL_RESP:
 			PMLIN_end_transfer(g_PMLIN_msg_type);
 			g_PMLIN_state = PMLIN_STATE_WAIT_BREAK;
 			break;
-		case PMLIN_STATE_TX_CTRL_RESP:
+		case PMLIN_STATE_TX_CTRL_RESP: // fall through
+		case PMLIN_STATE_TX_EXCHANGE_RESP:
 			g_PMLIN_state = PMLIN_STATE_WAIT_BREAK;
 			break;
 		default:
@@ -296,6 +445,14 @@ uint8_t PMLIN_UART_data_register_empty_interrupt_handler() {
 }
 
 void PMLIN_TIMER_interrupt_handler() {
+	if (g_PMLIN_state == PMLIN_STATE_WAIT_POLL_SLOT) {
+		if (g_PMLIN_timer > g_PMLIN_timer_period)
+			g_PMLIN_timer -= g_PMLIN_timer_period;
+		else {
+			g_PMLIN_timer = 0;
+			PMLIN_start_poll_slot();
+		}
+	}
 	if (g_PMLIN_state == PMLIN_STATE_WAIT_RENUM_TIMER) {
 		if (g_PMLIN_timer >= g_PMLIN_timer_period)
 			g_PMLIN_timer -= g_PMLIN_timer_period;
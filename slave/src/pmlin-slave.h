@@ -55,14 +55,24 @@ uint8_t PMLIN_init_transfer(uint8_t type);
 #define PMLIN_INIT_IGNORE_MSG 0
 #define PMLIN_INIT_RX_MSG 1
 #define PMLIN_INIT_TX_MSG 2
+#define PMLIN_INIT_EXCHANGE_MSG 3 // receive the request, then PMLIN_end_transfer, then transmit the response
 
 // Implement this, PMLIN code calls this when the transfer is complete to allow the client to process the received message.
 // Parameter message_type contains the type of the received message completed message. This is the same message_type
 // that was passed to PMLIN_init_transfer, repeated here for convenience.
 // For messages received all message processing typically happens within in this function call and for tramitted
 // messages this is typically a no-operation.
+// For exchange messages this is called when the request has been received intact, before the response is
+// transmitted, so this is where the request is processed and the transmit index reset for the response.
 void PMLIN_end_transfer(uint8_t message_type);
 
+// Optionally implement this, PMLIN code calls this from within the data received interrupt when a broadcast trigger command
+// that includes this slave has been received intact. All slaves on the bus receive the last byte of the trigger
+// at the same moment, so applying here data latched earlier in PMLIN_end_transfer makes the slaves act together.
+// Keep it short, it is called from the interrupt. PMLIN provides an empty default, weak with GCC and Clang,
+// with other compilers define PMLIN_SLAVE_TRIGGER when compiling pmlin-slave.c to supply your own.
+void PMLIN_trigger();
+
 // Implement this, PMLIN code calls this from within the data received interrupt to deliver the payload to the client code
 // this should return true if this was not the last byte of the message
 bool PMLIN_handle_byte_received_from_host(uint8_t received_byte) ;